@@ -6,10 +6,11 @@ layout (location = 0) out vec4 outColor;
 
 layout (set = 0, binding = 0) uniform GlobalUbo {
 	mat4 view;
+	mat4 inverseView;
 	mat4 projection;
 	vec4 ambientLightColor;
-	vec3 lightPosition;
 	vec4 lightColor;
+	vec3 directionalLight;
 } ubo;
 
 void main () {
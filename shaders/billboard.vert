@@ -4,10 +4,11 @@ layout (location = 0) out vec2 fragOffset;
 
 layout (set = 0, binding = 0) uniform GlobalUbo {
 	mat4 view;
+	mat4 inverseView;
 	mat4 projection;
 	vec4 ambientLightColor;
-	vec3 lightPosition;
 	vec4 lightColor;
+	vec3 directionalLight;
 } ubo;
 
 const vec2 offsets[6] = vec2[](
@@ -20,6 +21,8 @@ const vec2 offsets[6] = vec2[](
 );
 
 const float RADIUS = 0.1;
+// there's only the directional light now, so the sprite sits this far off in its direction
+const float LIGHT_DISTANCE = 10.0;
 
 void main () {
 	//
@@ -29,7 +32,8 @@ void main () {
 	vec3 cameraUpWorld = {ubo.view[0][1], ubo.view[1][1], ubo.view[2][1]};
 	// Would alternatively use this to fix the up vector, used for axial billboards
 	//vec3 cameraUpWorld = vec3(0.0, 1.0, 0.0);
-	vec3 positionWorld = ubo.lightPosition.xyz + RADIUS * fragOffset.x * cameraRightWorld + RADIUS * fragOffset.y * cameraUpWorld;
+	vec3 lightPosition = normalize(ubo.directionalLight) * LIGHT_DISTANCE;
+	vec3 positionWorld = lightPosition + RADIUS * fragOffset.x * cameraRightWorld + RADIUS * fragOffset.y * cameraUpWorld;
 
 	gl_Position = ubo.projection * ubo.view * vec4(positionWorld, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,76 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout (location = 0) in vec3 fragColor;
+layout (location = 1) in vec3 fragNormal;
+layout (location = 2) in vec2 fragUv;
+layout (location = 3) in vec3 fragWorldPos;
+
+layout (location = 0) out vec4 outColor;
+
+layout (set = 0, binding = 0) uniform GlobalUbo {
+	mat4 view;
+	mat4 inverseView;
+	mat4 projection;
+	vec4 ambientLightColor;
+	vec4 lightColor;
+	vec3 directionalLight;
+} ubo;
+
+// every texture lives in the one table, the push constants say which slots this draw uses
+layout (set = 1, binding = 0) uniform sampler2D textures[];
+layout (set = 1, binding = 1) uniform sampler2DArray textureArrays[];
+
+layout (push_constant) uniform Push {
+	mat4 modelMatrix;
+	uint textureIndex;
+	uint terrainMaterialsIndex;
+	uint splatMapIndex;
+} push;
+
+// same values as VaRenderSystem::Material, every variant is its own specialized pipeline
+const uint MATERIAL_UNTEXTURED = 0;
+const uint MATERIAL_TEXTURED = 1;
+const uint MATERIAL_TERRAIN = 2;
+layout (constant_id = 0) const uint MATERIAL = MATERIAL_TERRAIN;
+// how many times the uvs repeat, VaGameObject::uvScale
+layout (constant_id = 1) const float UV_WRAP = 1000.0;
+
+vec4 calcTexColor()
+{
+	// MATERIAL is fixed when the pipeline gets built, so only one of these is left in the compiled shader
+	if (MATERIAL == MATERIAL_UNTEXTURED) {
+		return vec4(fragColor, 1.0);
+	}
+	if (MATERIAL == MATERIAL_TEXTURED) {
+		return texture(textures[nonuniformEXT(push.textureIndex)], fragUv * UV_WRAP);
+	}
+
+	vec2 fragUvWrap = fragUv * UV_WRAP;
+
+	// red and green pick the two material layers at this spot, blue is how much of the second one to mix in.
+	// So it's always two samples no matter how many materials the terrain has
+	vec4 splat = texture(textures[nonuniformEXT(push.splatMapIndex)], fragUv);
+	float layer0 = round(splat.r * 255.0);
+	float layer1 = round(splat.g * 255.0);
+
+	// both always get sampled, a branch on the weight would leave the derivatives undefined along its edges
+	vec4 color0 = texture(textureArrays[nonuniformEXT(push.terrainMaterialsIndex)], vec3(fragUvWrap, layer0));
+	vec4 color1 = texture(textureArrays[nonuniformEXT(push.terrainMaterialsIndex)], vec3(fragUvWrap, layer1));
+	return mix(color0, color1, splat.b);
+}
+
+void main() {
+	vec4 texColor = calcTexColor();
+	vec3 normal = normalize(fragNormal);
+
+	vec3 directionToLight = ubo.directionalLight;
+	directionToLight = normalize(directionToLight);
+
+	vec3 lightColor = ubo.lightColor.xyz * ubo.lightColor.w;
+
+	vec3 ambientLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
+	vec3 diffuseLight = lightColor * max(dot(normal, directionToLight), 0);
+
+	outColor = vec4((diffuseLight + ambientLight) * vec3(texColor), 1.0);
+}
\ No newline at end of file
@@ -18,31 +18,44 @@ layout (set = 0, binding = 0) uniform GlobalUbo {
 
 layout (set = 1, binding = 2) uniform sampler2D texSampler;
 
-layout (set = 1, binding = 3) uniform sampler2D terrainTex0;
-layout (set = 1, binding = 4) uniform sampler2D terrainTex1;
+// every terrain material as one array, and the map saying which of them to use where
+layout (set = 1, binding = 3) uniform sampler2DArray terrainMaterials;
+layout (set = 1, binding = 4) uniform sampler2D splatMap;
 
 layout (push_constant) uniform Push {
 	mat4 modelMatrix;
 } push;
 
+// same values as VaRenderSystem::Material, every variant is its own specialized pipeline
+const uint MATERIAL_UNTEXTURED = 0;
+const uint MATERIAL_TEXTURED = 1;
+const uint MATERIAL_TERRAIN = 2;
+layout (constant_id = 0) const uint MATERIAL = MATERIAL_TERRAIN;
+// how many times the uvs repeat, VaGameObject::uvScale
+layout (constant_id = 1) const float UV_WRAP = 1000.0;
+
 vec4 calcTexColor()
 {
-	vec2 fragUvWrap = fragUv * 1000.0;
-    vec4 texColor;
-    float height = 1.0 * fragWorldPos.y;
-
-	if (height < 10.0) {
-		texColor = texture(terrainTex0, fragUvWrap);
-	} else if (height < 30.0) {
-		vec4 color0 = texture(terrainTex0, fragUvWrap);
-		vec4 color1 = texture(terrainTex1, fragUvWrap);
-		float factor = (height - 10.0) / (30.0 - 10.0);
-		texColor = mix(color0, color1, factor);
-	} else {
-		texColor = texture(terrainTex1, fragUvWrap);
+	// MATERIAL is fixed when the pipeline gets built, so only one of these is left in the compiled shader
+	if (MATERIAL == MATERIAL_UNTEXTURED) {
+		return vec4(fragColor, 1.0);
+	}
+	if (MATERIAL == MATERIAL_TEXTURED) {
+		return texture(texSampler, fragUv * UV_WRAP);
 	}
 
-    return texColor;
+	vec2 fragUvWrap = fragUv * UV_WRAP;
+
+	// red and green pick the two material layers at this spot, blue is how much of the second one to mix in.
+	// So it's always two samples no matter how many materials the terrain has
+	vec4 splat = texture(splatMap, fragUv);
+	float layer0 = round(splat.r * 255.0);
+	float layer1 = round(splat.g * 255.0);
+
+	// both always get sampled, a branch on the weight would leave the derivatives undefined along its edges
+	vec4 color0 = texture(terrainMaterials, vec3(fragUvWrap, layer0));
+	vec4 color1 = texture(terrainMaterials, vec3(fragUvWrap, layer1));
+	return mix(color0, color1, splat.b);
 }
 
 void main() {
@@ -57,6 +70,5 @@ void main() {
 	vec3 ambientLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
 	vec3 diffuseLight = lightColor * max(dot(normal, directionToLight), 0);
 
-	//outColor = vec4((diffuseLight + ambientLight) * vec3(texture(texSampler, fragUv)), 1.0);
 	outColor = vec4((diffuseLight + ambientLight) * vec3(texColor), 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,146 @@
+#version 450
+
+// the feedback writes would otherwise turn early depth testing off, and hidden terrain shouldn't ask for pages
+layout (early_fragment_tests) in;
+
+layout (location = 0) in vec3 fragColor;
+layout (location = 1) in vec3 fragNormal;
+layout (location = 2) in vec2 fragUv;
+layout (location = 3) in vec3 fragWorldPos;
+
+layout (location = 0) out vec4 outColor;
+
+layout (set = 0, binding = 0) uniform GlobalUbo {
+	mat4 view;
+	mat4 inverseView;
+	mat4 projection;
+	vec4 ambientLightColor;
+	vec4 lightColor;
+	vec3 directionalLight;
+} ubo;
+
+// same as the constants in VaVirtualTexture
+const uint PAGE_SIZE = 128;
+const uint PAGE_BORDER = 1;
+const uint PHYSICAL_PAGE_SIZE = PAGE_SIZE + 2 * PAGE_BORDER;
+const uint PHYSICAL_PAGES = 16;
+const uint VIRTUAL_PAGES = 512;
+const int MIP_COUNT = 10;
+const uint MAX_FEEDBACK = 4096;
+
+layout (set = 1, binding = 0) uniform usampler2D pageTable;
+layout (set = 1, binding = 1) uniform sampler2D physicalPages;
+layout (set = 1, binding = 2) buffer Feedback {
+	uint count;
+	uint pages[MAX_FEEDBACK];
+	// one per virtual page, so a page only goes on the list once no matter how many fragments want it
+	uint requested[];
+} feedback;
+
+// the same materials the pages get baked from, tiled over the terrain at full resolution for the detail the
+// virtual texture is too coarse to hold, and the splat map saying which of them is where
+layout (set = 2, binding = 0) uniform sampler2DArray terrainMaterials;
+layout (set = 2, binding = 1) uniform sampler2D splatMap;
+
+layout (push_constant) uniform Push {
+	mat4 modelMatrix;
+	// how many times the materials repeat over the terrain, VaGameObject::uvScale
+	float uvScale;
+} push;
+
+// flattened index of a page, every mip's pages one after another starting from mip 0
+uint pageIndex(int mip, uvec2 page) {
+	uint offset = 0;
+	for (int i = 0; i < mip; i++) {
+		uint pages = VIRTUAL_PAGES >> i;
+		offset += pages * pages;
+	}
+	return offset + page.y * (VIRTUAL_PAGES >> mip) + page.x;
+}
+
+uvec2 pageAt(vec2 uv, int mip) {
+	uint pages = VIRTUAL_PAGES >> mip;
+	return min(uvec2(uv * float(pages)), uvec2(pages - 1));
+}
+
+vec4 calcTexColor(out int residentMip)
+{
+	vec2 uv = clamp(fragUv, 0.0, 1.0);
+
+	// the mip a regular mipped texture this size would pick
+	vec2 texel = fragUv * float(VIRTUAL_PAGES * PAGE_SIZE);
+	vec2 dx = dFdx(texel);
+	vec2 dy = dFdy(texel);
+	float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1.0));
+	int mip = min(int(lod), MIP_COUNT - 1);
+
+	uint index = pageIndex(mip, pageAt(uv, mip));
+	if (feedback.requested[index] == 0 && atomicExchange(feedback.requested[index], 1) == 0) {
+		uint slot = atomicAdd(feedback.count, 1);
+		if (slot < MAX_FEEDBACK) {
+			feedback.pages[slot] = index;
+		}
+	}
+
+	// closest page that's actually in, the one page at the last mip always is
+	uvec4 entry = uvec4(0);
+	residentMip = mip;
+	for (; residentMip < MIP_COUNT - 1; residentMip++) {
+		entry = texelFetch(pageTable, ivec2(pageAt(uv, residentMip)), residentMip);
+		if (entry.a != 0) {
+			break;
+		}
+	}
+	if (entry.a == 0) {
+		residentMip = MIP_COUNT - 1;
+		entry = texelFetch(pageTable, ivec2(0), MIP_COUNT - 1);
+	}
+
+	vec2 inPage = uv * float(VIRTUAL_PAGES >> residentMip) - vec2(pageAt(uv, residentMip));
+	vec2 physicalTexel = vec2(entry.xy) * float(PHYSICAL_PAGE_SIZE) + float(PAGE_BORDER) + inPage * float(PAGE_SIZE);
+	return textureLod(physicalPages, physicalTexel / float(PHYSICAL_PAGES * PHYSICAL_PAGE_SIZE), 0.0);
+}
+
+// what the page's texels are missing compared to the materials sampled at full resolution, as a factor on the page's
+// color. Pages get baked from the material mip closest to one material texel per page texel (see
+// VaTerrain::createPageGenerator), so that mip sampled here is what the page already holds
+vec3 calcDetail(int residentMip)
+{
+	vec2 fragUvWrap = fragUv * push.uvScale;
+	vec4 splat = texture(splatMap, fragUv);
+	float layer0 = round(splat.r * 255.0);
+	float layer1 = round(splat.g * 255.0);
+
+	float materialTexelsPerTexel = float(textureSize(terrainMaterials, 0).x) * push.uvScale / float((VIRTUAL_PAGES * PAGE_SIZE) >> residentMip);
+	float bakedLod = materialTexelsPerTexel > 1.0 ? floor(log2(materialTexelsPerTexel)) : 0.0;
+	// from far enough away the page has all the detail the screen can show, and the factor comes out as 1
+	float lod = textureQueryLod(terrainMaterials, fragUvWrap).y;
+	float coarseLod = max(bakedLod, lod);
+
+	vec3 fine = mix(
+		textureLod(terrainMaterials, vec3(fragUvWrap, layer0), max(lod, 0.0)).rgb,
+		textureLod(terrainMaterials, vec3(fragUvWrap, layer1), max(lod, 0.0)).rgb,
+		splat.b);
+	vec3 coarse = mix(
+		textureLod(terrainMaterials, vec3(fragUvWrap, layer0), coarseLod).rgb,
+		textureLod(terrainMaterials, vec3(fragUvWrap, layer1), coarseLod).rgb,
+		splat.b);
+	return clamp(fine / max(coarse, vec3(1.0 / 255.0)), 0.0, 4.0);
+}
+
+void main() {
+	int residentMip;
+	vec4 texColor = calcTexColor(residentMip);
+	texColor.rgb *= calcDetail(residentMip);
+	vec3 normal = normalize(fragNormal);
+
+	vec3 directionToLight = ubo.directionalLight;
+	directionToLight = normalize(directionToLight);
+
+	vec3 lightColor = ubo.lightColor.xyz * ubo.lightColor.w;
+
+	vec3 ambientLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
+	vec3 diffuseLight = lightColor * max(dot(normal, directionToLight), 0);
+
+	outColor = vec4((diffuseLight + ambientLight) * vec3(texColor), 1.0);
+}
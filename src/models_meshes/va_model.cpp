@@ -7,6 +7,7 @@
 #include <glm/gtx/hash.hpp>
 
 #include <cassert>
+#include <cmath>
 #include <cstring>
 #include <iostream>
 #include <unordered_map>
@@ -27,6 +28,7 @@ namespace std {
 
 namespace va {
 	VaModel::VaModel(VaDevice& device, const VaModel::Builder& builder) : vaDevice{ device } {
+		computeBounds(builder);
 		createVertexBuffers(builder.vertices);
 		createIndexBuffers(builder.indices);
 	}
@@ -42,6 +44,38 @@ namespace va {
 		return std::make_unique<VaModel>(device, builder);
 	}
 
+	void VaModel::computeBounds(const Builder& builder) {
+		if (builder.vertices.empty()) {
+			return;
+		}
+
+		boundsMin = builder.vertices[0].position;
+		boundsMax = builder.vertices[0].position;
+		for (const auto& vertex : builder.vertices) {
+			boundsMin = glm::min(boundsMin, vertex.position);
+			boundsMax = glm::max(boundsMax, vertex.position);
+		}
+
+		// ratio of total surface area to total uv area, so stretched or tiny triangles average out
+		double worldArea = 0.0;
+		double uvArea = 0.0;
+		size_t triangleCount = (builder.indices.empty() ? builder.vertices.size() : builder.indices.size()) / 3;
+		for (size_t i = 0; i < triangleCount; i++) {
+			const Vertex* v[3];
+			for (size_t j = 0; j < 3; j++) {
+				size_t index = builder.indices.empty() ? i * 3 + j : builder.indices[i * 3 + j];
+				v[j] = &builder.vertices[index];
+			}
+
+			worldArea += 0.5 * glm::length(glm::cross(v[1]->position - v[0]->position, v[2]->position - v[0]->position));
+			glm::vec2 uvEdge1 = v[1]->uv - v[0]->uv;
+			glm::vec2 uvEdge2 = v[2]->uv - v[0]->uv;
+			uvArea += 0.5 * std::abs(uvEdge1.x * uvEdge2.y - uvEdge1.y * uvEdge2.x);
+		}
+
+		uvDensity = uvArea > 0.0 ? static_cast<float>(std::sqrt(worldArea / uvArea)) : 0.0f;
+	}
+
 	void VaModel::createVertexBuffers(const std::vector<Vertex>& vertices) {
 		vertexCount = static_cast<uint32_t>(vertices.size());
 		assert(vertexCount >= 3 && "vertex count must be at least 3");
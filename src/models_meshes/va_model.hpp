@@ -49,6 +49,13 @@ namespace va {
 		void bind(VkCommandBuffer commandBuffer);
 		void draw(VkCommandBuffer commandBuffer);
 
+		// local space bounding box
+		glm::vec3 getBoundsMin() const { return boundsMin; }
+		glm::vec3 getBoundsMax() const { return boundsMax; }
+		// average local space distance covered by one unit of uv, 0 if the mesh has no uvs. Texture streaming uses it
+		// to work out how many texels land on each pixel
+		float getUvDensity() const { return uvDensity; }
+
 	private:
 		VaDevice& vaDevice;
 
@@ -59,6 +66,11 @@ namespace va {
 		std::unique_ptr<VaBuffer> indexBuffer;
 		uint32_t indexCount;
 
+		glm::vec3 boundsMin{ 0.0f };
+		glm::vec3 boundsMax{ 0.0f };
+		float uvDensity = 0.0f;
+
+		void computeBounds(const Builder& builder);
 		void createVertexBuffers(const std::vector<Vertex>& vertices);
 		void createIndexBuffers(const std::vector<uint32_t>& indices);
 	};
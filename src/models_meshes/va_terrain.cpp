@@ -1,13 +1,97 @@
 #include "va_terrain.hpp"
 
+#include "../va_mip_generator.hpp"
+
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
 #include <iostream>
 
 namespace va {
+	// has to match the vertex heights createTerrainFromFile comes up with
+	static float heightFromTexel(stbi_uc y) {
+		float yScale = 64.0f / 256.0f, yShift = 32.0f;
+		return -1 * ((int)y * yScale - yShift);
+	}
+
+	// material i changes over to i + 1 around transitionHeights[i]
+	static void splatAt(float worldHeight, const std::vector<float>& transitionHeights, float blendWidth,
+		uint8_t& layer0, uint8_t& layer1, float& blend) {
+		layer0 = 0;
+		layer1 = 0;
+		blend = 0.0f;
+		for (size_t k = 0; k < transitionHeights.size(); k++) {
+			float blendStart = transitionHeights[k] - blendWidth / 2.0f;
+			if (worldHeight < blendStart) {
+				break;
+			}
+			if (worldHeight < blendStart + blendWidth) {
+				layer0 = static_cast<uint8_t>(k);
+				layer1 = static_cast<uint8_t>(k + 1);
+				blend = (worldHeight - blendStart) / blendWidth;
+				break;
+			}
+			layer0 = layer1 = static_cast<uint8_t>(k + 1);
+		}
+	}
+
+	struct TerrainTextureSource {
+		int width;
+		int height;
+		// world height per heightmap texel
+		std::vector<float> heights;
+		std::vector<VaKtxTexture> materials;
+		std::vector<float> transitionHeights;
+		float blendWidth;
+		float uvScale;
+
+		// bilinear between the vertices, x and y in heightmap texels
+		float heightAt(float x, float y) const {
+			x = std::min(std::max(x, 0.0f), static_cast<float>(width - 1));
+			y = std::min(std::max(y, 0.0f), static_cast<float>(height - 1));
+			int x0 = std::min(static_cast<int>(x), width - 2);
+			int y0 = std::min(static_cast<int>(y), height - 2);
+			float fx = x - x0;
+			float fy = y - y0;
+			const float* row0 = heights.data() + static_cast<size_t>(y0) * width;
+			const float* row1 = row0 + width;
+			float top = row0[x0] + (row0[x0 + 1] - row0[x0]) * fx;
+			float bottom = row1[x0] + (row1[x0 + 1] - row1[x0]) * fx;
+			return top + (bottom - top) * fy;
+		}
+	};
+
+	// bilinear with wrapping, like the repeat sampler the materials get on the gpu
+	static void sampleMaterial(const VaKtxTexture& material, uint32_t mip, float u, float v, float color[4]) {
+		int width = static_cast<int>(std::max(material.width >> mip, 1u));
+		int height = static_cast<int>(std::max(material.height >> mip, 1u));
+		const uint8_t* texels = material.data.data() + material.levels[mip].offset;
+
+		float x = u * width - 0.5f;
+		float y = v * height - 0.5f;
+		float fx = x - std::floor(x);
+		float fy = y - std::floor(y);
+		int x0 = ((static_cast<int>(std::floor(x)) % width) + width) % width;
+		int y0 = ((static_cast<int>(std::floor(y)) % height) + height) % height;
+		int x1 = (x0 + 1) % width;
+		int y1 = (y0 + 1) % height;
+
+		const uint8_t* t00 = texels + (static_cast<size_t>(y0) * width + x0) * 4;
+		const uint8_t* t10 = texels + (static_cast<size_t>(y0) * width + x1) * 4;
+		const uint8_t* t01 = texels + (static_cast<size_t>(y1) * width + x0) * 4;
+		const uint8_t* t11 = texels + (static_cast<size_t>(y1) * width + x1) * 4;
+		for (int c = 0; c < 4; c++) {
+			float top = t00[c] + (t10[c] - t00[c]) * fx;
+			float bottom = t01[c] + (t11[c] - t01[c]) * fx;
+			color[c] = top + (bottom - top) * fy;
+		}
+	}
+
 	std::shared_ptr<VaModel> VaTerrain::createTerrainFromFile(VaDevice& device, const std::string& filepath) {
 		int width, height, channels;
 
-		stbi_set_flip_vertically_on_load(false);
+		// the per thread flag, whatever decoded on this thread before may have set it
+		stbi_set_flip_vertically_on_load_thread(false);
 		std::string filepathAdj = FILE_DIR + filepath;
 		stbi_uc* heightmapData = stbi_load(filepathAdj.c_str(), &width, &height, &channels, 0);
 		if (!heightmapData) {
@@ -50,4 +134,127 @@ namespace va {
 
 		return std::make_shared<VaModel>(device, builder);
 	}
-}
\ No newline at end of file
+
+	VaKtxTexture VaTerrain::createSplatMapFromFile(const std::string& filepath, const std::vector<float>& transitionHeights, float blendWidth) {
+		int width, height, channels;
+
+		// the per thread flag, whatever decoded on this thread before may have set it
+		stbi_set_flip_vertically_on_load_thread(false);
+		std::string filepathAdj = FILE_DIR + filepath;
+		stbi_uc* heightmapData = stbi_load(filepathAdj.c_str(), &width, &height, &channels, 0);
+		if (!heightmapData) {
+			throw std::runtime_error("failed to load texture image");
+		}
+
+		VaKtxTexture splatMap{};
+		splatMap.format = VK_FORMAT_R8G8B8A8_UNORM;
+		splatMap.width = static_cast<uint32_t>(width);
+		splatMap.height = static_cast<uint32_t>(height);
+		splatMap.levelCount = 1;
+		splatMap.levels.push_back({ 0, static_cast<size_t>(width) * height * 4 });
+		splatMap.data.resize(splatMap.levels[0].size);
+
+		for (int i = 0; i < height; i++) {
+			for (int j = 0; j < width; j++) {
+				float worldHeight = heightFromTexel(heightmapData[(j + width * i) * channels]);
+
+				uint8_t layer0, layer1;
+				float blend;
+				splatAt(worldHeight, transitionHeights, blendWidth, layer0, layer1, blend);
+
+				uint8_t* texel = splatMap.data.data() + (static_cast<size_t>(j) + static_cast<size_t>(width) * i) * 4;
+				texel[0] = layer0;
+				texel[1] = layer1;
+				texel[2] = static_cast<uint8_t>(blend * 255.0f + 0.5f);
+				texel[3] = 255;
+			}
+		}
+		stbi_image_free(heightmapData);
+
+		return splatMap;
+	}
+
+	VaVirtualTexture::PageGenerator VaTerrain::createPageGenerator(
+		VaDevice& device,
+		const std::string& heightmapFilepath,
+		const std::vector<std::string>& materialFilepaths,
+		const std::vector<float>& transitionHeights,
+		float blendWidth,
+		float uvScale
+	) {
+		auto source = std::make_shared<TerrainTextureSource>();
+		source->transitionHeights = transitionHeights;
+		source->blendWidth = blendWidth;
+		source->uvScale = uvScale;
+
+		int channels;
+		stbi_set_flip_vertically_on_load_thread(false);
+		std::string heightmapAdj = FILE_DIR + heightmapFilepath;
+		stbi_uc* heightmapData = stbi_load(heightmapAdj.c_str(), &source->width, &source->height, &channels, 0);
+		if (!heightmapData) {
+			throw std::runtime_error("failed to load texture image");
+		}
+		source->heights.resize(static_cast<size_t>(source->width) * source->height);
+		for (size_t i = 0; i < source->heights.size(); i++) {
+			source->heights[i] = heightFromTexel(heightmapData[i * channels]);
+		}
+		stbi_image_free(heightmapData);
+
+		// flipped the same way VaImage loads them, so the tiling lines up with the splat map path
+		for (const auto& filepath : materialFilepaths) {
+			int width, height, materialChannels;
+			std::string filepathAdj = FILE_DIR + filepath;
+			stbi_set_flip_vertically_on_load_thread(true);
+			stbi_uc* pixels = stbi_load(filepathAdj.c_str(), &width, &height, &materialChannels, STBI_rgb_alpha);
+			if (!pixels) {
+				throw std::runtime_error("failed to load texture image");
+			}
+			source->materials.push_back(VaMipGenerator::generate(
+				pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), true, device.threadPool()));
+			stbi_image_free(pixels);
+		}
+
+		if (source->materials.empty()) {
+			throw std::runtime_error("terrain needs at least one material");
+		}
+
+		return [source](const VaVirtualTexture::PageRegion& region, uint8_t* texels) {
+			const int size = static_cast<int>(region.virtualSize);
+
+			// the material mip closest to one texel per virtual texel, worked out per material as they can differ in size
+			std::vector<uint32_t> materialMips;
+			for (const auto& material : source->materials) {
+				float texelsPerTexel = static_cast<float>(material.width) * source->uvScale / size;
+				uint32_t mip = texelsPerTexel > 1.0f ? static_cast<uint32_t>(std::log2(texelsPerTexel)) : 0;
+				materialMips.push_back(std::min(mip, material.levelCount - 1));
+			}
+
+			for (uint32_t y = 0; y < VaVirtualTexture::PHYSICAL_PAGE_SIZE; y++) {
+				int virtualY = std::min(std::max(region.y0 + static_cast<int>(y), 0), size - 1);
+				for (uint32_t x = 0; x < VaVirtualTexture::PHYSICAL_PAGE_SIZE; x++) {
+					int virtualX = std::min(std::max(region.x0 + static_cast<int>(x), 0), size - 1);
+
+					// u runs along the heightmap columns and v along the rows, same as the terrain's vertex uvs
+					float u = (virtualX + 0.5f) / size;
+					float v = (virtualY + 0.5f) / size;
+					float worldHeight = source->heightAt(u * source->width, v * source->height);
+
+					uint8_t layer0, layer1;
+					float blend;
+					splatAt(worldHeight, source->transitionHeights, source->blendWidth, layer0, layer1, blend);
+					layer0 = std::min<uint8_t>(layer0, static_cast<uint8_t>(source->materials.size() - 1));
+					layer1 = std::min<uint8_t>(layer1, static_cast<uint8_t>(source->materials.size() - 1));
+
+					float color0[4], color1[4];
+					sampleMaterial(source->materials[layer0], materialMips[layer0], u * source->uvScale, v * source->uvScale, color0);
+					sampleMaterial(source->materials[layer1], materialMips[layer1], u * source->uvScale, v * source->uvScale, color1);
+
+					uint8_t* texel = texels + (static_cast<size_t>(y) * VaVirtualTexture::PHYSICAL_PAGE_SIZE + x) * 4;
+					for (int c = 0; c < 4; c++) {
+						texel[c] = static_cast<uint8_t>(color0[c] + (color1[c] - color0[c]) * blend + 0.5f);
+					}
+				}
+			}
+		};
+	}
+}
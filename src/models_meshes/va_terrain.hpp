@@ -2,10 +2,13 @@
 
 #include "../va_device.hpp"
 #include "va_model.hpp"
+#include "../va_ktx.hpp"
+#include "../va_virtual_texture.hpp"
 
 #include <stb_image.h>
 
 #include <string>
+#include <vector>
 
 #ifndef FILE_DIR
 #define FILE_DIR "../../../"
@@ -16,6 +19,23 @@ namespace va {
 	public:
 		static std::shared_ptr<VaModel> createTerrainFromFile(VaDevice& device, const std::string& filepath);
 
+		// Builds the splat map for a heightmap, one texel per terrain vertex. Red and green are the two material
+		// layers to use there and blue is how much of the second one to blend in. Material i changes over to i + 1
+		// around transitionHeights[i], blending across blendWidth
+		static VaKtxTexture createSplatMapFromFile(const std::string& filepath, const std::vector<float>& transitionHeights, float blendWidth);
+
+		// Pages for a virtual texture covering the whole terrain. Same material blend as the splat map, except
+		// worked out per texel from the interpolated height, with the materials tiled uvScale times across it like
+		// shader.frag does. Everything gets loaded up front and shared between the worker threads
+		static VaVirtualTexture::PageGenerator createPageGenerator(
+			VaDevice& device,
+			const std::string& heightmapFilepath,
+			const std::vector<std::string>& materialFilepaths,
+			const std::vector<float>& transitionHeights,
+			float blendWidth,
+			float uvScale
+		);
+
 		VaTerrain() = default;
 		VaTerrain(const VaTerrain&) = delete;
 		VaTerrain& operator=(const VaTerrain&) = delete;
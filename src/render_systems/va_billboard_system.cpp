@@ -12,34 +12,22 @@
 
 namespace va {
 
-	VaBillboardSystem::VaBillboardSystem(VaDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout) : vaDevice{ device } {
+	VaBillboardSystem::VaBillboardSystem(VaDevice& device, VkRenderPass renderPass, const VaDescriptorSetLayout& globalSetLayout) : vaDevice{ device } {
 		createPipelineLayout(globalSetLayout);
 		createPipeline(renderPass);
 	}
 
-	VaBillboardSystem::~VaBillboardSystem() {
-		vkDestroyPipelineLayout(vaDevice.device(), pipelineLayout, nullptr);
-	}
-
-	void VaBillboardSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
-		objDescriptorSetLayout = VaDescriptorSetLayout::Builder(vaDevice)
-			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
-			.addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-			.addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-			.build();
-		
-		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout, objDescriptorSetLayout->getDescriptorSetLayout() };
+	VaBillboardSystem::~VaBillboardSystem() {}
 
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
-		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-		pipelineLayoutInfo.pushConstantRangeCount = 0;
-		pipelineLayoutInfo.pPushConstantRanges = nullptr;
+	void VaBillboardSystem::createPipelineLayout(const VaDescriptorSetLayout& globalSetLayout) {
+		// the billboard shaders only ever read the global set
+		VaShaderReflection reflection = VaShaderReflection::fromFiles({ "shaders/billboard_vert.spv", "shaders/billboard_frag.spv" });
+		reflection.checkSet(0, globalSetLayout);
+		reflection.checkBlockSize(0, 0, sizeof(GlobalUbo));
 
-		if (vkCreatePipelineLayout(vaDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create pipeline layout");
-		}
+		pipelineLayout = vaDevice.layoutCache().getPipelineLayout(
+			{ globalSetLayout.getDescriptorSetLayout() },
+			reflection.getPushConstantRanges());
 	}
 
 	void VaBillboardSystem::createPipeline(VkRenderPass renderPass) {
@@ -64,21 +52,29 @@ namespace va {
 			vaDevice,
 			"shaders/billboard_vert.spv",
 			"shaders/billboard_frag.spv",
-			pipelineConfig
+			pipelineConfig,
+			true
 		);
 	}
 
 	void VaBillboardSystem::renderBillboard(FrameInfo& frameInfo) {
+		// still compiling on a worker, this just shows up a few frames later
+		if (!vaPipeline->isReady(frameInfo.renderPass)) {
+			return;
+		}
 		vaPipeline->bind(frameInfo.commandBuffer);
 
-		vkCmdBindDescriptorSets(
-			frameInfo.commandBuffer,
-			VK_PIPELINE_BIND_POINT_GRAPHICS,
-			pipelineLayout,
-			0, 1,
-			&frameInfo.globalDescriptorSet,
-			0, nullptr
-		);
+		if (!vaDevice.layoutCache().compatibleUpTo(frameInfo.globalSetBoundWith, pipelineLayout, 0)) {
+			vkCmdBindDescriptorSets(
+				frameInfo.commandBuffer,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipelineLayout,
+				0, 1,
+				&frameInfo.globalDescriptorSet,
+				1, &frameInfo.globalUboOffset
+			);
+			frameInfo.globalSetBoundWith = pipelineLayout;
+		}
 
 		vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
 	}
@@ -13,54 +13,84 @@
 namespace va {
 	struct SimplePushConstantData {
 		glm::mat4 modelMatrix{ 1.0f };
+		// bindless table slots, the regular shaders don't declare these
+		uint32_t textureIndex = VaBindlessTable::DEFAULT_SLOT;
+		uint32_t terrainMaterialsIndex = VaBindlessTable::DEFAULT_SLOT;
+		uint32_t splatMapIndex = VaBindlessTable::DEFAULT_SLOT;
 	};
 
-	VaRenderSystem::VaRenderSystem(VaDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout) : vaDevice{ device } {
+	VaRenderSystem::VaRenderSystem(
+		VaDevice& device,
+		VkRenderPass renderPass,
+		const VaDescriptorSetLayout& globalSetLayout,
+		VaBindlessTable* bindlessTable,
+		const VaImage& defaultTexture,
+		const VaImage& defaultTextureArray)
+		: vaDevice{ device }, bindlessTable{ bindlessTable }, defaultTexture{ defaultTexture }, defaultTextureArray{ defaultTextureArray } {
+		pushTextures = bindlessTable == nullptr && vaDevice.hasPushDescriptors();
 		createPipelineLayout(globalSetLayout);
-		createPipeline(renderPass);
+		// the common ones start compiling right away, anything else once something uses it
+		getVariant(Material::Untextured, 1.0f, renderPass);
+		getVariant(Material::Textured, 1.0f, renderPass);
 	}
 
-	VaRenderSystem::~VaRenderSystem() {
-		vkDestroyPipelineLayout(vaDevice.device(), pipelineLayout, nullptr);
+	VaRenderSystem::~VaRenderSystem() {}
+
+	void VaRenderSystem::createPipelineLayout(const VaDescriptorSetLayout& globalSetLayout) {
+		// the variants only differ in specialization constants, so they all share this
+		reflection = VaShaderReflection::fromFiles({ "shaders/vert.spv", fragShaderPath() });
+		// without these every variant would quietly run the same unspecialized shader
+		reflection.checkSpecConstant(0);
+		reflection.checkSpecConstant(1);
+		reflection.checkSet(0, globalSetLayout);
+		reflection.checkBlockSize(0, 0, sizeof(GlobalUbo));
+
+		VkDescriptorSetLayout objSetLayout;
+		if (bindlessTable != nullptr) {
+			reflection.checkSet(1, bindlessTable->getSetLayout());
+			objSetLayout = bindlessTable->getDescriptorSetLayout();
+		}
+		else {
+			objDescriptorSetLayout = vaDevice.layoutCache().getSetLayout(
+				reflection.getSetBindings(1),
+				pushTextures ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR : 0);
+			objSetLayout = objDescriptorSetLayout->getDescriptorSetLayout();
+		}
+
+		auto pushConstantRanges = reflection.getPushConstantRanges();
+		assert(pushConstantRanges.size() == 1 && pushConstantRanges[0].size <= sizeof(SimplePushConstantData) && "shaders push more than SimplePushConstantData has");
+		pushConstantRange = pushConstantRanges[0];
+		pipelineLayout = vaDevice.layoutCache().getPipelineLayout({ globalSetLayout.getDescriptorSetLayout(), objSetLayout }, pushConstantRanges);
 	}
 
-	void VaRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
-		VkPushConstantRange pushConstantRange{};
-		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-		pushConstantRange.offset = 0;
-		pushConstantRange.size = sizeof(SimplePushConstantData);
-
-		objDescriptorSetLayout = VaDescriptorSetLayout::Builder(vaDevice)
-			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
-			.addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-			.addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-			.addBinding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-			.addBinding(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-			.build();
-
-		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout, objDescriptorSetLayout->getDescriptorSetLayout() };
-		//std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout };
-
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
-		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-		pipelineLayoutInfo.pushConstantRangeCount = 1;
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-
-		if (vkCreatePipelineLayout(vaDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create pipeline layout");
+	std::string VaRenderSystem::fragShaderPath() const {
+		return bindlessTable != nullptr ? "shaders/bindless_frag.spv" : "shaders/frag.spv";
+	}
+
+	VaRenderSystem::Material VaRenderSystem::materialOf(const VaGameObject& gameObject) {
+		if (gameObject.terrainMaterials != nullptr) {
+			return Material::Terrain;
 		}
+		return gameObject.texture != nullptr ? Material::Textured : Material::Untextured;
 	}
 
-	void VaRenderSystem::createPipeline(VkRenderPass renderPass) {
+	VaPipeline& VaRenderSystem::getVariant(Material material, float uvWrap, VkRenderPass renderPass) {
+		// the untextured branch never looks at the uvs
+		if (material == Material::Untextured) {
+			uvWrap = 1.0f;
+		}
+		auto& variant = variants[{ material, uvWrap }];
+		if (variant != nullptr) {
+			return *variant;
+		}
+
 		assert(pipelineLayout != nullptr && "cannot create pipeline before pipeline layout");
 
 		PipelineConfigInfo pipelineConfig{};
 		VaPipeline::defaultPipelineConfigInfo(pipelineConfig);
 
 		auto bindingDescriptions = VaModel::Vertex::getBindingDescriptions();
-		auto attributeDescriptions = VaModel::Vertex::getAttributeDescriptions();
+		auto attributeDescriptions = reflection.selectAttributes(VaModel::Vertex::getAttributeDescriptions());
 		pipelineConfig.vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 		pipelineConfig.vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
 		pipelineConfig.vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
@@ -69,49 +99,102 @@ namespace va {
 
 		pipelineConfig.renderPass = renderPass;
 		pipelineConfig.pipelineLayout = pipelineLayout;
-		vaPipeline = std::make_unique<VaPipeline>(
+		pipelineConfig.specialization
+			.set(0, static_cast<uint32_t>(material))
+			.set(1, uvWrap);
+		variant = std::make_unique<VaPipeline>(
 			vaDevice,
 			"shaders/vert.spv",
-			"shaders/frag.spv",
-			pipelineConfig
+			fragShaderPath(),
+			pipelineConfig,
+			true
 		);
+		return *variant;
 	}
 
 	void VaRenderSystem::renderGameObjects(FrameInfo& frameInfo) {
-		vaPipeline->bind(frameInfo.commandBuffer);
-
-		vkCmdBindDescriptorSets(
-			frameInfo.commandBuffer,
-			VK_PIPELINE_BIND_POINT_GRAPHICS,
-			pipelineLayout,
-			0, 1,
-			&frameInfo.globalDescriptorSet,
-			0, nullptr
-		);
+		if (!vaDevice.layoutCache().compatibleUpTo(frameInfo.globalSetBoundWith, pipelineLayout, 0)) {
+			vkCmdBindDescriptorSets(
+				frameInfo.commandBuffer,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipelineLayout,
+				0, 1,
+				&frameInfo.globalDescriptorSet,
+				1, &frameInfo.globalUboOffset
+			);
+			frameInfo.globalSetBoundWith = pipelineLayout;
+		}
 
+		if (bindlessTable != nullptr) {
+			VkDescriptorSet textureSet = bindlessTable->getDescriptorSet();
+			vkCmdBindDescriptorSets(
+				frameInfo.commandBuffer,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipelineLayout,
+				1, 1,
+				&textureSet,
+				0, nullptr);
+		}
+
+		VaPipeline* boundPipeline = nullptr;
 		for (auto& kv : frameInfo.gameObjects) {
 			auto& obj = kv.second;
 			if (obj.model == nullptr) continue;
+			// VaTerrainSystem draws these
+			if (obj.virtualTexture != nullptr) continue;
+
+			// still compiling on a worker, the object just shows up a few frames later
+			// built against the frame's render pass, the one this was made with is gone after a resize
+			VaPipeline& pipeline = getVariant(materialOf(obj), obj.uvScale, frameInfo.renderPass);
+			if (!pipeline.isReady(frameInfo.renderPass)) continue;
+			if (&pipeline != boundPipeline) {
+				pipeline.bind(frameInfo.commandBuffer);
+				boundPipeline = &pipeline;
+			}
 
 			SimplePushConstantData push{};
 			push.modelMatrix = obj.transform.mat4();
+			if (bindlessTable != nullptr) {
+				push.textureIndex = bindlessTable->indexOf(obj.texture.get());
+				push.terrainMaterialsIndex = bindlessTable->indexOf(obj.terrainMaterials.get());
+				push.splatMapIndex = bindlessTable->indexOf(obj.terrainSplatMap.get());
+			}
 
+			// only as much as the shaders declare, frag.spv doesn't have the bindless indices
 			vkCmdPushConstants(
 				frameInfo.commandBuffer,
 				pipelineLayout,
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-				0,
-				sizeof(SimplePushConstantData),
-				&push);
+				pushConstantRange.stageFlags,
+				pushConstantRange.offset,
+				pushConstantRange.size,
+				reinterpret_cast<const char*>(&push) + pushConstantRange.offset);
+
+			if (bindlessTable == nullptr) {
+				auto textureInfo = (obj.texture != nullptr ? *obj.texture : defaultTexture).getInfo();
+				auto materialsInfo = (obj.terrainMaterials != nullptr ? *obj.terrainMaterials : defaultTextureArray).getInfo();
+				auto splatMapInfo = (obj.terrainSplatMap != nullptr ? *obj.terrainSplatMap : defaultTexture).getInfo();
+
+				VaDescriptorWriter writer{ *objDescriptorSetLayout };
+				writer.writeImage(2, &textureInfo)
+					.writeImage(3, &materialsInfo)
+					.writeImage(4, &splatMapInfo);
+				if (pushTextures) {
+					writer.push(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1);
+				}
+				else {
+					// objects with the same textures end up sharing the set
+					VkDescriptorSet textureSet;
+					frameInfo.frameDescriptors.build(writer, textureSet);
+					vkCmdBindDescriptorSets(
+						frameInfo.commandBuffer,
+						VK_PIPELINE_BIND_POINT_GRAPHICS,
+						pipelineLayout,
+						1, 1,
+						&textureSet,
+						0, nullptr);
+				}
+			}
 
-			vkCmdBindDescriptorSets(
-				frameInfo.commandBuffer,
-				VK_PIPELINE_BIND_POINT_GRAPHICS,
-				pipelineLayout,
-				1, 1,
-				&obj.descriptorSet,
-				0, nullptr);
-		
 			obj.model->bind(frameInfo.commandBuffer);
 			obj.model->draw(frameInfo.commandBuffer);
 		}
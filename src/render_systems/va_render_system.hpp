@@ -7,14 +7,35 @@
 #include "../va_frame_info.hpp"
 #include "../va_descriptors.hpp"
 #include "../va_cubemap.hpp"
+#include "../va_bindless_table.hpp"
+#include "../va_shader_reflection.hpp"
 
+#include <map>
 #include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace va {
 	class VaRenderSystem {
 	public:
-		VaRenderSystem(VaDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+		// which branch of shader.frag a pipeline gets specialized for, the values match its MATERIAL constants
+		enum class Material : uint32_t {
+			Untextured = 0,
+			Textured = 1,
+			Terrain = 2
+		};
+
+		// with a bindless table every object draws out of it. Without one, each object's textures (or the defaults
+		// for whatever it doesn't have) get pushed per draw, or written into a set that only lives for the frame
+		// when the device doesn't have push descriptors
+		VaRenderSystem(
+			VaDevice& device,
+			VkRenderPass renderPass,
+			const VaDescriptorSetLayout& globalSetLayout,
+			VaBindlessTable* bindlessTable,
+			const VaImage& defaultTexture,
+			const VaImage& defaultTextureArray);
 		~VaRenderSystem();
 
 		VaRenderSystem(const VaRenderSystem&) = delete;
@@ -24,11 +45,22 @@ namespace va {
 
 	private:
 		VaDevice& vaDevice;
-		std::unique_ptr<VaPipeline> vaPipeline;
+		// one specialized pipeline per material and uv wrap, made the first time an object needs it
+		std::map<std::pair<Material, float>, std::unique_ptr<VaPipeline>> variants;
+		// both of these come from the device's layout cache, shaders declaring the same sets share them
 		VkPipelineLayout pipelineLayout;
-		std::unique_ptr<VaDescriptorSetLayout> objDescriptorSetLayout;
+		std::shared_ptr<VaDescriptorSetLayout> objDescriptorSetLayout;
+		VaShaderReflection reflection;
+		VkPushConstantRange pushConstantRange{};
+		VaBindlessTable* bindlessTable;
+		const VaImage& defaultTexture;
+		const VaImage& defaultTextureArray;
+		bool pushTextures = false;
 
-		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-		void createPipeline(VkRenderPass renderPass);
+		void createPipelineLayout(const VaDescriptorSetLayout& globalSetLayout);
+		std::string fragShaderPath() const;
+		// renderPass is only used when the variant doesn't exist yet
+		VaPipeline& getVariant(Material material, float uvWrap, VkRenderPass renderPass);
+		static Material materialOf(const VaGameObject& gameObject);
 	};
 }
\ No newline at end of file
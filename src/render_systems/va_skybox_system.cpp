@@ -12,36 +12,23 @@
 
 namespace va {
 
-	VaSkyboxSystem::VaSkyboxSystem(VaDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout) : vaDevice{ device } {
+	VaSkyboxSystem::VaSkyboxSystem(VaDevice& device, VkRenderPass renderPass, const VaDescriptorSetLayout& globalSetLayout) : vaDevice{ device } {
 		createPipelineLayout(globalSetLayout);
 		createPipeline(renderPass);
 	}
 
-	VaSkyboxSystem::~VaSkyboxSystem() {
-		vkDestroyPipelineLayout(vaDevice.device(), pipelineLayout, nullptr);
-	}
+	VaSkyboxSystem::~VaSkyboxSystem() {}
 
-	void VaSkyboxSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
-		objDescriptorSetLayout = VaDescriptorSetLayout::Builder(vaDevice)
-			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
-			.addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-			.addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-			.addBinding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-			.addBinding(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-			.build();
-		
-		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout, objDescriptorSetLayout->getDescriptorSetLayout() };
-
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
-		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-		pipelineLayoutInfo.pushConstantRangeCount = 0;
-		pipelineLayoutInfo.pPushConstantRanges = nullptr;
-
-		if (vkCreatePipelineLayout(vaDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create pipeline layout");
-		}
+	void VaSkyboxSystem::createPipelineLayout(const VaDescriptorSetLayout& globalSetLayout) {
+		// skybox.frag reads the cubemap out of set 1, which gets the global set bound to it a second time
+		VaShaderReflection reflection = VaShaderReflection::fromFiles({ "shaders/skybox_vert.spv", "shaders/skybox_frag.spv" });
+		reflection.checkSet(0, globalSetLayout);
+		reflection.checkSet(1, globalSetLayout);
+		reflection.checkBlockSize(0, 0, sizeof(GlobalUbo));
+
+		pipelineLayout = vaDevice.layoutCache().getPipelineLayout(
+			{ globalSetLayout.getDescriptorSetLayout(), globalSetLayout.getDescriptorSetLayout() },
+			reflection.getPushConstantRanges());
 	}
 
 	void VaSkyboxSystem::createPipeline(VkRenderPass renderPass) {
@@ -67,21 +54,29 @@ namespace va {
 			vaDevice,
 			"shaders/skybox_vert.spv",
 			"shaders/skybox_frag.spv",
-			pipelineConfig
+			pipelineConfig,
+			true
 		);
 	}
 
 	void VaSkyboxSystem::renderSkybox(FrameInfo& frameInfo) {
+		// still compiling on a worker, this just shows up a few frames later
+		if (!vaPipeline->isReady(frameInfo.renderPass)) {
+			return;
+		}
 		vaPipeline->bind(frameInfo.commandBuffer);
 
-		vkCmdBindDescriptorSets(
-			frameInfo.commandBuffer,
-			VK_PIPELINE_BIND_POINT_GRAPHICS,
-			pipelineLayout,
-			0, 1,
-			&frameInfo.globalDescriptorSet,
-			0, nullptr
-		);
+		if (!vaDevice.layoutCache().compatibleUpTo(frameInfo.globalSetBoundWith, pipelineLayout, 0)) {
+			vkCmdBindDescriptorSets(
+				frameInfo.commandBuffer,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipelineLayout,
+				0, 1,
+				&frameInfo.globalDescriptorSet,
+				1, &frameInfo.globalUboOffset
+			);
+			frameInfo.globalSetBoundWith = pipelineLayout;
+		}
 
 		vkCmdBindDescriptorSets(
 			frameInfo.commandBuffer,
@@ -89,7 +84,7 @@ namespace va {
 			pipelineLayout,
 			1, 1,
 			&frameInfo.globalDescriptorSet,
-			0, nullptr
+			1, &frameInfo.globalUboOffset
 		);
 
 		vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
@@ -7,6 +7,7 @@
 #include "../va_frame_info.hpp"
 #include "../va_descriptors.hpp"
 #include "../va_cubemap.hpp"
+#include "../va_shader_reflection.hpp"
 
 #include <memory>
 #include <vector>
@@ -14,7 +15,7 @@
 namespace va {
 	class VaSkyboxSystem {
 	public:
-		VaSkyboxSystem(VaDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+		VaSkyboxSystem(VaDevice& device, VkRenderPass renderPass, const VaDescriptorSetLayout& globalSetLayout);
 		~VaSkyboxSystem();
 
 		VaSkyboxSystem(const VaSkyboxSystem&) = delete;
@@ -25,10 +26,10 @@ namespace va {
 	private:
 		VaDevice& vaDevice;
 		std::unique_ptr<VaPipeline> vaPipeline;
+		// from the device's layout cache
 		VkPipelineLayout pipelineLayout;
-		std::unique_ptr<VaDescriptorSetLayout> objDescriptorSetLayout;
 
-		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
+		void createPipelineLayout(const VaDescriptorSetLayout& globalSetLayout);
 		void createPipeline(VkRenderPass renderPass);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "va_terrain_system.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <stdexcept>
+#include <cassert>
+
+namespace va {
+	struct TerrainPushConstantData {
+		glm::mat4 modelMatrix{ 1.0f };
+		float uvScale = 1.0f;
+	};
+
+	VaTerrainSystem::VaTerrainSystem(VaDevice& device, VkRenderPass renderPass, const VaDescriptorSetLayout& globalSetLayout, VaVirtualTexture& virtualTexture)
+		: vaDevice{ device } {
+		detailSampler = vaDevice.samplerCache().getSampler(VaSamplerPreset::PixelArt);
+		createPipelineLayout(globalSetLayout, virtualTexture.getSetLayout());
+		createPipeline(renderPass);
+	}
+
+	VaTerrainSystem::~VaTerrainSystem() {}
+
+	void VaTerrainSystem::createPipelineLayout(const VaDescriptorSetLayout& globalSetLayout, const VaDescriptorSetLayout& virtualTextureSetLayout) {
+		reflection = VaShaderReflection::fromFiles({ "shaders/vert.spv", "shaders/terrain_frag.spv" });
+		reflection.checkSet(0, globalSetLayout);
+		reflection.checkSet(1, virtualTextureSetLayout);
+		reflection.checkBlockSize(0, 0, sizeof(GlobalUbo));
+		detailSetLayout = vaDevice.layoutCache().getSetLayout(reflection.getSetBindings(2));
+
+		auto pushConstantRanges = reflection.getPushConstantRanges();
+		assert(pushConstantRanges.size() == 1 && pushConstantRanges[0].size <= sizeof(TerrainPushConstantData) && "shaders push more than TerrainPushConstantData has");
+		pushConstantRange = pushConstantRanges[0];
+		pipelineLayout = vaDevice.layoutCache().getPipelineLayout(
+			{ globalSetLayout.getDescriptorSetLayout(), virtualTextureSetLayout.getDescriptorSetLayout(), detailSetLayout->getDescriptorSetLayout() },
+			pushConstantRanges);
+	}
+
+	void VaTerrainSystem::createPipeline(VkRenderPass renderPass) {
+		assert(pipelineLayout != nullptr && "cannot create pipeline before pipeline layout");
+
+		PipelineConfigInfo pipelineConfig{};
+		VaPipeline::defaultPipelineConfigInfo(pipelineConfig);
+
+		auto bindingDescriptions = VaModel::Vertex::getBindingDescriptions();
+		auto attributeDescriptions = reflection.selectAttributes(VaModel::Vertex::getAttributeDescriptions());
+		pipelineConfig.vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		pipelineConfig.vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+		pipelineConfig.vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+		pipelineConfig.vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+		pipelineConfig.vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+		pipelineConfig.renderPass = renderPass;
+		pipelineConfig.pipelineLayout = pipelineLayout;
+		vaPipeline = std::make_unique<VaPipeline>(
+			vaDevice,
+			"shaders/vert.spv",
+			"shaders/terrain_frag.spv",
+			pipelineConfig,
+			true
+		);
+	}
+
+	void VaTerrainSystem::renderGameObjects(FrameInfo& frameInfo) {
+		// still compiling on a worker, this just shows up a few frames later
+		if (!vaPipeline->isReady(frameInfo.renderPass)) {
+			return;
+		}
+		vaPipeline->bind(frameInfo.commandBuffer);
+
+		if (!vaDevice.layoutCache().compatibleUpTo(frameInfo.globalSetBoundWith, pipelineLayout, 0)) {
+			vkCmdBindDescriptorSets(
+				frameInfo.commandBuffer,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipelineLayout,
+				0, 1,
+				&frameInfo.globalDescriptorSet,
+				1, &frameInfo.globalUboOffset
+			);
+			frameInfo.globalSetBoundWith = pipelineLayout;
+		}
+
+		for (auto& kv : frameInfo.gameObjects) {
+			auto& obj = kv.second;
+			if (obj.model == nullptr || obj.virtualTexture == nullptr) continue;
+			assert(obj.terrainMaterials != nullptr && obj.terrainSplatMap != nullptr && "virtual textured terrain needs its materials for the detail");
+
+			// the feedback buffer is per frame, so so is the set
+			VkDescriptorSet textureSet = obj.virtualTexture->getDescriptorSet(frameInfo.frameIndex);
+			vkCmdBindDescriptorSets(
+				frameInfo.commandBuffer,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipelineLayout,
+				1, 1,
+				&textureSet,
+				0, nullptr);
+
+			auto materialsInfo = obj.terrainMaterials->getInfo();
+			materialsInfo.sampler = detailSampler;
+			auto splatMapInfo = obj.terrainSplatMap->getInfo();
+			VaDescriptorWriter writer{ *detailSetLayout };
+			writer.writeImage(0, &materialsInfo)
+				.writeImage(1, &splatMapInfo);
+			VkDescriptorSet detailSet;
+			frameInfo.frameDescriptors.build(writer, detailSet);
+			vkCmdBindDescriptorSets(
+				frameInfo.commandBuffer,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipelineLayout,
+				2, 1,
+				&detailSet,
+				0, nullptr);
+
+			TerrainPushConstantData push{};
+			push.modelMatrix = obj.transform.mat4();
+			push.uvScale = obj.uvScale;
+			vkCmdPushConstants(
+				frameInfo.commandBuffer,
+				pipelineLayout,
+				pushConstantRange.stageFlags,
+				pushConstantRange.offset,
+				pushConstantRange.size,
+				reinterpret_cast<const char*>(&push) + pushConstantRange.offset);
+
+			obj.model->bind(frameInfo.commandBuffer);
+			obj.model->draw(frameInfo.commandBuffer);
+		}
+	}
+}
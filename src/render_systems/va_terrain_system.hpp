@@ -0,0 +1,43 @@
+#pragma once
+
+#include "../va_pipeline.hpp"
+#include "../va_device.hpp"
+#include "../va_game_object.hpp"
+#include "../va_camera.hpp"
+#include "../va_frame_info.hpp"
+#include "../va_descriptors.hpp"
+#include "../va_virtual_texture.hpp"
+#include "../va_shader_reflection.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace va {
+	// Draws the objects that have a virtual texture, with terrain.frag looking their texels up through its page
+	// table. Every one of them has to use virtualTexture, its set layout is baked into the pipeline layout. Their
+	// terrainMaterials and terrainSplatMap go in set 2, for the detail the virtual texture is too coarse for
+	class VaTerrainSystem {
+	public:
+		VaTerrainSystem(VaDevice& device, VkRenderPass renderPass, const VaDescriptorSetLayout& globalSetLayout, VaVirtualTexture& virtualTexture);
+		~VaTerrainSystem();
+
+		VaTerrainSystem(const VaTerrainSystem&) = delete;
+		VaTerrainSystem& operator=(const VaTerrainSystem&) = delete;
+
+		void renderGameObjects(FrameInfo& frameInfo);
+
+	private:
+		VaDevice& vaDevice;
+		std::unique_ptr<VaPipeline> vaPipeline;
+		// from the device's layout cache
+		VkPipelineLayout pipelineLayout;
+		VaShaderReflection reflection;
+		VkPushConstantRange pushConstantRange{};
+		std::shared_ptr<VaDescriptorSetLayout> detailSetLayout;
+		// the materials' own sampler never goes finer than half their mip chain, the detail has to reach mip 0
+		VkSampler detailSampler;
+
+		void createPipelineLayout(const VaDescriptorSetLayout& globalSetLayout, const VaDescriptorSetLayout& virtualTextureSetLayout);
+		void createPipeline(VkRenderPass renderPass);
+	};
+}
@@ -0,0 +1,252 @@
+#include "va_asset_manager.hpp"
+#include "va_hash.hpp"
+
+#include "models_meshes/va_terrain.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#ifndef FILE_DIR
+#define FILE_DIR "../../../"
+#endif
+
+namespace va {
+	VaAssetManager::VaAssetManager(VaDevice& device, VaTextureStreamer* streamer, bool hashContents)
+		: vaDevice{ device }, textureStreamer{ streamer }, hashContents{ hashContents } {}
+
+	std::shared_ptr<VaImage> VaAssetManager::getImage(const std::string& filepath) {
+		return getImages({ filepath })[0];
+	}
+
+	std::vector<std::shared_ptr<VaImage>> VaAssetManager::getImages(const std::vector<std::string>& filepaths) {
+		std::vector<std::shared_ptr<VaImage>> result(filepaths.size());
+		std::vector<std::string> keys(filepaths.size());
+		std::vector<uint64_t> contentHashes(filepaths.size(), 0);
+
+		// indices into filepaths of the first request for each file that actually needs loading
+		std::vector<size_t> toLoad;
+		std::unordered_map<std::string, size_t> loadingKeys;
+		std::unordered_map<uint64_t, size_t> loadingContents;
+		for (size_t i = 0; i < filepaths.size(); i++) {
+			keys[i] = canonicalKey(filepaths[i]);
+			auto cached = images.find(keys[i]);
+			if (cached != images.end()) {
+				result[i] = cached->second.asset;
+				hits++;
+				continue;
+			}
+			// the same file twice in one call
+			if (loadingKeys.count(keys[i])) {
+				hits++;
+				continue;
+			}
+
+			misses++;
+			if (hashContents) {
+				contentHashes[i] = hashFile(filepaths[i]);
+				if (auto same = findByContent(images, contentHashes[i])) {
+					result[i] = same;
+					images[keys[i]] = { same, contentHashes[i] };
+					contentHits++;
+					continue;
+				}
+				if (contentHashes[i] != 0 && loadingContents.count(contentHashes[i])) {
+					loadingKeys[keys[i]] = loadingContents[contentHashes[i]];
+					contentHits++;
+					continue;
+				}
+				loadingContents[contentHashes[i]] = i;
+			}
+			loadingKeys[keys[i]] = i;
+			toLoad.push_back(i);
+		}
+
+		if (!toLoad.empty()) {
+			std::vector<std::string> loadPaths;
+			loadPaths.reserve(toLoad.size());
+			for (size_t i : toLoad) {
+				loadPaths.push_back(filepaths[i]);
+			}
+
+			std::vector<std::shared_ptr<VaImage>> loaded = textureStreamer
+				? textureStreamer->createImagesFromFiles(loadPaths)
+				: VaImage::createImagesFromFiles(vaDevice, loadPaths);
+			for (size_t j = 0; j < toLoad.size(); j++) {
+				size_t i = toLoad[j];
+				result[i] = loaded[j];
+				images[keys[i]] = { loaded[j], contentHashes[i] };
+			}
+		}
+
+		// duplicates within this call and content matches against something loaded in it
+		for (size_t i = 0; i < filepaths.size(); i++) {
+			if (!result[i]) {
+				result[i] = result[loadingKeys[keys[i]]];
+				images.emplace(keys[i], Entry<VaImage>{ result[i], contentHashes[i] });
+			}
+		}
+		return result;
+	}
+
+	std::shared_ptr<VaModel> VaAssetManager::getModel(const std::string& filepath, float uvWrapScale) {
+		std::string key = canonicalKey(filepath) + "|" + std::to_string(uvWrapScale);
+		auto cached = models.find(key);
+		if (cached != models.end()) {
+			hits++;
+			return cached->second.asset;
+		}
+
+		misses++;
+		uint64_t contentHash = 0;
+		if (hashContents) {
+			contentHash = hashFile(filepath);
+			if (contentHash != 0) {
+				// the scale changes the uvs, so it has to match as well
+				hashCombine(contentHash, std::hash<float>{}(uvWrapScale));
+			}
+			if (auto same = findByContent(models, contentHash)) {
+				models[key] = { same, contentHash };
+				contentHits++;
+				return same;
+			}
+		}
+
+		std::shared_ptr<VaModel> model = VaModel::createModelFromFile(vaDevice, filepath, uvWrapScale);
+		models[key] = { model, contentHash };
+		return model;
+	}
+
+	std::shared_ptr<VaImage> VaAssetManager::getImageArray(const std::vector<std::string>& filepaths) {
+		std::string key = "array";
+		for (const auto& filepath : filepaths) {
+			key += "|" + canonicalKey(filepath);
+		}
+		return getGenerated(images, key, [&]() { return VaImage::createArrayFromFiles(vaDevice, filepaths); });
+	}
+
+	std::shared_ptr<VaModel> VaAssetManager::getTerrain(const std::string& heightmapFilepath) {
+		return getGenerated(models, "terrain|" + canonicalKey(heightmapFilepath), [&]() {
+			return VaTerrain::createTerrainFromFile(vaDevice, heightmapFilepath);
+		});
+	}
+
+	std::shared_ptr<VaImage> VaAssetManager::getSplatMap(const std::string& heightmapFilepath, const std::vector<float>& transitionHeights, float blendWidth) {
+		std::string key = "splat|" + canonicalKey(heightmapFilepath) + "|" + std::to_string(blendWidth);
+		for (float height : transitionHeights) {
+			key += "|" + std::to_string(height);
+		}
+		return getGenerated(images, key, [&]() {
+			return std::make_shared<VaImage>(vaDevice, VaTerrain::createSplatMapFromFile(heightmapFilepath, transitionHeights, blendWidth));
+		});
+	}
+
+	template <typename T, typename Create>
+	std::shared_ptr<T> VaAssetManager::getGenerated(std::unordered_map<std::string, Entry<T>>& entries, const std::string& key, Create create) {
+		auto cached = entries.find(key);
+		if (cached != entries.end()) {
+			hits++;
+			return cached->second.asset;
+		}
+
+		misses++;
+		std::shared_ptr<T> asset = create();
+		entries[key] = { asset, 0 };
+		return asset;
+	}
+
+	uint32_t VaAssetManager::evictUnused() {
+		uint32_t count = evictUnused(images) + evictUnused(models);
+		evicted += count;
+		return count;
+	}
+
+	template <typename T>
+	uint32_t VaAssetManager::evictUnused(std::unordered_map<std::string, Entry<T>>& entries) {
+		// an asset shared by several paths is held once per path, so count those up first
+		std::unordered_map<const T*, long> heldHere;
+		for (const auto& [key, entry] : entries) {
+			heldHere[entry.asset.get()]++;
+		}
+
+		uint32_t count = 0;
+		for (auto it = entries.begin(); it != entries.end();) {
+			if (it->second.asset.use_count() <= heldHere[it->second.asset.get()]) {
+				it = entries.erase(it);
+				count++;
+			}
+			else {
+				++it;
+			}
+		}
+		return count;
+	}
+
+	void VaAssetManager::clear() {
+		images.clear();
+		models.clear();
+	}
+
+	std::string VaAssetManager::canonicalKey(const std::string& filepath) const {
+		std::error_code error;
+		std::filesystem::path canonical = std::filesystem::weakly_canonical(FILE_DIR + filepath, error);
+		if (error) {
+			return std::filesystem::path{ filepath }.lexically_normal().generic_string();
+		}
+		return canonical.generic_string();
+	}
+
+	uint64_t VaAssetManager::hashFile(const std::string& filepath) {
+		std::ifstream file{ FILE_DIR + filepath, std::ios::binary };
+		if (!file) {
+			return 0;
+		}
+
+		uint64_t hash = FNV_OFFSET_BASIS;
+		char buffer[64 * 1024];
+		while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+			hash = fnv1a(buffer, static_cast<size_t>(file.gcount()), hash);
+		}
+		return hash;
+	}
+
+	template <typename T>
+	std::shared_ptr<T> VaAssetManager::findByContent(const std::unordered_map<std::string, Entry<T>>& entries, uint64_t contentHash) const {
+		if (contentHash == 0) {
+			return nullptr;
+		}
+		for (const auto& [key, entry] : entries) {
+			if (entry.contentHash == contentHash) {
+				return entry.asset;
+			}
+		}
+		return nullptr;
+	}
+
+	VaAssetManager::Stats VaAssetManager::getStats() const {
+		Stats stats{};
+		stats.images = static_cast<uint32_t>(images.size());
+		stats.models = static_cast<uint32_t>(models.size());
+		stats.hits = hits;
+		stats.misses = misses;
+		stats.contentHits = contentHits;
+		stats.evicted = evicted;
+		return stats;
+	}
+
+	std::string VaAssetManager::summary() const {
+		Stats current = getStats();
+		uint64_t lookups = current.hits + current.misses;
+		double hitRate = lookups > 0 ? 100.0 * static_cast<double>(current.hits) / static_cast<double>(lookups) : 0.0;
+		char buffer[256];
+		snprintf(buffer, sizeof(buffer), "assets: %u images, %u models | %llu hits, %llu misses (%.1f%% hit rate), %llu shared by content, %llu evicted",
+			current.images,
+			current.models,
+			static_cast<unsigned long long>(current.hits),
+			static_cast<unsigned long long>(current.misses),
+			hitRate,
+			static_cast<unsigned long long>(current.contentHits),
+			static_cast<unsigned long long>(current.evicted));
+		return buffer;
+	}
+}
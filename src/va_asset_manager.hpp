@@ -0,0 +1,89 @@
+#pragma once
+
+#include "va_device.hpp"
+#include "va_image.hpp"
+#include "va_texture_streamer.hpp"
+#include "models_meshes/va_model.hpp"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace va {
+	// Makes sure every image and model file only gets loaded once. Anything asked for again gets a shared handle to
+	// the copy that's already on the gpu. Entries are keyed by canonical path, so "textures/./a.png" and "textures/a.png"
+	// are the same thing. With content hashing on, two different files with identical bytes get shared too.
+	//
+	// The manager holds a reference to everything it loaded, so nothing goes away just because the last object using
+	// it did. evictUnused() drops whatever the manager is the only one still holding. Main thread only, same as the
+	// uploads underneath it.
+	class VaAssetManager {
+	public:
+		struct Stats {
+			uint32_t images = 0;
+			uint32_t models = 0;
+			uint64_t hits = 0;
+			uint64_t misses = 0;
+			// misses on the path that still ended up sharing an existing asset because the file contents matched
+			uint64_t contentHits = 0;
+			uint64_t evicted = 0;
+		};
+
+		// images go through the streamer when there is one, so they only start out with their small mips
+		VaAssetManager(VaDevice& device, VaTextureStreamer* streamer = nullptr, bool hashContents = false);
+
+		VaAssetManager(const VaAssetManager&) = delete;
+		VaAssetManager& operator=(const VaAssetManager&) = delete;
+
+		std::shared_ptr<VaImage> getImage(const std::string& filepath);
+		// everything that isn't cached yet loads together on the thread pool, like VaImage::createImagesFromFiles
+		std::vector<std::shared_ptr<VaImage>> getImages(const std::vector<std::string>& filepaths);
+		// the same file with a different uvWrapScale is a different model
+		std::shared_ptr<VaModel> getModel(const std::string& filepath, float uvWrapScale);
+		// one image with a layer per file, the same files in the same order are the same array. Not streamed
+		std::shared_ptr<VaImage> getImageArray(const std::vector<std::string>& filepaths);
+		// VaTerrain's mesh and splat map for a heightmap. Neither is shared by content, only by heightmap path (and
+		// for the splat map, by the heights it was made with)
+		std::shared_ptr<VaModel> getTerrain(const std::string& heightmapFilepath);
+		std::shared_ptr<VaImage> getSplatMap(const std::string& heightmapFilepath, const std::vector<float>& transitionHeights, float blendWidth);
+
+		// drops every entry nothing outside the manager still holds, returns how many went. The assets themselves get
+		// destroyed through the deletion queue, so this is fine to call while frames are in flight
+		uint32_t evictUnused();
+		void clear();
+
+		Stats getStats() const;
+		std::string summary() const;
+
+	private:
+		template <typename T>
+		struct Entry {
+			std::shared_ptr<T> asset;
+			// 0 when content hashing is off
+			uint64_t contentHash = 0;
+		};
+
+		std::string canonicalKey(const std::string& filepath) const;
+		// fnv-1a over the whole file, 0 if it can't be read
+		static uint64_t hashFile(const std::string& filepath);
+		template <typename T>
+		std::shared_ptr<T> findByContent(const std::unordered_map<std::string, Entry<T>>& entries, uint64_t contentHash) const;
+		template <typename T, typename Create>
+		std::shared_ptr<T> getGenerated(std::unordered_map<std::string, Entry<T>>& entries, const std::string& key, Create create);
+		template <typename T>
+		uint32_t evictUnused(std::unordered_map<std::string, Entry<T>>& entries);
+
+		VaDevice& vaDevice;
+		VaTextureStreamer* textureStreamer;
+		bool hashContents;
+
+		std::unordered_map<std::string, Entry<VaImage>> images;
+		std::unordered_map<std::string, Entry<VaModel>> models;
+
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t contentHits = 0;
+		uint64_t evicted = 0;
+	};
+}
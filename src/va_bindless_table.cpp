@@ -0,0 +1,122 @@
+#include "va_bindless_table.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace va {
+	VaBindlessTable::VaBindlessTable(VaDevice& device) : vaDevice{ device } {
+		if (!isSupported(device)) {
+			throw std::runtime_error("bindless textures need descriptor indexing");
+		}
+		// both bindings come out of the same per stage sampler limit
+		arrayCapacity = std::min(MAX_TEXTURE_ARRAYS, device.maxBindlessTextures() / 2);
+		capacity_ = std::min(MAX_TEXTURES, device.maxBindlessTextures() - arrayCapacity);
+
+		// partially bound so the slots nobody has filled yet are fine. Update after bind and unused while pending let
+		// slots no frame in flight reads get written while those frames are still going, slots that are in use never
+		// get written over, see refresh()
+		VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+			| VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+			| VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+		setLayout = VaDescriptorSetLayout::Builder(vaDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, capacity_)
+			.setBindingFlags(0, bindingFlags)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, arrayCapacity)
+			.setBindingFlags(1, bindingFlags)
+			.build();
+
+		pool = VaDescriptorPool::Builder(vaDevice)
+			.setPoolFlags(VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT)
+			.setMaxSets(1)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, capacity_ + arrayCapacity)
+			.build();
+
+		if (!pool->allocateDescriptor(setLayout->getDescriptorSetLayout(), descriptorSet)) {
+			throw std::runtime_error("failed to allocate bindless descriptor set");
+		}
+	}
+
+	uint32_t VaBindlessTable::add(const std::shared_ptr<VaImage>& image) {
+		auto it = slots.find(image.get());
+		if (it != slots.end()) {
+			if (!it->second.image.expired()) {
+				return it->second.element;
+			}
+			// a destroyed image's slot that refresh() hasn't got to yet, and this one got its address
+			remove(image.get());
+		}
+
+		Slot slot{ image, image->getGeneration(), image->isArray() ? 1u : 0u, allocateElement(image->isArray()) };
+		slots.emplace(image.get(), slot);
+		writeSlot(slot, *image);
+		return slot.element;
+	}
+
+	uint32_t VaBindlessTable::indexOf(const VaImage* image) const {
+		auto it = slots.find(image);
+		return it != slots.end() && !it->second.image.expired() ? it->second.element : DEFAULT_SLOT;
+	}
+
+	void VaBindlessTable::remove(const VaImage* image) {
+		auto it = slots.find(image);
+		if (it == slots.end()) {
+			return;
+		}
+		retireElement(it->second);
+		slots.erase(it);
+	}
+
+	void VaBindlessTable::refresh() {
+		for (auto it = slots.begin(); it != slots.end();) {
+			Slot& slot = it->second;
+			std::shared_ptr<VaImage> image = slot.image.lock();
+			if (image == nullptr) {
+				retireElement(slot);
+				it = slots.erase(it);
+				continue;
+			}
+			if (slot.generation != image->getGeneration()) {
+				retireElement(slot);
+				slot.element = allocateElement(slot.binding == 1);
+				slot.generation = image->getGeneration();
+				writeSlot(slot, *image);
+			}
+			++it;
+		}
+	}
+
+	void VaBindlessTable::retireElement(const Slot& slot) {
+		// the old slot still points at the old image, which the deletion queue keeps alive just as long
+		auto freeList = slot.binding == 1 ? freeArrays : freeTextures;
+		vaDevice.deletionQueue().push([freeList, element = slot.element]() {
+			freeList->push_back(element);
+		});
+	}
+
+	uint32_t VaBindlessTable::allocateElement(bool arrayBinding) {
+		auto& freeList = arrayBinding ? *freeArrays : *freeTextures;
+		if (!freeList.empty()) {
+			uint32_t element = freeList.back();
+			freeList.pop_back();
+			return element;
+		}
+
+		if (arrayBinding) {
+			if (arrayCount >= arrayCapacity) {
+				throw std::runtime_error("bindless texture array table is full");
+			}
+			return arrayCount++;
+		}
+		if (textureCount >= capacity_) {
+			throw std::runtime_error("bindless texture table is full");
+		}
+		return textureCount++;
+	}
+
+	void VaBindlessTable::writeSlot(const Slot& slot, const VaImage& image) {
+		auto imageInfo = image.getInfo();
+		VaDescriptorWriter(*setLayout, *pool)
+			.writeImage(slot.binding, &imageInfo, slot.element)
+			.overwrite(descriptorSet);
+	}
+}
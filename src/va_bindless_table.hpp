@@ -0,0 +1,78 @@
+#pragma once
+
+#include "va_device.hpp"
+#include "va_descriptors.hpp"
+#include "va_image.hpp"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace va {
+	// One big partially bound array of textures (set 1, binding 0) that every object draws out of. Textures get a
+	// slot once when they're added, and draws pick theirs with an index in the push constants, so there's one
+	// descriptor bind per pipeline instead of one per object. Array images need a different sampler type in the
+	// shader, so they get their own smaller table in binding 1 and their own slot numbering.
+	//
+	// The table doesn't keep images alive. Once nothing else holds one its slot goes back to the free list, after the
+	// frames in flight that could still read it are done. Needs descriptor indexing, check isSupported first.
+	class VaBindlessTable {
+	public:
+		static constexpr uint32_t MAX_TEXTURES = 4096;
+		static constexpr uint32_t MAX_TEXTURE_ARRAYS = 64;
+		// the first texture (and first array) added doubles as the fallback for anything that isn't in the table. It
+		// has to be one that doesn't stream, refresh() would move it out of this slot
+		static constexpr uint32_t DEFAULT_SLOT = 0;
+
+		static bool isSupported(VaDevice& device) { return device.hasDescriptorIndexing(); }
+
+		explicit VaBindlessTable(VaDevice& device);
+
+		VaBindlessTable(const VaBindlessTable&) = delete;
+		VaBindlessTable& operator=(const VaBindlessTable&) = delete;
+
+		// gives back the slot within the image's binding, adding the same image twice just returns the slot it already has
+		uint32_t add(const std::shared_ptr<VaImage>& image);
+		uint32_t indexOf(const VaImage* image) const;
+		// frees the image's slot, draws looking it up get DEFAULT_SLOT from then on
+		void remove(const VaImage* image);
+
+		// moves any image that has been swapped out since it was written (texture streaming) to a fresh slot, and
+		// frees the slots of images that have been destroyed. Frames in flight can still be reading the old slots, so
+		// they're only handed out again once those have finished
+		void refresh();
+
+		VkDescriptorSetLayout getDescriptorSetLayout() const { return setLayout->getDescriptorSetLayout(); }
+		const VaDescriptorSetLayout& getSetLayout() const { return *setLayout; }
+		VkDescriptorSet getDescriptorSet() const { return descriptorSet; }
+		uint32_t size() const { return static_cast<uint32_t>(slots.size()); }
+		uint32_t capacity() const { return capacity_; }
+
+	private:
+		struct Slot {
+			std::weak_ptr<VaImage> image;
+			uint32_t generation;
+			uint32_t binding;
+			uint32_t element;
+		};
+
+		// a slot nothing has used yet, or one retired long enough ago that nothing in flight can be using it
+		uint32_t allocateElement(bool arrayBinding);
+		void writeSlot(const Slot& slot, const VaImage& image);
+		// the element goes back on its free list once no frame in flight can be reading it
+		void retireElement(const Slot& slot);
+
+		VaDevice& vaDevice;
+		uint32_t capacity_;
+		uint32_t arrayCapacity;
+		uint32_t textureCount = 0;
+		uint32_t arrayCount = 0;
+		// retired slots per binding, shared with the deletion queue entries that put them back
+		std::shared_ptr<std::vector<uint32_t>> freeTextures = std::make_shared<std::vector<uint32_t>>();
+		std::shared_ptr<std::vector<uint32_t>> freeArrays = std::make_shared<std::vector<uint32_t>>();
+		std::unique_ptr<VaDescriptorSetLayout> setLayout;
+		std::unique_ptr<VaDescriptorPool> pool;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		std::unordered_map<const VaImage*, Slot> slots;
+	};
+}
@@ -26,13 +26,19 @@ namespace va {
         memoryPropertyFlags{ memoryPropertyFlags } {
         alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
         bufferSize = alignmentSize * instanceCount;
-        device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+        VaPooledBuffer pooled = device.bufferPool().acquire(bufferSize, usageFlags, memoryPropertyFlags);
+        buffer = pooled.buffer;
+        memory = pooled.memory;
+        allocationSize = pooled.size;
     }
 
     VaBuffer::~VaBuffer() {
         unmap();
-        vkDestroyBuffer(lveDevice.device(), buffer, nullptr);
-        vkFreeMemory(lveDevice.device(), memory, nullptr);
+        // back into the pool once the gpu is done with it rather than destroyed
+        VaPooledBuffer pooled{ buffer, memory, allocationSize };
+        lveDevice.deletionQueue().push([device = &lveDevice, pooled, usage = usageFlags, properties = memoryPropertyFlags]() {
+            device->bufferPool().release(pooled, usage, properties);
+        });
     }
 
     VkResult VaBuffer::map(VkDeviceSize size, VkDeviceSize offset) {
@@ -41,15 +41,18 @@ namespace va {
         VkDeviceSize getBufferSize() const { return bufferSize; }
         VkDeviceMemory getMemory() const { return memory; }
 
-    private:
         static VkDeviceSize getAlignment(VkDeviceSize instanceSize, VkDeviceSize minOffsetAlignment);
 
+    private:
+
         VaDevice& lveDevice;
         void* mapped = nullptr;
         VkBuffer buffer = VK_NULL_HANDLE;
         VkDeviceMemory memory = VK_NULL_HANDLE;
 
         VkDeviceSize bufferSize;
+        // the pooled VkBuffer can be bigger than bufferSize, this is its real size
+        VkDeviceSize allocationSize;
         uint32_t instanceCount;
         VkDeviceSize instanceSize;
         VkDeviceSize alignmentSize;
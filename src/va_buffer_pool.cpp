@@ -0,0 +1,178 @@
+#include "va_buffer_pool.hpp"
+#include "va_device.hpp"
+
+#include <cstdio>
+
+namespace va {
+	VaBufferPool::VaBufferPool(VaDevice& device) : vaDevice{ device } {}
+
+	VaBufferPool::~VaBufferPool() {
+		clear();
+	}
+
+	VkDeviceSize VaBufferPool::sizeClass(VkDeviceSize size) {
+		VkDeviceSize sizeClass = MIN_SIZE_CLASS;
+		while (sizeClass < size) {
+			sizeClass <<= 1;
+		}
+		return sizeClass;
+	}
+
+	bool VaBufferPool::isPoolable(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) {
+		if (size > MAX_POOLED_SIZE) {
+			return false;
+		}
+		bool staticGeometry = (properties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) &&
+			(usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT));
+		return !staticGeometry;
+	}
+
+	VaPooledBuffer VaBufferPool::acquire(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) {
+		if (!isPoolable(size, usage, properties)) {
+			{
+				std::lock_guard<std::mutex> lock{ mutex };
+				stats.unpooled++;
+			}
+			VaPooledBuffer pooled{};
+			pooled.size = size;
+			vaDevice.createBuffer(pooled.size, usage, properties, pooled.buffer, pooled.memory);
+			return pooled;
+		}
+
+		Key key{ usage, properties, sizeClass(size) };
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			auto it = freeBuffers.find(key);
+			if (it != freeBuffers.end() && !it->second.buffers.empty()) {
+				VaPooledBuffer pooled = it->second.buffers.back();
+				it->second.buffers.pop_back();
+				it->second.lastUsedFrame = frameNumber;
+				stats.hits++;
+				stats.pooledBuffers--;
+				stats.pooledBytes -= pooled.size;
+				return pooled;
+			}
+			stats.misses++;
+		}
+
+		VaPooledBuffer pooled{};
+		pooled.size = key.size;
+		vaDevice.createBuffer(pooled.size, usage, properties, pooled.buffer, pooled.memory);
+		return pooled;
+	}
+
+	void VaBufferPool::release(const VaPooledBuffer& pooled, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) {
+		if (!isPoolable(pooled.size, usage, properties)) {
+			destroy(pooled);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			if (stats.pooledBytes + pooled.size <= MAX_POOLED_BYTES) {
+				FreeList& list = freeBuffers[Key{ usage, properties, pooled.size }];
+				if (list.buffers.empty()) {
+					// idle time counts from when the list last had something to hand out
+					list.lastUsedFrame = frameNumber;
+				}
+				list.buffers.push_back(pooled);
+				stats.recycled++;
+				stats.pooledBuffers++;
+				stats.pooledBytes += pooled.size;
+				return;
+			}
+			stats.discarded++;
+		}
+		destroy(pooled);
+	}
+
+	void VaBufferPool::clear() {
+		std::unordered_map<Key, FreeList, KeyHash> buffers;
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			buffers.swap(freeBuffers);
+			stats.pooledBuffers = 0;
+			stats.pooledBytes = 0;
+		}
+
+		for (auto& [key, list] : buffers) {
+			for (auto& pooled : list.buffers) {
+				destroy(pooled);
+			}
+		}
+	}
+
+	void VaBufferPool::trim() {
+		uint64_t currentFrame;
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			currentFrame = ++frameNumber;
+		}
+		if (currentFrame % TRIM_INTERVAL != 0) {
+			return;
+		}
+
+		bool pressure = budgetUnderPressure();
+		std::vector<VaPooledBuffer> expired;
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			for (auto it = freeBuffers.begin(); it != freeBuffers.end();) {
+				FreeList& list = it->second;
+				if (pressure || currentFrame - list.lastUsedFrame >= IDLE_FRAMES) {
+					for (auto& pooled : list.buffers) {
+						stats.pooledBuffers--;
+						stats.pooledBytes -= pooled.size;
+						stats.trimmed++;
+						expired.push_back(pooled);
+					}
+					it = freeBuffers.erase(it);
+				}
+				else {
+					++it;
+				}
+			}
+		}
+
+		for (auto& pooled : expired) {
+			destroy(pooled);
+		}
+	}
+
+	bool VaBufferPool::budgetUnderPressure() {
+		VaMemoryStats memory = vaDevice.memoryTracker().getStats();
+		for (const auto& heap : memory.heaps) {
+			// without the budget extension all we have is our own allocations against the heap size
+			VkDeviceSize used = memory.hasBudget ? heap.usage : heap.allocated.bytes;
+			VkDeviceSize limit = memory.hasBudget ? heap.budget : heap.size;
+			if (limit > 0 && used > limit / 10 * 9) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	VaBufferPool::Stats VaBufferPool::getStats() {
+		std::lock_guard<std::mutex> lock{ mutex };
+		return stats;
+	}
+
+	std::string VaBufferPool::summary() {
+		Stats current = getStats();
+		char buffer[256];
+		snprintf(buffer, sizeof(buffer), "buffer pool: %.1f%% hit rate (%llu hits, %llu misses) | %u pooled, %.1f MiB | %llu unpooled, %llu trimmed",
+			current.hitRate() * 100.0,
+			static_cast<unsigned long long>(current.hits),
+			static_cast<unsigned long long>(current.misses),
+			current.pooledBuffers,
+			static_cast<double>(current.pooledBytes) / (1024.0 * 1024.0),
+			static_cast<unsigned long long>(current.unpooled),
+			static_cast<unsigned long long>(current.trimmed));
+		return buffer;
+	}
+
+	void VaBufferPool::destroy(const VaPooledBuffer& pooled) {
+		vaDevice.forgetDescriptorHandle(handleBits(pooled.buffer));
+		vkDestroyBuffer(vaDevice.device(), pooled.buffer, nullptr);
+		vaDevice.freeMemory(pooled.memory);
+	}
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "va_hash.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace va {
+	class VaDevice;
+
+	struct VaPooledBuffer {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		// size of the actual VkBuffer, rounded up to the size class when pooled, so always >= what was asked for
+		VkDeviceSize size = 0;
+	};
+
+	// Recycles small VkBuffer + memory pairs instead of destroying them, keyed by usage, memory flags and a rounded up
+	// size class. Big buffers and static geometry skip the pool and get exactly what they asked for.
+	// Buffers should only come back through the deletion queue, once the gpu is done with them.
+	class VaBufferPool {
+	public:
+		struct Stats {
+			uint64_t hits = 0;
+			uint64_t misses = 0;
+			uint64_t recycled = 0;
+			// released while the pool was already full, so destroyed for real
+			uint64_t discarded = 0;
+			// too big or static geometry, allocated at exact size and destroyed on release
+			uint64_t unpooled = 0;
+			// freed by trim() for sitting idle or because the heap was running out of budget
+			uint64_t trimmed = 0;
+			uint32_t pooledBuffers = 0;
+			VkDeviceSize pooledBytes = 0;
+
+			double hitRate() const {
+				uint64_t requests = hits + misses;
+				return requests > 0 ? static_cast<double>(hits) / static_cast<double>(requests) : 0.0;
+			}
+		};
+
+		// anything past this is destroyed on release rather than kept around
+		static constexpr VkDeviceSize MAX_POOLED_BYTES = 256ull * 1024 * 1024;
+		// requests bigger than this aren't rounded or pooled, rounding them up would waste too much memory
+		static constexpr VkDeviceSize MAX_POOLED_SIZE = 4 * 1024 * 1024;
+		// free lists nobody took from in this many frames are given back to the driver
+		static constexpr uint64_t IDLE_FRAMES = 600;
+
+		explicit VaBufferPool(VaDevice& device);
+		~VaBufferPool();
+
+		VaBufferPool(const VaBufferPool&) = delete;
+		VaBufferPool& operator=(const VaBufferPool&) = delete;
+
+		VaPooledBuffer acquire(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+		void release(const VaPooledBuffer& pooled, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+		// destroys everything sitting in the pool, only safe once nothing pooled can still be in flight
+		void clear();
+		// once per frame, frees idle free lists and empties the pool when a heap is close to its budget
+		void trim();
+
+		Stats getStats();
+		std::string summary();
+
+		// powers of two, only meaningful for sizes up to MAX_POOLED_SIZE
+		static VkDeviceSize sizeClass(VkDeviceSize size);
+		// device local vertex/index buffers live for as long as the mesh does, so there's nothing to recycle
+		static bool isPoolable(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+
+	private:
+		static constexpr VkDeviceSize MIN_SIZE_CLASS = 256;
+		// checking the budget isn't free, so the pool is only trimmed every so often
+		static constexpr uint64_t TRIM_INTERVAL = 60;
+
+		struct Key {
+			VkBufferUsageFlags usage;
+			VkMemoryPropertyFlags properties;
+			VkDeviceSize size;
+
+			bool operator==(const Key& other) const {
+				return usage == other.usage && properties == other.properties && size == other.size;
+			}
+		};
+
+		struct KeyHash {
+			size_t operator()(const Key& key) const {
+				size_t seed = std::hash<uint64_t>{}(key.size);
+				hashCombine(seed, key.usage);
+				hashCombine(seed, key.properties);
+				return seed;
+			}
+		};
+
+		struct FreeList {
+			std::vector<VaPooledBuffer> buffers;
+			uint64_t lastUsedFrame = 0;
+		};
+
+		void destroy(const VaPooledBuffer& pooled);
+		bool budgetUnderPressure();
+
+		VaDevice& vaDevice;
+		std::mutex mutex;
+		std::unordered_map<Key, FreeList, KeyHash> freeBuffers;
+		Stats stats{};
+		uint64_t frameNumber = 0;
+	};
+}
@@ -1,10 +1,17 @@
 #include "va_cubemap.hpp"
 
 #include "va_buffer.hpp"
+#include "va_hash.hpp"
 
 #include <string>
+#include <algorithm>
 #include <array>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <iostream>
 #include <stdexcept>
+#include <vector>
 
 #ifndef FILE_DIR
 #define FILE_DIR "../../../"
@@ -13,25 +20,58 @@
 namespace va {
 	VaCubemap::VaCubemap(VaDevice& device)
 		: vaDevice{ device } {
-		createCubemap();
+		createCubemap(loadFaces());
 		createImageView();
 		createSampler();
 		updateDescriptor();
 	}
 
 	VaCubemap::~VaCubemap() {
-		vkDestroySampler(vaDevice.device(), cubemapSampler, nullptr);
-		vkDestroyImageView(vaDevice.device(), cubemapImageView, nullptr);
-		vkDestroyImage(vaDevice.device(), cubemapImage, nullptr);
-		vkFreeMemory(vaDevice.device(), cubemapImageMemory, nullptr);
+		vaDevice.deletionQueue().push([
+			device = &vaDevice,
+			view = cubemapImageView,
+			image = cubemapImage,
+			memory = cubemapImageMemory
+		]() {
+			device->forgetDescriptorHandle(handleBits(view));
+			vkDestroyImageView(device->device(), view, nullptr);
+			vkDestroyImage(device->device(), image, nullptr);
+			device->freeMemory(memory);
+		});
 	}
 
-	void VaCubemap::createCubemap() {
-		int texWidth{}, texHeight{}, texChannels{};
+	VaKtxTexture VaCubemap::loadFaces() {
+		std::string ktxPath = FILE_DIR "textures/skybox/skycube.ktx2";
+		if (std::filesystem::exists(ktxPath)) {
+			try {
+				VaKtxTexture ktx = VaKtxTexture::loadFromFile(ktxPath);
+				// the decoded faces are flipped, throws for block compressed faces that aren't
+				if (ktx.isTopDown()) {
+					ktx.flipVertically();
+				}
+				if (isKtxUsable(ktx)) {
+					return ktx;
+				}
+				std::cerr << "can't use " << ktxPath << " on this device, decoding the skybox faces instead\n";
+			}
+			catch (const std::exception& e) {
+				std::cerr << "ignoring " << ktxPath << ": " << e.what() << '\n';
+			}
+		}
+		return decodeFaces();
+	}
 
-		stbi_set_flip_vertically_on_load(true);
-		stbi_uc* skyboxPixels[6];
+	bool VaCubemap::isKtxUsable(const VaKtxTexture& ktx) {
+		if (ktx.faceCount != 6 || ktx.layerCount != 1 || ktx.width != ktx.height) {
+			return false;
+		}
+		if (VaKtxTexture::isBlockCompressed(ktx.format) && !vaDevice.hasTextureCompressionBC()) {
+			return false;
+		}
+		return vaDevice.isFormatSupported(ktx.format, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+	}
 
+	VaKtxTexture VaCubemap::decodeFaces() {
 		std::array<std::string, 6> skyboxPaths = {
 			"textures/skybox/skycube-right.png",
 			"textures/skybox/skycube-left.png",
@@ -41,57 +81,112 @@ namespace va {
 			"textures/skybox/skycube-back.png",
 		};
 
+		// size comes from the header so the buffer is there before any face gets decoded
+		int texWidth{}, texHeight{}, texChannels{};
+		if (!stbi_info((FILE_DIR + skyboxPaths[0]).c_str(), &texWidth, &texHeight, &texChannels)) {
+			throw std::runtime_error("failed to load texture image");
+		}
+
+		size_t layerSize = static_cast<size_t>(texWidth) * texHeight * 4;
+		VaKtxTexture faces{};
+		faces.format = VK_FORMAT_R8G8B8A8_SRGB;
+		faces.width = static_cast<uint32_t>(texWidth);
+		faces.height = static_cast<uint32_t>(texHeight);
+		faces.faceCount = 6;
+		faces.levelCount = 1;
+		faces.levels.push_back({ 0, layerSize * 6 });
+		faces.data.resize(layerSize * 6);
+		uint8_t* data = faces.data.data();
+
+		// each face decodes on its own worker and copies itself into its slot
+		std::vector<std::future<void>> decodes;
 		for (int i = 0; i < 6; i++) {
-			skyboxPixels[i] = loadImage(FILE_DIR + skyboxPaths[i], &texWidth, &texHeight, &texChannels);
-			if (!skyboxPixels[i]) {
-				throw std::runtime_error("failed to load texture image");
-			}
+			decodes.push_back(vaDevice.threadPool().submit([this, &skyboxPaths, data, layerSize, texWidth, texHeight, i]() {
+				int width, height, channels;
+				stbi_uc* pixels = loadImage(FILE_DIR + skyboxPaths[i], true, &width, &height, &channels);
+				if (!pixels) {
+					throw std::runtime_error("failed to load texture image");
+				}
+				if (width != texWidth || height != texHeight) {
+					stbi_image_free(pixels);
+					throw std::runtime_error("skybox faces need to all be the same size");
+				}
+				memcpy(data + i * layerSize, pixels, layerSize);
+				stbi_image_free(pixels);
+			}));
 		}
+		// everything has to finish before an exception can unwind the data out from under the others
+		for (auto& decode : decodes) {
+			decode.wait();
+		}
+		for (auto& decode : decodes) {
+			decode.get();
+		}
+
+		return faces;
+	}
+
+	void VaCubemap::createCubemap(const VaKtxTexture& faces) {
+		format = faces.format;
+		mipLevels = faces.levelCount;
 
-		VkDeviceSize imageSize = texWidth * texHeight * 4 * 6;
-		VkDeviceSize layerSize = imageSize / 6;
+		// only the level data goes up, shifting it all by the lowest offset keeps the ktx alignment for the copy
+		size_t begin = faces.levels[0].offset;
+		size_t end = 0;
+		for (const auto& level : faces.levels) {
+			begin = std::min(begin, level.offset);
+			end = std::max(end, level.offset + level.size);
+		}
 
 		VaBuffer stagingBuffer{
 			vaDevice,
-			imageSize,
+			end - begin,
 			1,
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
 		};
-
 		stagingBuffer.map();
-		for (int i = 0; i < 6; i++) {
-			stagingBuffer.writeToBuffer((void*)skyboxPixels[i], layerSize, i * layerSize);
-			stbi_image_free(skyboxPixels[i]);
+		stagingBuffer.writeToBuffer(const_cast<uint8_t*>(faces.data.data() + begin), end - begin);
+
+		// each level holds its six faces back to back
+		std::vector<VkBufferImageCopy> regions;
+		for (uint32_t level = 0; level < faces.levelCount; level++) {
+			for (uint32_t face = 0; face < 6; face++) {
+				VkBufferImageCopy region{};
+				region.bufferOffset = faces.levels[level].offset - begin + face * faces.faceSize(level);
+				region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				region.imageSubresource.mipLevel = level;
+				region.imageSubresource.baseArrayLayer = face;
+				region.imageSubresource.layerCount = 1;
+				region.imageOffset = { 0, 0, 0 };
+				region.imageExtent = { std::max(faces.width >> level, 1u), std::max(faces.height >> level, 1u), 1 };
+				regions.push_back(region);
+			}
 		}
 
-		createImage(texWidth, texHeight);
+		createImage(faces.width, faces.height);
 
 		vaDevice.transitionImageLayout(
 			cubemapImage,
-			VK_FORMAT_R8G8B8A8_SRGB,
+			format,
 			VK_IMAGE_LAYOUT_UNDEFINED,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			6,
-			1
-		);
-		vaDevice.copyBufferToImage(
-			stagingBuffer.getBuffer(),
-			cubemapImage,
-			static_cast<uint32_t>(texWidth),
-			static_cast<uint32_t>(texHeight), 6
+			mipLevels
 		);
+		vaDevice.copyBufferToImage(stagingBuffer.getBuffer(), cubemapImage, regions);
 		vaDevice.transitionImageLayout(
 			cubemapImage,
-			VK_FORMAT_R8G8B8A8_SRGB,
+			format,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 			6,
-			1
+			mipLevels
 		);
 	}
 
-	stbi_uc* VaCubemap::loadImage(const std::string& filepath, int* width, int* height, int* channels) {
+	stbi_uc* VaCubemap::loadImage(const std::string& filepath, bool flip, int* width, int* height, int* channels) {
+		stbi_set_flip_vertically_on_load_thread(flip);
 		return stbi_load(filepath.c_str(), width, height, channels, STBI_rgb_alpha);
 	}
 
@@ -102,9 +197,9 @@ namespace va {
 		imageInfo.extent.width = width;
 		imageInfo.extent.height = height;
 		imageInfo.extent.depth = 1;
-		imageInfo.mipLevels = 1;
+		imageInfo.mipLevels = mipLevels;
 		imageInfo.arrayLayers = 6;
-		imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+		imageInfo.format = format;
 		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
@@ -120,10 +215,10 @@ namespace va {
 		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 		viewInfo.image = cubemapImage;
 		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
-		viewInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+		viewInfo.format = format;
 		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		viewInfo.subresourceRange.baseMipLevel = 0;
-		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.levelCount = mipLevels;
 		viewInfo.subresourceRange.baseArrayLayer = 0;
 		viewInfo.subresourceRange.layerCount = 6;
 
@@ -133,27 +228,7 @@ namespace va {
 	}
 
 	void VaCubemap::createSampler() {
-		VkSamplerCreateInfo samplerInfo{};
-		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-		samplerInfo.magFilter = VK_FILTER_LINEAR;
-		samplerInfo.minFilter = VK_FILTER_LINEAR;
-		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		samplerInfo.anisotropyEnable = VK_TRUE;
-		samplerInfo.maxAnisotropy = vaDevice.properties.limits.maxSamplerAnisotropy;
-		samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-		samplerInfo.unnormalizedCoordinates = VK_FALSE;
-		samplerInfo.compareEnable = VK_FALSE;
-		samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		samplerInfo.mipLodBias = 0.0f;
-		samplerInfo.minLod = 0.0f;
-		samplerInfo.maxLod = 0.0f;
-
-		if (vkCreateSampler(vaDevice.device(), &samplerInfo, nullptr, &cubemapSampler) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create texture sampler");
-		}
+		cubemapSampler = vaDevice.samplerCache().getSampler(VaSamplerPreset::Cubemap);
 	}
 
 	void VaCubemap::updateDescriptor() {
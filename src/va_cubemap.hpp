@@ -2,10 +2,13 @@
 
 #include "va_device.hpp"
 #include "va_descriptors.hpp"
+#include "va_ktx.hpp"
 
 #include <stb_image.h>
 
 namespace va {
+	// The skybox. Loads textures/skybox/skycube.ktx2 when there is one the device can use (ktx_converter --cubemap
+	// builds it, compressed and with the full mip chain), otherwise decodes the six skycube-*.png faces with no mips
 	class VaCubemap {
 	public:
 		VaCubemap(VaDevice& device);
@@ -19,14 +22,21 @@ namespace va {
 	private:
 		VaDevice& vaDevice;
 
+		VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+		uint32_t mipLevels = 1;
 		VkImage cubemapImage;
 		VkDeviceMemory cubemapImageMemory;
 		VkImageView cubemapImageView = nullptr;
+		// owned by the device's sampler cache
 		VkSampler cubemapSampler = nullptr;
 		VkDescriptorImageInfo cubemapDescriptorInfo;
 
-		void createCubemap();
-		stbi_uc* loadImage(const std::string& filepath, int* width, int* height, int* channels);
+		VaKtxTexture loadFaces();
+		bool isKtxUsable(const VaKtxTexture& ktx);
+		VaKtxTexture decodeFaces();
+		void createCubemap(const VaKtxTexture& faces);
+		// stb's flip flag is per thread once anything set it per thread, so every decode says what it wants
+		stbi_uc* loadImage(const std::string& filepath, bool flip, int* width, int* height, int* channels);
 		void createImage(uint32_t width, uint32_t height);
 		void createImageView();
 		void createSampler();
@@ -0,0 +1,62 @@
+#include "va_deletion_queue.hpp"
+
+#include <vector>
+
+namespace va {
+	VaDeletionQueue::~VaDeletionQueue() {
+		flush();
+	}
+
+	void VaDeletionQueue::push(std::function<void()>&& deleter, uint32_t extraFrames) {
+		std::unique_lock<std::mutex> lock{ mutex };
+		// nothing has gone through the renderer yet, and the single time commands used while loading
+		// wait on the queue, so there's nothing the handle could still be in use by
+		if (frameNumber == 0) {
+			lock.unlock();
+			deleter();
+			return;
+		}
+		entries.push_back({ frameNumber + extraFrames, std::move(deleter) });
+	}
+
+	void VaDeletionQueue::beginFrame(uint32_t framesInFlight) {
+		std::vector<std::function<void()>> ready;
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			// an entry tagged with frame n could be used by anything up to frame n - 1, which is known to be
+			// done once we're starting frame n - 1 + framesInFlight
+			// delayed entries can sit behind ones that are already due, so everything gets looked at
+			for (auto it = entries.begin(); it != entries.end();) {
+				if (it->frame + framesInFlight <= frameNumber + 1) {
+					ready.push_back(std::move(it->deleter));
+					it = entries.erase(it);
+				}
+				else {
+					++it;
+				}
+			}
+			frameNumber++;
+		}
+
+		for (auto& deleter : ready) {
+			deleter();
+		}
+	}
+
+	void VaDeletionQueue::flush() {
+		std::deque<Entry> pending;
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			pending.swap(entries);
+		}
+
+		for (auto& entry : pending) {
+			entry.deleter();
+		}
+	}
+
+	size_t VaDeletionQueue::pendingCount() {
+		std::lock_guard<std::mutex> lock{ mutex };
+		return entries.size();
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+namespace va {
+	// Holds on to destroy calls until every frame that could still be referencing the handles has finished
+	// on the gpu, so things can be released mid-run without a vkDeviceWaitIdle.
+	class VaDeletionQueue {
+	public:
+		VaDeletionQueue() = default;
+		~VaDeletionQueue();
+
+		VaDeletionQueue(const VaDeletionQueue&) = delete;
+		VaDeletionQueue& operator=(const VaDeletionQueue&) = delete;
+
+		// extraFrames holds on for that many more frames than usual, for things the frame fences don't cover
+		void push(std::function<void()>&& deleter, uint32_t extraFrames = 0);
+
+		// called once the fence for the frame about to be recorded has been waited on
+		void beginFrame(uint32_t framesInFlight);
+		// only safe once the device is idle
+		void flush();
+
+		size_t pendingCount();
+
+	private:
+		struct Entry {
+			// the first frame that can't be referencing it anymore, minus the frames in flight
+			uint64_t frame;
+			std::function<void()> deleter;
+		};
+
+		std::mutex mutex;
+		std::deque<Entry> entries;
+		uint64_t frameNumber = 0;
+	};
+}
@@ -0,0 +1,132 @@
+#include "va_descriptor_set_cache.hpp"
+#include "va_hash.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace va {
+	bool VaDescriptorSetCache::Resource::operator==(const Resource& other) const {
+		return binding == other.binding &&
+			arrayElement == other.arrayElement &&
+			type == other.type &&
+			handle == other.handle &&
+			sampler == other.sampler &&
+			offset == other.offset &&
+			range == other.range &&
+			imageLayout == other.imageLayout;
+	}
+
+	bool VaDescriptorSetCache::Key::operator==(const Key& other) const {
+		return layout == other.layout && resources == other.resources;
+	}
+
+	size_t VaDescriptorSetCache::KeyHash::operator()(const Key& key) const {
+		size_t seed = 0;
+		hashCombine(seed, handleBits(key.layout));
+		for (const auto& resource : key.resources) {
+			hashCombine(seed, (static_cast<uint64_t>(resource.binding) << 32) | resource.arrayElement);
+			hashCombine(seed, static_cast<uint64_t>(resource.type));
+			hashCombine(seed, resource.handle);
+			hashCombine(seed, resource.sampler);
+			hashCombine(seed, resource.offset);
+			hashCombine(seed, resource.range);
+			hashCombine(seed, static_cast<uint64_t>(resource.imageLayout));
+		}
+		return seed;
+	}
+
+	VaDescriptorSetCache::VaDescriptorSetCache(VaDevice& device, VkDescriptorPoolCreateFlags poolFlags)
+		: vaDevice{ device }, poolFlags{ poolFlags }, allocator{ device, poolFlags } {
+		vaDevice.addDescriptorSetCache(this);
+	}
+
+	VaDescriptorSetCache::~VaDescriptorSetCache() {
+		vaDevice.removeDescriptorSetCache(this);
+	}
+
+	VaDescriptorSetCache::Key VaDescriptorSetCache::makeKey(const VaDescriptorWriter& writer) {
+		Key key{};
+		key.layout = writer.setLayout.getDescriptorSetLayout();
+		key.resources.reserve(writer.writes.size());
+		for (const auto& write : writer.writes) {
+			Resource resource{};
+			resource.binding = write.dstBinding;
+			resource.arrayElement = write.dstArrayElement;
+			resource.type = write.descriptorType;
+			if (write.pBufferInfo != nullptr) {
+				resource.handle = handleBits(write.pBufferInfo->buffer);
+				resource.offset = write.pBufferInfo->offset;
+				resource.range = write.pBufferInfo->range;
+			}
+			if (write.pImageInfo != nullptr) {
+				resource.handle = handleBits(write.pImageInfo->imageView);
+				resource.sampler = handleBits(write.pImageInfo->sampler);
+				resource.imageLayout = write.pImageInfo->imageLayout;
+			}
+			key.resources.push_back(resource);
+		}
+
+		std::sort(key.resources.begin(), key.resources.end(), [](const Resource& a, const Resource& b) {
+			return a.binding != b.binding ? a.binding < b.binding : a.arrayElement < b.arrayElement;
+		});
+		return key;
+	}
+
+	void VaDescriptorSetCache::build(VaDescriptorWriter& writer, VkDescriptorSet& set) {
+		Key key = makeKey(writer);
+		auto cached = sets.find(key);
+		if (cached != sets.end()) {
+			set = cached->second;
+			hits++;
+			return;
+		}
+
+		allocator.allocate(writer.setLayout, set);
+		writer.overwrite(set);
+		sets.emplace(std::move(key), set);
+		misses++;
+	}
+
+	void VaDescriptorSetCache::reset() {
+		allocator.resetPools();
+		sets.clear();
+	}
+
+	void VaDescriptorSetCache::forget(uint64_t handle) {
+		std::vector<VkDescriptorSet> stale;
+		for (auto it = sets.begin(); it != sets.end();) {
+			bool uses = std::any_of(it->first.resources.begin(), it->first.resources.end(), [handle](const Resource& resource) {
+				return resource.handle == handle || resource.sampler == handle;
+			});
+			if (uses) {
+				stale.push_back(it->second);
+				it = sets.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+
+		if (!stale.empty() && (poolFlags & VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT)) {
+			allocator.free(stale);
+		}
+	}
+
+	VaDescriptorSetCache::Stats VaDescriptorSetCache::getStats() const {
+		Stats stats{};
+		stats.sets = static_cast<uint32_t>(sets.size());
+		stats.hits = hits;
+		stats.misses = misses;
+		return stats;
+	}
+
+	std::string VaDescriptorSetCache::summary() const {
+		Stats current = getStats();
+		char buffer[160];
+		snprintf(buffer, sizeof(buffer), "descriptor set cache: %u sets | %llu hits, %llu misses",
+			current.sets,
+			static_cast<unsigned long long>(current.hits),
+			static_cast<unsigned long long>(current.misses));
+		return buffer;
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "va_device.hpp"
+#include "va_descriptors.hpp"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace va {
+	// Gives back the same VkDescriptorSet for the same layout with the same resources written into it, so two objects
+	// using the same texture share one set and nothing gets written twice. Cached sets belong to the cache, they can't
+	// be freed one by one, only all together with reset() or by destroying the cache.
+	//
+	// For sets that only live for a frame, keep a cache per frame in flight and reset() it once its fence is waited on.
+	//
+	// Every cache registers itself with the device, which tells it when an image view or buffer is destroyed. Sets
+	// written with that handle are dropped then, so a new object that gets the same handle back from the driver
+	// doesn't get handed a set that was written for the old one.
+	class VaDescriptorSetCache {
+	public:
+		struct Stats {
+			uint32_t sets = 0;
+			uint64_t hits = 0;
+			uint64_t misses = 0;
+		};
+
+		// VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT lets forget() give the dropped sets back to the pool,
+		// without it they just sit there until reset()
+		explicit VaDescriptorSetCache(VaDevice& device, VkDescriptorPoolCreateFlags poolFlags = 0);
+		~VaDescriptorSetCache();
+
+		VaDescriptorSetCache(const VaDescriptorSetCache&) = delete;
+		VaDescriptorSetCache& operator=(const VaDescriptorSetCache&) = delete;
+
+		// same as writer.build(set), except a set that already has exactly those writes gets handed back instead. The
+		// set comes from the cache's own allocator, so the writer only needs the layout
+		void build(VaDescriptorWriter& writer, VkDescriptorSet& set);
+
+		// drops every set at once, only once nothing using them can still be in flight
+		void reset();
+		// drops every set written with this view, buffer or sampler. Called by the device right before the handle is
+		// destroyed, which is already past the frames that could still be using those sets
+		void forget(uint64_t handle);
+
+		Stats getStats() const;
+		std::string summary() const;
+
+	private:
+		// everything a single descriptor write points at
+		struct Resource {
+			uint32_t binding;
+			uint32_t arrayElement;
+			VkDescriptorType type;
+			// buffer or image view
+			uint64_t handle;
+			uint64_t sampler;
+			VkDeviceSize offset;
+			VkDeviceSize range;
+			VkImageLayout imageLayout;
+
+			bool operator==(const Resource& other) const;
+		};
+
+		struct Key {
+			VkDescriptorSetLayout layout;
+			// sorted by binding then element, so the order things got written in doesn't matter
+			std::vector<Resource> resources;
+
+			bool operator==(const Key& other) const;
+		};
+
+		struct KeyHash {
+			size_t operator()(const Key& key) const;
+		};
+
+		static Key makeKey(const VaDescriptorWriter& writer);
+
+		VaDevice& vaDevice;
+		VkDescriptorPoolCreateFlags poolFlags;
+		VaDescriptorAllocator allocator;
+		std::unordered_map<Key, VkDescriptorSet, KeyHash> sets;
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+	};
+}
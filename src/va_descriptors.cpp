@@ -1,6 +1,9 @@
 #include "va_descriptors.hpp"
+#include "va_hash.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <stdexcept>
 
 namespace va {
@@ -22,24 +25,60 @@ namespace va {
         return *this;
     }
 
+    VaDescriptorSetLayout::Builder& VaDescriptorSetLayout::Builder::setBindingFlags(
+        uint32_t binding,
+        VkDescriptorBindingFlags flags) {
+        assert(bindings.count(binding) == 1 && "Binding flags set for a binding that doesn't exist");
+        bindingFlags[binding] = flags;
+        return *this;
+    }
+
+    VaDescriptorSetLayout::Builder& VaDescriptorSetLayout::Builder::setPushDescriptor() {
+        layoutFlags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+        return *this;
+    }
+
     std::unique_ptr<VaDescriptorSetLayout> VaDescriptorSetLayout::Builder::build() const {
-        return std::make_unique<VaDescriptorSetLayout>(vaDevice, bindings);
+        return std::make_unique<VaDescriptorSetLayout>(vaDevice, bindings, bindingFlags, layoutFlags);
     }
 
     // *************** Descriptor Set Layout *********************
 
     VaDescriptorSetLayout::VaDescriptorSetLayout(
-        VaDevice& vaDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings)
+        VaDevice& vaDevice,
+        std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+        const std::unordered_map<uint32_t, VkDescriptorBindingFlags>& bindingFlags,
+        VkDescriptorSetLayoutCreateFlags layoutFlags)
         : vaDevice{ vaDevice }, bindings{ bindings } {
+        pushDescriptor = (layoutFlags & VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR) != 0;
+        assert((!pushDescriptor || vaDevice.hasPushDescriptors()) && "Push descriptor layout without push descriptors");
+
         std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+        std::vector<VkDescriptorBindingFlags> setLayoutBindingFlags{};
+        bool updateAfterBind = false;
         for (auto kv : bindings) {
             setLayoutBindings.push_back(kv.second);
+            auto flags = bindingFlags.find(kv.first);
+            setLayoutBindingFlags.push_back(flags != bindingFlags.end() ? flags->second : 0);
+            updateAfterBind |= (setLayoutBindingFlags.back() & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT) != 0;
         }
 
+        VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+        bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        bindingFlagsInfo.bindingCount = static_cast<uint32_t>(setLayoutBindingFlags.size());
+        bindingFlagsInfo.pBindingFlags = setLayoutBindingFlags.data();
+
         VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
         descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
         descriptorSetLayoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
         descriptorSetLayoutInfo.pBindings = setLayoutBindings.data();
+        descriptorSetLayoutInfo.flags = layoutFlags;
+        if (!bindingFlags.empty()) {
+            descriptorSetLayoutInfo.pNext = &bindingFlagsInfo;
+        }
+        if (updateAfterBind) {
+            descriptorSetLayoutInfo.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        }
 
         if (vkCreateDescriptorSetLayout(
             vaDevice.device(),
@@ -48,12 +87,78 @@ namespace va {
             &descriptorSetLayout) != VK_SUCCESS) {
             throw std::runtime_error("failed to create descriptor set layout!");
         }
+
+        // lets pipelines built against an equal layout made later (after a recreate) share a pipeline with this one
+        std::vector<size_t> order(setLayoutBindings.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return setLayoutBindings[a].binding < setLayoutBindings[b].binding;
+        });
+        uint64_t compatibilityHash = static_cast<uint64_t>(descriptorSetLayoutInfo.flags);
+        for (size_t i : order) {
+            const auto& binding = setLayoutBindings[i];
+            for (uint64_t value : {
+                static_cast<uint64_t>(binding.binding),
+                static_cast<uint64_t>(binding.descriptorType),
+                static_cast<uint64_t>(binding.descriptorCount),
+                static_cast<uint64_t>(binding.stageFlags),
+                static_cast<uint64_t>(setLayoutBindingFlags[i]) }) {
+                hashCombine(compatibilityHash, value);
+            }
+        }
+        vaDevice.pipelineStates().describe((uint64_t)(descriptorSetLayout), compatibilityHash);
     }
 
     VaDescriptorSetLayout::~VaDescriptorSetLayout() {
+        for (auto& [key, updateTemplate] : updateTemplates) {
+            vkDestroyDescriptorUpdateTemplate(vaDevice.device(), updateTemplate, nullptr);
+        }
+        vaDevice.pipelineStates().forget((uint64_t)(descriptorSetLayout));
         vkDestroyDescriptorSetLayout(vaDevice.device(), descriptorSetLayout, nullptr);
     }
 
+    VkDescriptorUpdateTemplate VaDescriptorSetLayout::getUpdateTemplate(const std::vector<VkWriteDescriptorSet>& writes) {
+        std::vector<uint64_t> key;
+        key.reserve(writes.size());
+        for (const auto& write : writes) {
+            key.push_back((static_cast<uint64_t>(write.dstBinding) << 32) | write.dstArrayElement);
+        }
+
+        auto existing = updateTemplates.find(key);
+        if (existing != updateTemplates.end()) {
+            return existing->second;
+        }
+
+        std::vector<VkDescriptorUpdateTemplateEntry> entries;
+        entries.reserve(writes.size());
+        for (size_t i = 0; i < writes.size(); i++) {
+            VkDescriptorUpdateTemplateEntry entry{};
+            entry.dstBinding = writes[i].dstBinding;
+            entry.dstArrayElement = writes[i].dstArrayElement;
+            entry.descriptorCount = 1;
+            entry.descriptorType = writes[i].descriptorType;
+            entry.offset = i * sizeof(VaDescriptorData);
+            entry.stride = sizeof(VaDescriptorData);
+            entries.push_back(entry);
+        }
+
+        VkDescriptorUpdateTemplateCreateInfo templateInfo{};
+        templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+        templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+        templateInfo.pDescriptorUpdateEntries = entries.data();
+        templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+        templateInfo.descriptorSetLayout = descriptorSetLayout;
+
+        VkDescriptorUpdateTemplate updateTemplate;
+        if (vkCreateDescriptorUpdateTemplate(vaDevice.device(), &templateInfo, nullptr, &updateTemplate) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor update template!");
+        }
+        updateTemplates.emplace(std::move(key), updateTemplate);
+        return updateTemplate;
+    }
+
     // *************** Descriptor Pool Builder *********************
 
     VaDescriptorPool::Builder& VaDescriptorPool::Builder::addPoolSize(
@@ -127,10 +232,109 @@ namespace va {
         vkResetDescriptorPool(vaDevice.device(), descriptorPool, 0);
     }
 
+    // *************** Descriptor Allocator *********************
+
+    VaDescriptorAllocator::VaDescriptorAllocator(VaDevice& vaDevice, VkDescriptorPoolCreateFlags poolFlags)
+        : vaDevice{ vaDevice }, poolFlags{ poolFlags } {}
+
+    void VaDescriptorAllocator::allocate(const VaDescriptorSetLayout& setLayout, VkDescriptorSet& set) {
+        VkDescriptorSetLayout layout = setLayout.getDescriptorSetLayout();
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.pSetLayouts = &layout;
+        allocInfo.descriptorSetCount = 1;
+
+        // pools that filled up before can have room again after frees or a reset, so it's the current one and
+        // anything after it, then a new one
+        while (true) {
+            bool created = currentPool == pools.size();
+            if (created) {
+                pools.push_back(createPool(setLayout));
+            }
+
+            allocInfo.descriptorPool = pools[currentPool]->getDescriptorPool();
+            VkResult result = vkAllocateDescriptorSets(vaDevice.device(), &allocInfo, &set);
+            if (result == VK_SUCCESS) {
+                break;
+            }
+            if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) {
+                throw std::runtime_error("failed to allocate descriptor set!");
+            }
+            // a pool sized for it that still can't fit it never will
+            if (created) {
+                throw std::runtime_error("descriptor set doesn't fit in an empty pool!");
+            }
+            currentPool++;
+        }
+
+        if (poolFlags & VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT) {
+            setPools[set] = currentPool;
+        }
+        for (const auto& [binding, layoutBinding] : setLayout.bindings) {
+            descriptorsAllocated[layoutBinding.descriptorType] += layoutBinding.descriptorCount;
+        }
+        setsAllocated++;
+    }
+
+    void VaDescriptorAllocator::free(const std::vector<VkDescriptorSet>& sets) {
+        assert((poolFlags & VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT) && "Allocator pools can't free single sets");
+
+        for (VkDescriptorSet set : sets) {
+            auto owner = setPools.find(set);
+            if (owner == setPools.end()) {
+                continue;
+            }
+            vkFreeDescriptorSets(vaDevice.device(), pools[owner->second]->getDescriptorPool(), 1, &set);
+            // worth trying the freed pool again before anything after it
+            currentPool = std::min(currentPool, owner->second);
+            setPools.erase(owner);
+        }
+    }
+
+    void VaDescriptorAllocator::resetPools() {
+        for (auto& pool : pools) {
+            pool->resetPool();
+        }
+        setPools.clear();
+        currentPool = 0;
+    }
+
+    std::unique_ptr<VaDescriptorPool> VaDescriptorAllocator::createPool(const VaDescriptorSetLayout& setLayout) {
+        uint32_t maxSets = setsPerPool;
+        setsPerPool = std::min(setsPerPool * 2, MAX_SETS_PER_POOL);
+
+        // what the sets so far averaged per type, plus the set that's waiting on this pool so it always fits
+        std::unordered_map<VkDescriptorType, uint64_t> observed = descriptorsAllocated;
+        for (const auto& [binding, layoutBinding] : setLayout.bindings) {
+            observed[layoutBinding.descriptorType] += layoutBinding.descriptorCount;
+        }
+        uint64_t observedSets = setsAllocated + 1;
+
+        std::vector<VkDescriptorPoolSize> poolSizes;
+        for (const auto& [type, count] : observed) {
+            double perSet = static_cast<double>(count) / static_cast<double>(observedSets);
+            uint32_t descriptors = static_cast<uint32_t>(std::ceil(perSet * maxSets));
+            for (const auto& [binding, layoutBinding] : setLayout.bindings) {
+                if (layoutBinding.descriptorType == type) {
+                    descriptors = std::max(descriptors, layoutBinding.descriptorCount);
+                }
+            }
+            poolSizes.push_back({ type, std::max(descriptors, 1u) });
+        }
+
+        return std::make_unique<VaDescriptorPool>(vaDevice, maxSets, poolFlags, poolSizes);
+    }
+
     // *************** Descriptor Writer *********************
 
     VaDescriptorWriter::VaDescriptorWriter(VaDescriptorSetLayout& setLayout, VaDescriptorPool& pool)
-        : setLayout{ setLayout }, pool{ pool } {}
+        : setLayout{ setLayout }, pool{ &pool } {}
+
+    VaDescriptorWriter::VaDescriptorWriter(VaDescriptorSetLayout& setLayout, VaDescriptorAllocator& allocator)
+        : setLayout{ setLayout }, allocator{ &allocator } {}
+
+    VaDescriptorWriter::VaDescriptorWriter(VaDescriptorSetLayout& setLayout)
+        : setLayout{ setLayout } {}
 
     VaDescriptorWriter& VaDescriptorWriter::writeBuffer(
         uint32_t binding, VkDescriptorBufferInfo* bufferInfo) {
@@ -154,19 +358,20 @@ namespace va {
     }
 
     VaDescriptorWriter& VaDescriptorWriter::writeImage(
-        uint32_t binding, VkDescriptorImageInfo* imageInfo) {
+        uint32_t binding, VkDescriptorImageInfo* imageInfo, uint32_t arrayElement) {
         assert(setLayout.bindings.count(binding) == 1 && "Layout does not contain specified binding");
 
         auto& bindingDescription = setLayout.bindings[binding];
 
         assert(
-            bindingDescription.descriptorCount == 1 &&
-            "Binding single descriptor info, but binding expects multiple");
+            arrayElement < bindingDescription.descriptorCount &&
+            "Array element is past the end of the binding");
 
         VkWriteDescriptorSet write{};
         write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         write.descriptorType = bindingDescription.descriptorType;
         write.dstBinding = binding;
+        write.dstArrayElement = arrayElement;
         write.pImageInfo = imageInfo;
         write.descriptorCount = 1;
 
@@ -175,8 +380,11 @@ namespace va {
     }
 
     bool VaDescriptorWriter::build(VkDescriptorSet& set) {
-        bool success = pool.allocateDescriptor(setLayout.getDescriptorSetLayout(), set);
-        if (!success) {
+        assert(!setLayout.isPushDescriptor() && "Push descriptor sets get pushed, not built");
+        if (allocator != nullptr) {
+            allocator->allocate(setLayout, set);
+        }
+        else if (pool == nullptr || !pool->allocateDescriptor(setLayout.getDescriptorSetLayout(), set)) {
             return false;
         }
         overwrite(set);
@@ -184,9 +392,45 @@ namespace va {
     }
 
     void VaDescriptorWriter::overwrite(VkDescriptorSet& set) {
-        for (auto& write : writes) {
-            write.dstSet = set;
+        if (writes.empty()) {
+            return;
+        }
+
+        // bindless tables write one element at a time all over their arrays, a template for every element they
+        // touch would be a waste, so anything past element 0 goes the plain way
+        bool templated = std::all_of(writes.begin(), writes.end(), [](const VkWriteDescriptorSet& write) {
+            return write.dstArrayElement == 0;
+        });
+        if (!templated) {
+            for (auto& write : writes) {
+                write.dstSet = set;
+            }
+            vkUpdateDescriptorSets(setLayout.vaDevice.device(), writes.size(), writes.data(), 0, nullptr);
+            return;
         }
-        vkUpdateDescriptorSets(pool.vaDevice.device(), writes.size(), writes.data(), 0, nullptr);
+
+        VkDescriptorUpdateTemplate updateTemplate = setLayout.getUpdateTemplate(writes);
+        std::vector<VaDescriptorData> data(writes.size());
+        for (size_t i = 0; i < writes.size(); i++) {
+            if (writes[i].pImageInfo != nullptr) {
+                data[i].image = *writes[i].pImageInfo;
+            }
+            else {
+                data[i].buffer = *writes[i].pBufferInfo;
+            }
+        }
+        vkUpdateDescriptorSetWithTemplate(setLayout.vaDevice.device(), set, updateTemplate, data.data());
+    }
+
+    void VaDescriptorWriter::push(
+        VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t set) {
+        assert(setLayout.isPushDescriptor() && "Layout wasn't made for push descriptors");
+        setLayout.vaDevice.pushDescriptorSet(
+            commandBuffer,
+            bindPoint,
+            pipelineLayout,
+            set,
+            static_cast<uint32_t>(writes.size()),
+            writes.data());
     }
 }
\ No newline at end of file
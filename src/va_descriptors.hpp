@@ -2,12 +2,19 @@
 
 #include "va_device.hpp"
 
+#include <map>
 #include <memory>
 #include <unordered_map>
 #include <vector>
 
 namespace va {
 
+    // one descriptor in the packed array update templates read from
+    union VaDescriptorData {
+        VkDescriptorImageInfo image;
+        VkDescriptorBufferInfo buffer;
+    };
+
     class VaDescriptorSetLayout {
     public:
         class Builder {
@@ -19,27 +26,46 @@ namespace va {
                 VkDescriptorType descriptorType,
                 VkShaderStageFlags stageFlags,
                 uint32_t count = 1);
+            // descriptor indexing flags (partially bound, update after bind...) for a binding that's already added
+            Builder& setBindingFlags(uint32_t binding, VkDescriptorBindingFlags flags);
+            // for sets that get pushed straight into the command buffer with VaDescriptorWriter::push instead of
+            // being allocated. Needs VaDevice::hasPushDescriptors, and no dynamic buffers
+            Builder& setPushDescriptor();
             std::unique_ptr<VaDescriptorSetLayout> build() const;
 
         private:
             VaDevice& vaDevice;
             std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+            std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags{};
+            VkDescriptorSetLayoutCreateFlags layoutFlags = 0;
         };
 
         VaDescriptorSetLayout(
-            VaDevice& vaDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+            VaDevice& vaDevice,
+            std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+            const std::unordered_map<uint32_t, VkDescriptorBindingFlags>& bindingFlags = {},
+            VkDescriptorSetLayoutCreateFlags layoutFlags = 0);
         ~VaDescriptorSetLayout();
         VaDescriptorSetLayout(const VaDescriptorSetLayout&) = delete;
         VaDescriptorSetLayout& operator=(const VaDescriptorSetLayout&) = delete;
 
         VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+        bool isPushDescriptor() const { return pushDescriptor; }
+        const std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding>& getBindings() const { return bindings; }
 
     private:
+        // one template per distinct list of (binding, element) a writer fills in, made the first time it shows up.
+        // The data it reads is a VaDescriptorData per write, in the same order
+        VkDescriptorUpdateTemplate getUpdateTemplate(const std::vector<VkWriteDescriptorSet>& writes);
+
         VaDevice& vaDevice;
         VkDescriptorSetLayout descriptorSetLayout;
         std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings;
+        bool pushDescriptor = false;
+        std::map<std::vector<uint64_t>, VkDescriptorUpdateTemplate> updateTemplates;
 
         friend class VaDescriptorWriter;
+        friend class VaDescriptorAllocator;
     };
 
     class VaDescriptorPool {
@@ -85,19 +111,68 @@ namespace va {
         friend class VaDescriptorWriter;
     };
 
+    // Hands out sets from as many pools as it takes, so allocating never fails just because a pool ran out. When the
+    // current pool is full a new one gets made, sized from how many of each descriptor type the sets allocated so far
+    // actually used and a bit bigger every time, so nothing needs tuning up front however many objects there are.
+    class VaDescriptorAllocator {
+    public:
+        // sets in the first pool, every new pool doubles it up to MAX_SETS_PER_POOL
+        static constexpr uint32_t INITIAL_SETS_PER_POOL = 64;
+        static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+        // VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT in poolFlags to be able to free sets one by one
+        explicit VaDescriptorAllocator(VaDevice& vaDevice, VkDescriptorPoolCreateFlags poolFlags = 0);
+        VaDescriptorAllocator(const VaDescriptorAllocator&) = delete;
+        VaDescriptorAllocator& operator=(const VaDescriptorAllocator&) = delete;
+
+        // only throws for something other than running out of pool space
+        void allocate(const VaDescriptorSetLayout& setLayout, VkDescriptorSet& set);
+        // needs the free flag
+        void free(const std::vector<VkDescriptorSet>& sets);
+        // every set from every pool at once, only once none of them can still be in use. The pools stay around
+        void resetPools();
+
+    private:
+        std::unique_ptr<VaDescriptorPool> createPool(const VaDescriptorSetLayout& setLayout);
+
+        VaDevice& vaDevice;
+        VkDescriptorPoolCreateFlags poolFlags;
+        uint32_t setsPerPool = INITIAL_SETS_PER_POOL;
+
+        std::vector<std::unique_ptr<VaDescriptorPool>> pools;
+        // allocations go to this one first, everything before it has already run out once
+        size_t currentPool = 0;
+        // which pool a set came from, only kept when sets can be freed
+        std::unordered_map<VkDescriptorSet, size_t> setPools;
+
+        // descriptors of each type per set so far, what new pools get sized by
+        std::unordered_map<VkDescriptorType, uint64_t> descriptorsAllocated;
+        uint64_t setsAllocated = 0;
+    };
+
     class VaDescriptorWriter {
     public:
         VaDescriptorWriter(VaDescriptorSetLayout& setLayout, VaDescriptorPool& pool);
+        VaDescriptorWriter(VaDescriptorSetLayout& setLayout, VaDescriptorAllocator& allocator);
+        // push descriptor layouts, or sets built through a VaDescriptorSetCache, which allocates them itself
+        explicit VaDescriptorWriter(VaDescriptorSetLayout& setLayout);
 
         VaDescriptorWriter& writeBuffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo);
-        VaDescriptorWriter& writeImage(uint32_t binding, VkDescriptorImageInfo* imageInfo);
+        VaDescriptorWriter& writeImage(uint32_t binding, VkDescriptorImageInfo* imageInfo, uint32_t arrayElement = 0);
 
         bool build(VkDescriptorSet& set);
+        // goes through the layout's update template for this set of writes when it can
         void overwrite(VkDescriptorSet& set);
+        // records the writes straight into the command buffer as set number `set` of the pipeline layout
+        void push(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t set);
 
     private:
         VaDescriptorSetLayout& setLayout;
-        VaDescriptorPool& pool;
+        // exactly one of these is set
+        VaDescriptorPool* pool = nullptr;
+        VaDescriptorAllocator* allocator = nullptr;
         std::vector<VkWriteDescriptorSet> writes;
+
+        friend class VaDescriptorSetCache;
     };
 }
\ No newline at end of file
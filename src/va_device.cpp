@@ -1,5 +1,8 @@
 #include "va_device.hpp"
+#include "va_descriptor_set_cache.hpp"
 
+#include <algorithm>
+#include <cassert>
 #include <cstring>
 #include <iostream>
 #include <set>
@@ -48,11 +51,28 @@ VaDevice::VaDevice(VaWindow &window) : window{window} {
   setupDebugMessenger();
   createSurface();
   pickPhysicalDevice();
+  cacheMemoryProperties();
   createLogicalDevice();
   createCommandPool();
+  pipelineCache_.init();
 }
 
 VaDevice::~VaDevice() {
+  vkDeviceWaitIdle(device_);
+  deletionQueue_.flush();
+  bufferPool_.clear();
+  samplerCache_.clear();
+  pipelineStates_.clear();
+  layoutCache_.clear();
+  shaderModules_.clear();
+  pipelineCache_.destroy();
+
+  auto memoryStats = memoryTracker_.getStats();
+  if (memoryStats.total.allocations > 0) {
+    std::cerr << "leaked " << memoryStats.total.allocations << " device memory allocations ("
+              << memoryStats.total.bytes << " bytes)" << std::endl;
+  }
+
   vkDestroyCommandPool(device_, commandPool, nullptr);
   vkDestroyDevice(device_, nullptr);
 
@@ -145,18 +165,81 @@ void VaDevice::createLogicalDevice() {
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+  textureCompressionBCEnabled = supportedFeatures.textureCompressionBC == VK_TRUE;
+  fragmentStoresEnabled = supportedFeatures.fragmentStoresAndAtomics == VK_TRUE;
+
   VkPhysicalDeviceFeatures deviceFeatures = {};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
+  deviceFeatures.textureCompressionBC = textureCompressionBCEnabled ? VK_TRUE : VK_FALSE;
+  // the virtual texture's feedback gets written straight from the terrain fragment shader
+  deviceFeatures.fragmentStoresAndAtomics = fragmentStoresEnabled ? VK_TRUE : VK_FALSE;
+
+  // descriptor indexing is what the bindless texture table runs on. Core since 1.2, the extension before that
+  VkPhysicalDeviceDescriptorIndexingFeatures supportedIndexing{};
+  supportedIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+  VkPhysicalDeviceFeatures2 supportedFeatures2{};
+  supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  supportedFeatures2.pNext = &supportedIndexing;
+  vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures2);
+
+  bool indexingExtension = properties.apiVersion < VK_API_VERSION_1_2;
+  descriptorIndexingEnabled =
+      (!indexingExtension || isDeviceExtensionAvailable(physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) &&
+      supportedIndexing.runtimeDescriptorArray &&
+      supportedIndexing.descriptorBindingPartiallyBound &&
+      supportedIndexing.descriptorBindingSampledImageUpdateAfterBind &&
+      supportedIndexing.descriptorBindingUpdateUnusedWhilePending &&
+      supportedIndexing.shaderSampledImageArrayNonUniformIndexing;
+
+  VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+  indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+  if (descriptorIndexingEnabled) {
+    indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+    indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+    indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+
+    VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+    indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties2{};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &indexingProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+    maxBindlessTextures_ = std::min({
+        indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+        indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+        indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+        indexingProperties.maxDescriptorSetUpdateAfterBindSamplers});
+  }
 
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  // only asked for when it's there, a driver without it doesn't have to know the struct
+  createInfo.pNext = descriptorIndexingEnabled ? &indexingFeatures : nullptr;
 
   createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
+  std::vector<const char *> enabledExtensions(deviceExtensions.begin(), deviceExtensions.end());
+  memoryBudgetEnabled = isDeviceExtensionAvailable(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  if (memoryBudgetEnabled) {
+    enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  }
+  if (descriptorIndexingEnabled && indexingExtension) {
+    enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+  }
+  // lets per-draw descriptors go straight into the command buffer without allocating a set
+  bool pushDescriptorsAvailable = isDeviceExtensionAvailable(physicalDevice, VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+  if (pushDescriptorsAvailable) {
+    enabledExtensions.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+  }
+
   createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+  createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
   if (enableValidationLayers) {
     createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -171,6 +254,24 @@ void VaDevice::createLogicalDevice() {
 
   vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+
+  if (pushDescriptorsAvailable) {
+    vkCmdPushDescriptorSetKHR_ =
+        (PFN_vkCmdPushDescriptorSetKHR)vkGetDeviceProcAddr(device_, "vkCmdPushDescriptorSetKHR");
+  }
+
+  memoryTracker_.init(physicalDevice, memoryBudgetEnabled);
+}
+
+void VaDevice::pushDescriptorSet(
+    VkCommandBuffer commandBuffer,
+    VkPipelineBindPoint bindPoint,
+    VkPipelineLayout layout,
+    uint32_t set,
+    uint32_t writeCount,
+    const VkWriteDescriptorSet *writes) {
+  assert(hasPushDescriptors() && "Push descriptors aren't enabled on this device");
+  vkCmdPushDescriptorSetKHR_(commandBuffer, bindPoint, layout, set, writeCount, writes);
 }
 
 void VaDevice::createCommandPool() {
@@ -311,6 +412,25 @@ bool VaDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
   return requiredExtensions.empty();
 }
 
+bool VaDevice::isDeviceExtensionAvailable(VkPhysicalDevice device, const char *extensionName) {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(
+      device,
+      nullptr,
+      &extensionCount,
+      availableExtensions.data());
+
+  for (const auto &extension : availableExtensions) {
+    if (strcmp(extension.extensionName, extensionName) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 QueueFamilyIndices VaDevice::findQueueFamilies(VkPhysicalDevice device) {
   QueueFamilyIndices indices;
 
@@ -384,13 +504,67 @@ VkFormat VaDevice::findSupportedFormat(
   throw std::runtime_error("failed to find supported format!");
 }
 
-uint32_t VaDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-  VkPhysicalDeviceMemoryProperties memProperties;
+bool VaDevice::isFormatSupported(VkFormat format, VkFormatFeatureFlags features) {
+  VkFormatProperties props;
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+  return (props.optimalTilingFeatures & features) == features;
+}
+
+void VaDevice::cacheMemoryProperties() {
   vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+  // resizable bar exposes all of vram this way, without it there's usually still a 256MB window which
+  // is plenty for per-frame uniform and instance data
+  const VkMemoryPropertyFlags rebarFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+                                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+    if ((memProperties.memoryTypes[i].propertyFlags & rebarFlags) == rebarFlags) {
+      dynamicMemoryProperties_ = rebarFlags;
+      std::cout << "device local host visible memory: "
+                << memProperties.memoryHeaps[memProperties.memoryTypes[i].heapIndex].size / (1024 * 1024)
+                << " MiB heap" << std::endl;
+      break;
+    }
+  }
+}
+
+uint32_t VaDevice::lookupMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+  uint64_t key = (static_cast<uint64_t>(typeFilter) << 32) | properties;
+
+  std::lock_guard<std::mutex> lock{memoryTypeMutex};
+  auto cached = memoryTypeCache.find(key);
+  if (cached != memoryTypeCache.end()) {
+    return cached->second;
+  }
+
+  uint32_t memoryType = NO_MEMORY_TYPE;
   for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
     if ((typeFilter & (1 << i)) &&
         (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-      return i;
+      memoryType = i;
+      break;
+    }
+  }
+  // misses are cached too, fallback chains hit them on every allocation
+  memoryTypeCache[key] = memoryType;
+  return memoryType;
+}
+
+uint32_t VaDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+  uint32_t memoryType = lookupMemoryType(typeFilter, properties);
+  if (memoryType == NO_MEMORY_TYPE) {
+    throw std::runtime_error("failed to find suitable memory type!");
+  }
+  return memoryType;
+}
+
+uint32_t VaDevice::findMemoryType(
+    uint32_t typeFilter, const std::vector<VkMemoryPropertyFlags> &candidates) {
+  for (VkMemoryPropertyFlags properties : candidates) {
+    uint32_t memoryType = lookupMemoryType(typeFilter, properties);
+    if (memoryType != NO_MEMORY_TYPE) {
+      return memoryType;
     }
   }
 
@@ -416,14 +590,33 @@ void VaDevice::createBuffer(
   VkMemoryRequirements memRequirements;
   vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
+  // device local host visible memory can be a small window, so anything asking for it falls back to
+  // plain host visible memory rather than failing
+  const VkMemoryPropertyFlags rebarFlags =
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+  std::vector<VkMemoryPropertyFlags> candidates{properties};
+  if ((properties & rebarFlags) == rebarFlags) {
+    candidates.push_back(properties & ~VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  }
+
   VkMemoryAllocateInfo allocInfo{};
   allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
   allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, candidates);
 
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
+  VkResult result = vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory);
+  if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY && candidates.size() > 1) {
+    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, candidates.back());
+    result = vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory);
+  }
+  if (result != VK_SUCCESS) {
     throw std::runtime_error("failed to allocate vertex buffer memory!");
   }
+  memoryTracker_.recordAllocation(
+      bufferMemory,
+      allocInfo.allocationSize,
+      allocInfo.memoryTypeIndex,
+      VaMemoryTracker::categorizeBuffer(usage));
 
   vkBindBufferMemory(device_, buffer, bufferMemory, 0);
 }
@@ -499,6 +692,19 @@ void VaDevice::copyBufferToImage(
   endSingleTimeCommands(commandBuffer);
 }
 
+void VaDevice::copyBufferToImage(
+    VkBuffer buffer, VkImage image, const std::vector<VkBufferImageCopy> &regions) {
+  VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+  vkCmdCopyBufferToImage(
+      commandBuffer,
+      buffer,
+      image,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      static_cast<uint32_t>(regions.size()),
+      regions.data());
+  endSingleTimeCommands(commandBuffer);
+}
+
 void VaDevice::createImageWithInfo(
     const VkImageCreateInfo &imageInfo,
     VkMemoryPropertyFlags properties,
@@ -519,12 +725,41 @@ void VaDevice::createImageWithInfo(
   if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
     throw std::runtime_error("failed to allocate image memory!");
   }
+  memoryTracker_.recordAllocation(
+      imageMemory,
+      allocInfo.allocationSize,
+      allocInfo.memoryTypeIndex,
+      VaMemoryTracker::categorizeImage(imageInfo.usage));
 
   if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
     throw std::runtime_error("failed to bind image memory!");
   }
 }
 
+void VaDevice::freeMemory(VkDeviceMemory memory) {
+  memoryTracker_.recordFree(memory);
+  vkFreeMemory(device_, memory, nullptr);
+}
+
+void VaDevice::addDescriptorSetCache(VaDescriptorSetCache *cache) {
+  std::lock_guard<std::mutex> lock{descriptorSetCacheMutex};
+  descriptorSetCaches.push_back(cache);
+}
+
+void VaDevice::removeDescriptorSetCache(VaDescriptorSetCache *cache) {
+  std::lock_guard<std::mutex> lock{descriptorSetCacheMutex};
+  descriptorSetCaches.erase(
+      std::remove(descriptorSetCaches.begin(), descriptorSetCaches.end(), cache),
+      descriptorSetCaches.end());
+}
+
+void VaDevice::forgetDescriptorHandle(uint64_t handle) {
+  std::lock_guard<std::mutex> lock{descriptorSetCacheMutex};
+  for (VaDescriptorSetCache *cache : descriptorSetCaches) {
+    cache->forget(handle);
+  }
+}
+
 void VaDevice::transitionImageLayout(
     VkImage image, 
     VkFormat format, 
@@ -580,90 +815,4 @@ void VaDevice::transitionImageLayout(
 
     endSingleTimeCommands(commandBuffer);
 }
-
-void VaDevice::generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels) {
-    VkFormatProperties formatProperties;
-    vkGetPhysicalDeviceFormatProperties(physicalDevice, imageFormat, &formatProperties);
-
-    if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
-        throw std::runtime_error("texture image format does not support linear blitting");
-    }
-    
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-    VkImageMemoryBarrier barrier{};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.image = image;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-    barrier.subresourceRange.levelCount = 1;
-
-    int32_t mipWidth = texWidth;
-    int32_t mipHeight = texHeight;
-
-    for (uint32_t i = 1; i < mipLevels; i++) {
-        barrier.subresourceRange.baseMipLevel = i - 1;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-        vkCmdPipelineBarrier(commandBuffer,
-            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
-
-        VkImageBlit blit{};
-        blit.srcOffsets[0] = { 0, 0, 0 };
-        blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
-        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        blit.srcSubresource.mipLevel = i - 1;
-        blit.srcSubresource.baseArrayLayer = 0;
-        blit.srcSubresource.layerCount = 1;
-        blit.dstOffsets[0] = { 0, 0, 0 };
-        blit.dstOffsets[1] = { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1 };
-        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        blit.dstSubresource.mipLevel = i;
-        blit.dstSubresource.baseArrayLayer = 0;
-        blit.dstSubresource.layerCount = 1;
-
-        vkCmdBlitImage(commandBuffer,
-            image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-            image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            1, &blit,
-            VK_FILTER_LINEAR);
-
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        vkCmdPipelineBarrier(commandBuffer,
-            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
-
-        if (mipWidth > 1) mipWidth /= 2;
-        if (mipHeight > 1) mipHeight /= 2;
-    }
-
-    barrier.subresourceRange.baseMipLevel = mipLevels - 1;
-    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-    vkCmdPipelineBarrier(commandBuffer,
-        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-        0, nullptr,
-        0, nullptr,
-        1, &barrier);
-
-    endSingleTimeCommands(commandBuffer);
-}
 }
\ No newline at end of file
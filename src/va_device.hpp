@@ -1,11 +1,24 @@
 #pragma once
 
 #include "va_window.hpp"
-
+#include "va_buffer_pool.hpp"
+#include "va_deletion_queue.hpp"
+#include "va_layout_cache.hpp"
+#include "va_memory_stats.hpp"
+#include "va_pipeline_cache.hpp"
+#include "va_pipeline_state_cache.hpp"
+#include "va_sampler_cache.hpp"
+#include "va_shader_module_cache.hpp"
+#include "va_thread_pool.hpp"
+
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace va {
+class VaDescriptorSetCache;
+
 struct SwapChainSupportDetails {
   VkSurfaceCapabilitiesKHR capabilities;
   std::vector<VkSurfaceFormatKHR> formats;
@@ -41,10 +54,49 @@ class VaDevice {
   VkSurfaceKHR surface() { return surface_; }
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
+  VaDeletionQueue &deletionQueue() { return deletionQueue_; }
+  VaMemoryTracker &memoryTracker() { return memoryTracker_; }
+  VaBufferPool &bufferPool() { return bufferPool_; }
+  VaThreadPool &threadPool() { return threadPool_; }
+  VaSamplerCache &samplerCache() { return samplerCache_; }
+  VaPipelineCache &pipelineCache() { return pipelineCache_; }
+  VaShaderModuleCache &shaderModules() { return shaderModules_; }
+  VaPipelineStateCache &pipelineStates() { return pipelineStates_; }
+  VaLayoutCache &layoutCache() { return layoutCache_; }
+
+  // set caches are told about every view or buffer handle right before it's destroyed, so the driver handing the
+  // same handle to something new can't pull up a set written for the old one
+  void addDescriptorSetCache(VaDescriptorSetCache *cache);
+  void removeDescriptorSetCache(VaDescriptorSetCache *cache);
+  void forgetDescriptorHandle(uint64_t handle);
 
   SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
   uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+  // tries each set of flags in order and returns the first match, so callers can ask for a preferred memory type
+  // and fall back to one that's always there
+  uint32_t findMemoryType(uint32_t typeFilter, const std::vector<VkMemoryPropertyFlags> &candidates);
+  // flags for buffers the cpu rewrites every frame. Device local + host visible (resizable bar) when the
+  // device has it, so the gpu reads straight from vram without a staging copy
+  VkMemoryPropertyFlags dynamicMemoryProperties() const { return dynamicMemoryProperties_; }
+  bool hasDeviceLocalHostVisibleMemory() const {
+    return (dynamicMemoryProperties_ & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0;
+  }
   QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
+  bool isFormatSupported(VkFormat format, VkFormatFeatureFlags features);
+  bool hasTextureCompressionBC() const { return textureCompressionBCEnabled; }
+  bool hasDescriptorIndexing() const { return descriptorIndexingEnabled; }
+  bool hasFragmentStores() const { return fragmentStoresEnabled; }
+  // VK_KHR_push_descriptor, pushDescriptorSet only works with it
+  bool hasPushDescriptors() const { return vkCmdPushDescriptorSetKHR_ != nullptr; }
+  void pushDescriptorSet(
+      VkCommandBuffer commandBuffer,
+      VkPipelineBindPoint bindPoint,
+      VkPipelineLayout layout,
+      uint32_t set,
+      uint32_t writeCount,
+      const VkWriteDescriptorSet *writes);
+  // most sampled images an update after bind set can hold, 0 without descriptor indexing
+  uint32_t maxBindlessTextures() const { return maxBindlessTextures_; }
   VkFormat findSupportedFormat(
       const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
@@ -59,17 +111,17 @@ class VaDevice {
   void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
   void copyBufferToImage(
       VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
+  void copyBufferToImage(VkBuffer buffer, VkImage image, const std::vector<VkBufferImageCopy> &regions);
 
   void createImageWithInfo(
       const VkImageCreateInfo &imageInfo,
       VkMemoryPropertyFlags properties,
       VkImage &image,
       VkDeviceMemory &imageMemory);
+  void freeMemory(VkDeviceMemory memory);
 
   void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t layerCount, uint32_t mipLevels);
 
-  void generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
-
   VkPhysicalDeviceProperties properties;
 
  private:
@@ -79,6 +131,8 @@ class VaDevice {
   void pickPhysicalDevice();
   void createLogicalDevice();
   void createCommandPool();
+  void cacheMemoryProperties();
+  uint32_t lookupMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
   bool isDeviceSuitable(VkPhysicalDevice device);
   std::vector<const char *> getRequiredExtensions();
@@ -87,6 +141,7 @@ class VaDevice {
   void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
   void hasGflwRequiredInstanceExtensions();
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char *extensionName);
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
   VkInstance instance;
@@ -100,6 +155,32 @@ class VaDevice {
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
 
+  static constexpr uint32_t NO_MEMORY_TYPE = ~0u;
+
+  VkPhysicalDeviceMemoryProperties memProperties;
+  VkMemoryPropertyFlags dynamicMemoryProperties_ =
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  std::mutex memoryTypeMutex;
+  std::unordered_map<uint64_t, uint32_t> memoryTypeCache;
+
+  VaDeletionQueue deletionQueue_;
+  VaMemoryTracker memoryTracker_;
+  VaBufferPool bufferPool_{*this};
+  VaThreadPool threadPool_;
+  VaSamplerCache samplerCache_{*this};
+  VaPipelineCache pipelineCache_{*this};
+  VaShaderModuleCache shaderModules_{*this};
+  VaPipelineStateCache pipelineStates_{*this};
+  VaLayoutCache layoutCache_{*this};
+  std::mutex descriptorSetCacheMutex;
+  std::vector<VaDescriptorSetCache *> descriptorSetCaches;
+  bool memoryBudgetEnabled = false;
+  bool textureCompressionBCEnabled = false;
+  bool descriptorIndexingEnabled = false;
+  bool fragmentStoresEnabled = false;
+  uint32_t maxBindlessTextures_ = 0;
+  PFN_vkCmdPushDescriptorSetKHR vkCmdPushDescriptorSetKHR_ = nullptr;
+
   const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
   const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 };
@@ -0,0 +1,52 @@
+#include "va_frame_arena.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace va {
+	VaFrameArena::VaFrameArena(VaDevice& device, VkDeviceSize sizePerFrame, uint32_t frameCount)
+		: vaDevice{ device }, sizePerFrame{ sizePerFrame } {
+		alignment = std::max(
+			vaDevice.properties.limits.minUniformBufferOffsetAlignment,
+			vaDevice.properties.limits.minStorageBufferOffsetAlignment
+		);
+
+		frameBuffers.resize(frameCount);
+		for (auto& buffer : frameBuffers) {
+			buffer = std::make_unique<VaBuffer>(
+				vaDevice,
+				sizePerFrame,
+				1,
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				vaDevice.dynamicMemoryProperties()
+			);
+			buffer->map();
+		}
+	}
+
+	VaFrameArena::~VaFrameArena() {}
+
+	void VaFrameArena::beginFrame(int frameIndex) {
+		currentFrame = frameIndex;
+		head = 0;
+	}
+
+	VaFrameArena::Allocation VaFrameArena::allocate(VkDeviceSize size) {
+		VkDeviceSize offset = VaBuffer::getAlignment(head, alignment);
+		if (offset + size > sizePerFrame) {
+			throw std::runtime_error("frame arena out of space");
+		}
+		head = offset + size;
+
+		auto& buffer = frameBuffers[currentFrame];
+		return Allocation{
+			static_cast<char*>(buffer->getMappedMemory()) + offset,
+			static_cast<uint32_t>(offset),
+			buffer->getBuffer()
+		};
+	}
+
+	VkDescriptorBufferInfo VaFrameArena::descriptorInfo(int frameIndex, VkDeviceSize range) {
+		return frameBuffers[frameIndex]->descriptorInfo(range, 0);
+	}
+}
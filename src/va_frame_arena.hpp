@@ -0,0 +1,55 @@
+#pragma once
+
+#include "va_device.hpp"
+#include "va_buffer.hpp"
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace va {
+	// One persistently mapped buffer per frame in flight, handed out with a bump allocator. Allocations are aligned
+	// for dynamic uniform/storage offsets, so per-draw data is a memcpy and an offset with no allocations per frame.
+	class VaFrameArena {
+	public:
+		struct Allocation {
+			void* data;
+			uint32_t offset;
+			VkBuffer buffer;
+		};
+
+		VaFrameArena(VaDevice& device, VkDeviceSize sizePerFrame, uint32_t frameCount);
+		~VaFrameArena();
+
+		VaFrameArena(const VaFrameArena&) = delete;
+		VaFrameArena& operator=(const VaFrameArena&) = delete;
+
+		// only call once the frame's fence has been waited on, everything previously handed out for it is reused
+		void beginFrame(int frameIndex);
+
+		Allocation allocate(VkDeviceSize size);
+
+		template<typename T>
+		uint32_t push(const T& data) {
+			Allocation allocation = allocate(sizeof(T));
+			memcpy(allocation.data, &data, sizeof(T));
+			return allocation.offset;
+		}
+
+		// for a dynamic descriptor, range is the size of whatever gets read at each dynamic offset
+		VkDescriptorBufferInfo descriptorInfo(int frameIndex, VkDeviceSize range);
+
+		VkBuffer getBuffer(int frameIndex) const { return frameBuffers[frameIndex]->getBuffer(); }
+		VkDeviceSize getAlignment() const { return alignment; }
+		VkDeviceSize getUsedBytes() const { return head; }
+
+	private:
+		VaDevice& vaDevice;
+		std::vector<std::unique_ptr<VaBuffer>> frameBuffers;
+		VkDeviceSize sizePerFrame;
+		VkDeviceSize alignment;
+
+		int currentFrame = 0;
+		VkDeviceSize head = 0;
+	};
+}
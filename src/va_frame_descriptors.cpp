@@ -0,0 +1,14 @@
+#include "va_frame_descriptors.hpp"
+
+namespace va {
+	VaFrameDescriptors::VaFrameDescriptors(VaDevice& device, uint32_t frameCount) {
+		for (uint32_t i = 0; i < frameCount; i++) {
+			caches.push_back(std::make_unique<VaDescriptorSetCache>(device));
+		}
+	}
+
+	void VaFrameDescriptors::beginFrame(int frameIndex) {
+		currentFrame = frameIndex;
+		caches[frameIndex]->reset();
+	}
+}
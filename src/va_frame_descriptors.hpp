@@ -0,0 +1,31 @@
+#pragma once
+
+#include "va_device.hpp"
+#include "va_descriptors.hpp"
+#include "va_descriptor_set_cache.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace va {
+	// Descriptor sets that only have to last for the frame they're recorded in. Every frame in flight has its own
+	// pools, and they're all reset at once when the frame comes around again, so nothing ever gets freed one by one
+	// and the pools never fragment. Same idea as VaFrameArena, for descriptor sets instead of buffer space.
+	class VaFrameDescriptors {
+	public:
+		VaFrameDescriptors(VaDevice& device, uint32_t frameCount);
+
+		VaFrameDescriptors(const VaFrameDescriptors&) = delete;
+		VaFrameDescriptors& operator=(const VaFrameDescriptors&) = delete;
+
+		// only call once the frame's fence has been waited on, every set handed out for it last time goes away
+		void beginFrame(int frameIndex);
+
+		// the set is gone after this frame, writes that match a set already built this frame get that set back
+		void build(VaDescriptorWriter& writer, VkDescriptorSet& set) { caches[currentFrame]->build(writer, set); }
+
+	private:
+		std::vector<std::unique_ptr<VaDescriptorSetCache>> caches;
+		int currentFrame = 0;
+	};
+}
@@ -3,10 +3,24 @@
 #include "va_camera.hpp"
 #include "va_game_object.hpp"
 #include "va_cubemap.hpp"
+#include "va_frame_arena.hpp"
+#include "va_frame_descriptors.hpp"
 
 #include <vulkan/vulkan.h>
 
 namespace va {
+	// binding 0 of the global set. Render systems check their shaders' copy of it against this one
+	struct GlobalUbo {
+		alignas(16) glm::mat4 view{ 1.0f };
+		alignas(16) glm::mat4 inverseView{ 1.0f };
+		alignas(16) glm::mat4 projection{ 1.0f };
+		// When testing terrain rendering, this ambient aint used at all, since for now I'm just defaulting the terrain normals all straight up
+		//  so they all get the directional light equally
+		alignas(16) glm::vec4 ambientLightColor{ 1.0f, 1.0f, 1.0f, 0.0f };
+		alignas(16) glm::vec4 lightColor{ 0.4f, 0.2f, 0.6f, 1.0f };
+		alignas(16) glm::vec3 directionalLight{ 1.0f, -1.0f, -2.0f };
+	};
+
 	struct FrameInfo {
 		int frameIndex;
 		float frameTime;
@@ -14,5 +28,16 @@ namespace va {
 		VaCamera& camera;
 		VkDescriptorSet globalDescriptorSet;
 		VaGameObject::Map& gameObjects;
+		VaFrameArena& frameArena;
+		// dynamic offset of this frame's GlobalUbo inside the arena, binding 0 of the global set
+		uint32_t globalUboOffset;
+		// sets that only need to last for this frame
+		VaFrameDescriptors& frameDescriptors;
+		// the swap chain's current one. Anything built during the frame has to use this, whatever a render system
+		// was created with may have gone with an older swap chain
+		VkRenderPass renderPass;
+		// the pipeline layout the global set was last bound with. A render system whose layout is compatible with it
+		// for set 0 (VaLayoutCache::compatibleUpTo) can leave the set alone
+		VkPipelineLayout globalSetBoundWith = VK_NULL_HANDLE;
 	};
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "models_meshes/va_model.hpp"
 #include "va_image.hpp"
+#include "va_virtual_texture.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -21,15 +22,18 @@ namespace va {
 	public:
 		std::shared_ptr<VaModel> model{};
 		std::shared_ptr<VaImage> texture{};
-		VkDescriptorSet descriptorSet{};
 		glm::vec3 color{};
 		TransformComponent transform{};
+		// how many times the shader repeats the model's uvs, it's baked into the object's pipeline variant. The
+		// texture streamer needs it to know how dense the texels really are (the terrain wraps its uvs 1000 times)
+		float uvScale{ 1.0f };
 
 		// With my setup right now textures need to be stored inside the game object
-		// I used multiple textures for terrain so here they are.
-		// Maybe It could store a vector instead?
-		std::shared_ptr<VaImage> terrainTexture1{};
-		std::shared_ptr<VaImage> terrainTexture2{};
+		// Terrain has every material in one texture array, and the splat map picks which ones go where
+		std::shared_ptr<VaImage> terrainMaterials{};
+		std::shared_ptr<VaImage> terrainSplatMap{};
+		// set when the terrain draws out of a virtual texture instead, VaTerrainSystem picks these up
+		std::shared_ptr<VaVirtualTexture> virtualTexture{};
 
 		using id_t = unsigned int;
 		using Map = std::unordered_map<id_t, VaGameObject>;
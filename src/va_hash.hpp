@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace va {
+	// boost style combine, every cache key in here goes through this so they all mix the same way
+	template <typename Seed>
+	inline void hashCombine(Seed& seed, uint64_t value) {
+		seed ^= static_cast<Seed>(std::hash<uint64_t>{}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+	}
+
+	constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+
+	// fnv-1a over raw bytes, pass the previous result back in as hash to keep going over data read in chunks
+	inline uint64_t fnv1a(const void* data, size_t size, uint64_t hash = FNV_OFFSET_BASIS) {
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// vulkan handles are pointers or uint64_t depending on the platform, this gives the raw bits either way
+	template <typename T>
+	inline uint64_t handleBits(T handle) {
+		return (uint64_t)(handle);
+	}
+}
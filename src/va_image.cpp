@@ -1,94 +1,451 @@
 #include "va_image.hpp"
 
 #include "va_buffer.hpp"
+#include "va_hash.hpp"
+#include "va_mip_generator.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
 #include <stdexcept>
 
 #ifndef FILE_DIR
 #define FILE_DIR "../../../"
 #endif
 
+#define MIP_CACHE_DIR "cache/mips"
+
 namespace va {
-	VaImage::VaImage(VaDevice& device, const std::string& filepath) 
+	VaImage::VaImage(VaDevice& device, const std::string& filepath)
+		: VaImage{ device, loadTextureData(device, filepath) } {}
+
+	VaImage::VaImage(VaDevice& device, const VaKtxTexture& texture, uint32_t firstMip)
 		: vaDevice{ device } {
-		createTextureImage(filepath);
+		fullWidth = texture.width;
+		fullHeight = texture.height;
+		levelSizes.reserve(texture.levelCount);
+		for (const auto& level : texture.levels) {
+			levelSizes.push_back(level.size);
+		}
+
+		createTextureImage({ &texture }, std::min(firstMip, texture.levelCount - 1));
+		createTextureImageView();
+		createTextureSampler();
+		updateDescriptor();
+	}
+
+	VaImage::VaImage(VaDevice& device, const std::vector<VaKtxTexture>& layers)
+		: vaDevice{ device } {
+		if (layers.empty()) {
+			throw std::runtime_error("texture array needs at least one layer");
+		}
+
+		const VaKtxTexture& first = layers[0];
+		std::vector<const VaKtxTexture*> layerPointers;
+		for (const auto& layer : layers) {
+			if (layer.width != first.width || layer.height != first.height || layer.format != first.format || layer.levelCount != first.levelCount) {
+				throw std::runtime_error("texture array layers need the same size, format and mip count");
+			}
+			layerPointers.push_back(&layer);
+		}
+
+		array = true;
+		layerCount = static_cast<uint32_t>(layers.size());
+		fullWidth = first.width;
+		fullHeight = first.height;
+		levelSizes.reserve(first.levelCount);
+		for (const auto& level : first.levels) {
+			levelSizes.push_back(level.size * layerCount);
+		}
+
+		createTextureImage(layerPointers, 0);
 		createTextureImageView();
 		createTextureSampler();
 		updateDescriptor();
 	}
 
 	VaImage::~VaImage() {
-		vkDestroySampler(vaDevice.device(), textureSampler, nullptr);
-		vkDestroyImageView(vaDevice.device(), textureImageView, nullptr);
-		vkDestroyImage(vaDevice.device(), textureImage, nullptr);
-		vkFreeMemory(vaDevice.device(), textureImageMemory, nullptr);
+		destroyHandles();
 	}
 
-	void VaImage::createTextureImage(const std::string& filepath) {
-		int texWidth, texHeight, texChannels;
-		stbi_set_flip_vertically_on_load(true);
+	void VaImage::destroyHandles() {
+		vaDevice.deletionQueue().push([
+			device = &vaDevice,
+			view = textureImageView,
+			image = textureImage,
+			memory = textureImageMemory
+		]() {
+			device->forgetDescriptorHandle(handleBits(view));
+			vkDestroyImageView(device->device(), view, nullptr);
+			vkDestroyImage(device->device(), image, nullptr);
+			device->freeMemory(memory);
+		});
+	}
 
-		std::string filepathAdj = FILE_DIR + filepath;
+	std::vector<std::shared_ptr<VaImage>> VaImage::createImagesFromFiles(VaDevice& device, const std::vector<std::string>& filepaths) {
+		std::vector<std::future<VaKtxTexture>> loads;
+		loads.reserve(filepaths.size());
+		for (const auto& filepath : filepaths) {
+			loads.push_back(device.threadPool().submit([&device, filepath]() { return loadTextureData(device, filepath); }));
+		}
 
-		stbi_uc* pixels = stbi_load(filepathAdj.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-		VkDeviceSize imageSize = texWidth * texHeight * 4;
-		mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+		// uploads stay on this thread, they all go through the one command pool
+		std::vector<std::shared_ptr<VaImage>> images;
+		images.reserve(filepaths.size());
+		for (auto& load : loads) {
+			images.push_back(std::make_shared<VaImage>(device, load.get()));
+		}
+		return images;
+	}
 
-		if (!pixels) {
-			throw std::runtime_error("failed to load texture image");
+	std::shared_ptr<VaImage> VaImage::createArrayFromFiles(VaDevice& device, const std::vector<std::string>& filepaths) {
+		std::vector<std::future<VaKtxTexture>> loads;
+		loads.reserve(filepaths.size());
+		for (const auto& filepath : filepaths) {
+			loads.push_back(device.threadPool().submit([&device, filepath]() { return loadTextureData(device, filepath); }));
 		}
 
-		VaBuffer stagingBuffer{
-			vaDevice,
-			imageSize,
+		std::vector<VaKtxTexture> layers;
+		layers.reserve(filepaths.size());
+		for (auto& load : loads) {
+			layers.push_back(load.get());
+		}
+		return std::make_shared<VaImage>(device, layers);
+	}
+
+	VaKtxTexture VaImage::loadTextureData(VaDevice& device, const std::string& filepath) {
+		std::filesystem::path path{ FILE_DIR + filepath };
+		bool explicitKtx = path.extension() == ".ktx2";
+
+		// a converted .ktx2 sitting next to the png/jpg wins, so running the converter is all it takes to switch over
+		std::filesystem::path ktxPath = explicitKtx ? path : std::filesystem::path{ path }.replace_extension(".ktx2");
+		if (explicitKtx || std::filesystem::exists(ktxPath)) {
+			VaKtxTexture ktx = VaKtxTexture::loadFromFile(ktxPath.string());
+			// has to come out the same way up as the flipped png decode, or every uv on it is upside down
+			bool flippable = !ktx.isTopDown() || !VaKtxTexture::isBlockCompressed(ktx.format);
+			if (flippable && isKtxUsable(device, ktx)) {
+				if (ktx.isTopDown()) {
+					ktx.flipVertically();
+				}
+				return ktx;
+			}
+			if (explicitKtx) {
+				throw std::runtime_error(flippable
+					? "ktx2 texture format not supported by this device: " + filepath
+					: "block compressed ktx2 textures have to be stored bottom to top (KTXorientation ru): " + filepath);
+			}
+		}
+
+		return decodeTextureData(device, path.string());
+	}
+
+	bool VaImage::isKtxUsable(VaDevice& device, const VaKtxTexture& ktx) {
+		if (ktx.faceCount != 1 || ktx.layerCount != 1) {
+			return false;
+		}
+		if (VaKtxTexture::isBlockCompressed(ktx.format) && !device.hasTextureCompressionBC()) {
+			return false;
+		}
+		return device.isFormatSupported(ktx.format, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+	}
+
+	// stages levels [first, end) of every layer and fills in the copy regions for them, with dstBaseMip being the
+	// full chain mip that sits at level 0 of the destination image
+	static std::unique_ptr<VaBuffer> stageLevels(
+		VaDevice& device,
+		const std::vector<const VaKtxTexture*>& layers,
+		uint32_t first,
+		uint32_t end,
+		uint32_t dstBaseMip,
+		std::vector<VkBufferImageCopy>& regions
+	) {
+		// only the levels going up get copied. Level offsets are all aligned, so shifting them by the lowest one
+		// keeps them aligned for the copy, and each layer starts on a 16 byte boundary which covers every block size
+		std::vector<size_t> begins;
+		std::vector<size_t> sizes;
+		std::vector<size_t> stagingOffsets;
+		size_t stagingSize = 0;
+		for (const VaKtxTexture* ktx : layers) {
+			size_t begin = ktx->levels[first].offset;
+			size_t last = 0;
+			for (uint32_t i = first; i < end; i++) {
+				begin = std::min(begin, ktx->levels[i].offset);
+				last = std::max(last, ktx->levels[i].offset + ktx->levels[i].size);
+			}
+			stagingSize = (stagingSize + 15) & ~static_cast<size_t>(15);
+			begins.push_back(begin);
+			sizes.push_back(last - begin);
+			stagingOffsets.push_back(stagingSize);
+			stagingSize += last - begin;
+		}
+
+		auto stagingBuffer = std::make_unique<VaBuffer>(
+			device,
+			stagingSize,
 			1,
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-		};
+		);
+		stagingBuffer->map();
 
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)pixels);
+		for (uint32_t layer = 0; layer < layers.size(); layer++) {
+			const VaKtxTexture& ktx = *layers[layer];
+			stagingBuffer->writeToBuffer(const_cast<uint8_t*>(ktx.data.data() + begins[layer]), sizes[layer], stagingOffsets[layer]);
 
-		stbi_image_free(pixels);
+			for (uint32_t i = first; i < end; i++) {
+				VkBufferImageCopy region{};
+				region.bufferOffset = stagingOffsets[layer] + ktx.levels[i].offset - begins[layer];
+				region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				region.imageSubresource.mipLevel = i - dstBaseMip;
+				region.imageSubresource.baseArrayLayer = layer;
+				region.imageSubresource.layerCount = 1;
+				region.imageOffset = { 0, 0, 0 };
+				region.imageExtent = { std::max(ktx.width >> i, 1u), std::max(ktx.height >> i, 1u), 1 };
+				regions.push_back(region);
+			}
+		}
+
+		return stagingBuffer;
+	}
 
+	static void imageBarrier(
+		VkCommandBuffer commandBuffer,
+		VkImage image,
+		VkImageLayout oldLayout,
+		VkImageLayout newLayout,
+		VkAccessFlags srcAccess,
+		VkAccessFlags dstAccess,
+		VkPipelineStageFlags srcStage,
+		VkPipelineStageFlags dstStage,
+		uint32_t baseMip,
+		uint32_t levelCount
+	) {
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = baseMip;
+		barrier.subresourceRange.levelCount = levelCount;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+
+		vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	void VaImage::createTextureImage(const std::vector<const VaKtxTexture*>& layers, uint32_t firstMip) {
+		const VaKtxTexture& ktx = *layers[0];
+		format = ktx.format;
+		residentMip = firstMip;
+		mipLevels = ktx.levelCount - firstMip;
+
+		std::vector<VkBufferImageCopy> regions;
+		auto stagingBuffer = stageLevels(vaDevice, layers, firstMip, ktx.levelCount, firstMip, regions);
+
+		// transfer src as well so streaming can copy resident mips out into a replacement image
 		createImage(
-			texWidth, 
-			texHeight, 
-			VK_FORMAT_R8G8B8A8_SRGB, 
-			VK_IMAGE_TILING_OPTIMAL, 
+			std::max(ktx.width >> firstMip, 1u),
+			std::max(ktx.height >> firstMip, 1u),
+			format,
+			VK_IMAGE_TILING_OPTIMAL,
 			VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
-			textureImage, 
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			textureImage,
 			textureImageMemory,
-			mipLevels
+			mipLevels,
+			layerCount
 		);
 
 		vaDevice.transitionImageLayout(
-			textureImage, 
-			VK_FORMAT_R8G8B8A8_SRGB, 
-			VK_IMAGE_LAYOUT_UNDEFINED, 
+			textureImage,
+			format,
+			VK_IMAGE_LAYOUT_UNDEFINED,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			1,
+			layerCount,
 			mipLevels
 		);
-		vaDevice.copyBufferToImage(
-			stagingBuffer.getBuffer(),
-			textureImage, 
-			static_cast<uint32_t>(texWidth), 
-			static_cast<uint32_t>(texHeight), 1
-		);
-		/*vaDevice.transitionImageLayout(
-			textureImage, 
-			VK_FORMAT_R8G8B8A8_SRGB, 
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
+		vaDevice.copyBufferToImage(stagingBuffer->getBuffer(), textureImage, regions);
+		vaDevice.transitionImageLayout(
+			textureImage,
+			format,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			1,
+			layerCount,
 			mipLevels
-		);*/
-		vaDevice.generateMipmaps(textureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, mipLevels);
+		);
+	}
+
+	VkDeviceSize VaImage::residentBytesFrom(uint32_t mip) const {
+		VkDeviceSize bytes = 0;
+		for (uint32_t i = mip; i < levelSizes.size(); i++) {
+			bytes += levelSizes[i];
+		}
+		return bytes;
+	}
+
+	void VaImage::setResidentMip(uint32_t mip, const VaKtxTexture* texture, VkCommandBuffer frameCommandBuffer) {
+		uint32_t fullLevels = getFullMipLevels();
+		mip = std::min(mip, fullLevels - 1);
+		if (mip == residentMip) {
+			return;
+		}
+		if (array) {
+			throw std::runtime_error("texture arrays can't change their resident mips");
+		}
+		if (mip < residentMip && texture == nullptr) {
+			throw std::runtime_error("streaming in finer mips needs the texture data");
+		}
+
+		uint32_t newLevels = fullLevels - mip;
+		VkImage newImage;
+		VkDeviceMemory newMemory;
+		createImage(
+			std::max(fullWidth >> mip, 1u),
+			std::max(fullHeight >> mip, 1u),
+			format,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			newImage,
+			newMemory,
+			newLevels
+		);
+
+		std::vector<VkBufferImageCopy> uploads;
+		std::unique_ptr<VaBuffer> stagingBuffer;
+		if (mip < residentMip) {
+			stagingBuffer = stageLevels(vaDevice, { texture }, mip, residentMip, mip, uploads);
+		}
+
+		// everything from here down is already on the gpu, copy it over instead of uploading it again
+		uint32_t keptBegin = std::max(mip, residentMip);
+		std::vector<VkImageCopy> copies;
+		for (uint32_t i = keptBegin; i < fullLevels; i++) {
+			VkImageCopy copy{};
+			copy.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - residentMip, 0, 1 };
+			copy.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - mip, 0, 1 };
+			copy.extent = { std::max(fullWidth >> i, 1u), std::max(fullHeight >> i, 1u), 1 };
+			copies.push_back(copy);
+		}
+
+		// the staging buffer goes through the deletion queue when it's destroyed, so recording into a frame is fine
+		VkCommandBuffer commandBuffer = frameCommandBuffer != VK_NULL_HANDLE ? frameCommandBuffer : vaDevice.beginSingleTimeCommands();
+		imageBarrier(
+			commandBuffer, newImage,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			0, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, newLevels
+		);
+		// the old image never goes back to shader read, it's only ever destroyed after this
+		imageBarrier(
+			commandBuffer, textureImage,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			keptBegin - residentMip, fullLevels - keptBegin
+		);
+		vkCmdCopyImage(
+			commandBuffer,
+			textureImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<uint32_t>(copies.size()), copies.data()
+		);
+		if (!uploads.empty()) {
+			vkCmdCopyBufferToImage(
+				commandBuffer,
+				stagingBuffer->getBuffer(),
+				newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				static_cast<uint32_t>(uploads.size()), uploads.data()
+			);
+		}
+		imageBarrier(
+			commandBuffer, newImage,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0, newLevels
+		);
+		if (frameCommandBuffer == VK_NULL_HANDLE) {
+			vaDevice.endSingleTimeCommands(commandBuffer);
+		}
+
+		// frames already in flight still hold the old handles, so they go through the deletion queue. The sampler
+		// belongs to the device's cache, so that one just gets looked up again
+		destroyHandles();
+		textureImage = newImage;
+		textureImageMemory = newMemory;
+		residentMip = mip;
+		mipLevels = newLevels;
+		createTextureImageView();
+		createTextureSampler();
+		updateDescriptor();
+		generation++;
+	}
+
+	VaKtxTexture VaImage::decodeTextureData(VaDevice& device, const std::string& filepathAdj) {
+		std::filesystem::path cachePath = mipCachePath(filepathAdj);
+		if (std::filesystem::exists(cachePath)) {
+			try {
+				return VaKtxTexture::loadFromFile(cachePath.string());
+			}
+			catch (const std::exception& e) {
+				std::cerr << "ignoring bad mip cache entry " << cachePath.string() << ": " << e.what() << '\n';
+			}
+		}
+
+		int texWidth, texHeight, texChannels;
+		// always the per thread flag: this runs on pool threads, and once a thread has set it stb ignores the global one
+		stbi_set_flip_vertically_on_load_thread(true);
+
+		stbi_uc* pixels = stbi_load(filepathAdj.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+		if (!pixels) {
+			throw std::runtime_error("failed to load texture image");
+		}
+
+		VaKtxTexture chain = VaMipGenerator::generate(
+			pixels,
+			static_cast<uint32_t>(texWidth),
+			static_cast<uint32_t>(texHeight),
+			true,
+			device.threadPool()
+		);
+		stbi_image_free(pixels);
+
+		// the cache is only an optimisation, a read only checkout or full disk shouldn't stop the texture loading
+		try {
+			std::filesystem::create_directories(cachePath.parent_path());
+			chain.writeToFile(cachePath.string());
+		}
+		catch (const std::exception& e) {
+			std::cerr << "failed to write mip cache entry " << cachePath.string() << ": " << e.what() << '\n';
+		}
+
+		return chain;
+	}
+
+	std::filesystem::path VaImage::mipCachePath(const std::filesystem::path& source) {
+		std::error_code error;
+		uintmax_t size = std::filesystem::file_size(source, error);
+		auto modified = std::filesystem::last_write_time(source, error).time_since_epoch().count();
+
+		// hash everything that should invalidate the entry
+		std::string key = source.generic_string() + "|" + std::to_string(size) + "|" + std::to_string(modified)
+			+ "|" + std::to_string(MIP_CACHE_VERSION);
+		uint64_t hash = fnv1a(key.data(), key.size());
+
+		char name[32];
+		snprintf(name, sizeof(name), "-%016llx.ktx2", static_cast<unsigned long long>(hash));
+		return std::filesystem::path{ FILE_DIR MIP_CACHE_DIR } / (source.stem().string() + name);
 	}
 
 	void VaImage::createImage(
@@ -100,7 +457,8 @@ namespace va {
 		VkMemoryPropertyFlags properties,
 		VkImage& image,
 		VkDeviceMemory& imageMemory,
-		uint32_t mipLevels
+		uint32_t mipLevels,
+		uint32_t arrayLayers
 	) {
 		VkImageCreateInfo imageInfo{};
 		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -109,8 +467,8 @@ namespace va {
 		imageInfo.extent.height = height;
 		imageInfo.extent.depth = 1;
 		imageInfo.mipLevels = mipLevels;
-		imageInfo.arrayLayers = 1;
-		imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+		imageInfo.arrayLayers = arrayLayers;
+		imageInfo.format = format;
 		imageInfo.tiling = tiling;
 		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		imageInfo.usage = usage;
@@ -125,13 +483,13 @@ namespace va {
 		VkImageViewCreateInfo viewInfo{};
 		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 		viewInfo.image = textureImage;
-		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		viewInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+		viewInfo.viewType = array ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = format;
 		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		viewInfo.subresourceRange.baseMipLevel = 0;
 		viewInfo.subresourceRange.levelCount = mipLevels;
 		viewInfo.subresourceRange.baseArrayLayer = 0;
-		viewInfo.subresourceRange.layerCount = 1;
+		viewInfo.subresourceRange.layerCount = layerCount;
 
 		if (vkCreateImageView(vaDevice.device(), &viewInfo, nullptr, &textureImageView) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create texture image view");
@@ -139,30 +497,12 @@ namespace va {
 	}
 
 	void VaImage::createTextureSampler() {
-		VkSamplerCreateInfo samplerInfo{};
-		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-		//samplerInfo.magFilter = VK_FILTER_LINEAR;
-		//samplerInfo.minFilter = VK_FILTER_LINEAR;
 		// using nearest for pixel-art look
-		samplerInfo.magFilter = VK_FILTER_NEAREST;
-		samplerInfo.minFilter = VK_FILTER_NEAREST;
-		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		samplerInfo.anisotropyEnable = VK_TRUE;
-		samplerInfo.maxAnisotropy = vaDevice.properties.limits.maxSamplerAnisotropy;
-		samplerInfo.borderColor = VK_BORDER_COLOR_INT_TRANSPARENT_BLACK;
-		samplerInfo.unnormalizedCoordinates = VK_FALSE;
-		samplerInfo.compareEnable = VK_FALSE;
-		samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
-		samplerInfo.mipLodBias = 0.0f;
-		samplerInfo.minLod = static_cast<float>(mipLevels / 2);
-		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
-
-		if (vkCreateSampler(vaDevice.device(), &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create texture sampler");
-		}
+		VaSamplerDesc desc = vaDevice.samplerCache().describe(VaSamplerPreset::PixelArt);
+		// minLod is relative to the view, which starts at whatever mip is resident
+		uint32_t finestSampledMip = getFinestSampledMip();
+		desc.minLod = static_cast<float>(finestSampledMip > residentMip ? finestSampledMip - residentMip : 0);
+		textureSampler = vaDevice.samplerCache().getSampler(desc);
 	}
 
 	void VaImage::updateDescriptor() {
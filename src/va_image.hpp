@@ -2,7 +2,9 @@
 
 #include "va_device.hpp"
 #include "va_descriptors.hpp"
+#include "va_ktx.hpp"
 
+#include <filesystem>
 #include <memory>
 #include <vector>
 
@@ -10,6 +12,11 @@ namespace va {
 	class VaImage {
 	public:
 		VaImage(VaDevice& device, const std::string& filepath);
+		// firstMip > 0 leaves the finer mips off the gpu, the texture streamer fills them in later
+		VaImage(VaDevice& device, const VaKtxTexture& texture, uint32_t firstMip = 0);
+		// 2d array texture with a layer per texture, all uploaded together. Every layer needs the same size, format
+		// and mip count
+		VaImage(VaDevice& device, const std::vector<VaKtxTexture>& layers);
 		~VaImage();
 
 		VaImage(const VaImage&) = delete;
@@ -19,20 +26,72 @@ namespace va {
 			return std::make_unique<VaImage>(device, filepath);
 		}
 
+		// decodes/loads every file at once on the device's thread pool, then uploads them one after another
+		static std::vector<std::shared_ptr<VaImage>> createImagesFromFiles(VaDevice& device, const std::vector<std::string>& filepaths);
+
+		// loads every file on the thread pool and stacks them into one texture array, in order
+		static std::shared_ptr<VaImage> createArrayFromFiles(VaDevice& device, const std::vector<std::string>& filepaths);
+
+		// the cpu side of loading an image, safe to call from any thread. Gives back a converted .ktx2 if there's a
+		// usable one, otherwise the full mip chain from the cache or freshly generated from the source image
+		static VaKtxTexture loadTextureData(VaDevice& device, const std::string& filepath);
+
 		VkDescriptorImageInfo getInfo() const { return imageDescriptorInfo; }
 
+		// mip numbers below are all relative to the full chain, not whatever is on the gpu right now
+		uint32_t getFullMipLevels() const { return static_cast<uint32_t>(levelSizes.size()); }
+		uint32_t getResidentMip() const { return residentMip; }
+		// the sampler never reads anything finer than this, so there's no point streaming past it
+		uint32_t getFinestSampledMip() const { return finestSampledMip(getFullMipLevels()); }
+		static uint32_t finestSampledMip(uint32_t fullMipLevels) { return fullMipLevels / 2; }
+		uint32_t getWidth() const { return fullWidth; }
+		uint32_t getLayerCount() const { return layerCount; }
+		// arrays get a 2D_ARRAY view even with a single layer, so they always match a sampler2DArray
+		bool isArray() const { return array; }
+		uint32_t getHeight() const { return fullHeight; }
+		VkDeviceSize getResidentBytes() const { return residentBytesFrom(residentMip); }
+		VkDeviceSize residentBytesFrom(uint32_t mip) const;
+
+		// goes up every time the image, view and sampler get swapped for new ones, so descriptor sets holding
+		// the old handles know they need rewriting
+		uint32_t getGeneration() const { return generation; }
+
+		// swaps in a new image holding mips [mip, end). Mips that are already resident get copied across on the
+		// gpu, anything finer has to come from texture, which must be the same full chain this image was made from.
+		// Texture arrays don't stream. With a command buffer the copies get recorded into it and nothing waits, it has
+		// to be submitted before anything samples the image again. Without one it's a blocking single time submit
+		void setResidentMip(uint32_t mip, const VaKtxTexture* texture = nullptr, VkCommandBuffer commandBuffer = VK_NULL_HANDLE);
+
 	private:
+		// bump to throw away every cached mip chain when the generator changes
+		static constexpr uint32_t MIP_CACHE_VERSION = 1;
+
 		VaDevice& vaDevice;
 		
 		uint32_t mipLevels;
+		VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+
+		uint32_t fullWidth = 0;
+		uint32_t fullHeight = 0;
+		uint32_t layerCount = 1;
+		bool array = false;
+		// per level across all layers
+		std::vector<VkDeviceSize> levelSizes;
+		uint32_t residentMip = 0;
+		uint32_t generation = 0;
 
 		VkImage textureImage;
 		VkDeviceMemory textureImageMemory;
 		VkImageView textureImageView = nullptr;
+		// owned by the device's sampler cache
 		VkSampler textureSampler = nullptr;
 		VkDescriptorImageInfo imageDescriptorInfo;
 
-		void createTextureImage(const std::string& filepath);
+		void createTextureImage(const std::vector<const VaKtxTexture*>& layers, uint32_t firstMip);
+		void destroyHandles();
+		static VaKtxTexture decodeTextureData(VaDevice& device, const std::string& filepath);
+		static bool isKtxUsable(VaDevice& device, const VaKtxTexture& ktx);
+		static std::filesystem::path mipCachePath(const std::filesystem::path& source);
 		void createImage(
 			uint32_t width, 
 			uint32_t height, 
@@ -42,7 +101,8 @@ namespace va {
 			VkMemoryPropertyFlags properties, 
 			VkImage& image, 
 			VkDeviceMemory& imageMemory,
-			uint32_t mipLevels
+			uint32_t mipLevels,
+			uint32_t arrayLayers = 1
 		);
 		void createTextureImageView();
 		void createTextureSampler();
@@ -0,0 +1,329 @@
+#include "va_ktx.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace va {
+	static const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+	static constexpr size_t KTX2_HEADER_SIZE = 80;
+	static constexpr size_t KTX2_LEVEL_INDEX_ENTRY_SIZE = 24;
+
+	// data format descriptor values from the khronos data format spec
+	static constexpr uint8_t KHR_DF_MODEL_RGBSDA = 1;
+	static constexpr uint8_t KHR_DF_MODEL_BC1A = 128;
+	static constexpr uint8_t KHR_DF_MODEL_BC3 = 130;
+	static constexpr uint8_t KHR_DF_MODEL_BC5 = 132;
+	static constexpr uint8_t KHR_DF_MODEL_BC7 = 134;
+	static constexpr uint8_t KHR_DF_PRIMARIES_BT709 = 1;
+	static constexpr uint8_t KHR_DF_TRANSFER_LINEAR = 1;
+	static constexpr uint8_t KHR_DF_TRANSFER_SRGB = 2;
+	static constexpr uint8_t KHR_DF_CHANNEL_ALPHA = 15;
+	static constexpr uint8_t KHR_DF_SAMPLE_DATATYPE_LINEAR = 0x10;
+
+	template<typename T>
+	static T readValue(const std::vector<uint8_t>& bytes, size_t offset) {
+		if (offset + sizeof(T) > bytes.size()) {
+			throw std::runtime_error("ktx2 file is truncated");
+		}
+		T value;
+		memcpy(&value, bytes.data() + offset, sizeof(T));
+		return value;
+	}
+
+	template<typename T>
+	static void appendValue(std::vector<uint8_t>& bytes, T value) {
+		size_t offset = bytes.size();
+		bytes.resize(offset + sizeof(T));
+		memcpy(bytes.data() + offset, &value, sizeof(T));
+	}
+
+	template<typename T>
+	static void writeValue(std::vector<uint8_t>& bytes, size_t offset, T value) {
+		memcpy(bytes.data() + offset, &value, sizeof(T));
+	}
+
+	static void padTo(std::vector<uint8_t>& bytes, size_t alignment) {
+		bytes.resize((bytes.size() + alignment - 1) / alignment * alignment, 0);
+	}
+
+	static bool isSrgb(VkFormat format) {
+		switch (format) {
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	static std::vector<uint8_t> buildDataFormatDescriptor(VkFormat format) {
+		struct Sample {
+			uint16_t bitOffset;
+			uint8_t bitLength;
+			uint8_t channelType;
+			uint32_t upper;
+		};
+
+		uint8_t colorModel;
+		std::vector<Sample> samples;
+		bool srgb = isSrgb(format);
+		uint8_t alphaChannel = KHR_DF_CHANNEL_ALPHA | (srgb ? KHR_DF_SAMPLE_DATATYPE_LINEAR : 0);
+
+		switch (format) {
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			colorModel = KHR_DF_MODEL_BC1A;
+			samples = { { 0, 63, 0, 0xFFFFFFFF } };
+			break;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+			colorModel = KHR_DF_MODEL_BC3;
+			samples = { { 0, 63, alphaChannel, 0xFFFFFFFF }, { 64, 63, 0, 0xFFFFFFFF } };
+			break;
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+			colorModel = KHR_DF_MODEL_BC5;
+			samples = { { 0, 63, 0, 0xFFFFFFFF }, { 64, 63, 1, 0xFFFFFFFF } };
+			break;
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			colorModel = KHR_DF_MODEL_BC7;
+			samples = { { 0, 127, 0, 0xFFFFFFFF } };
+			break;
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			colorModel = KHR_DF_MODEL_RGBSDA;
+			samples = { { 0, 7, 0, 255 }, { 8, 7, 1, 255 }, { 16, 7, 2, 255 }, { 24, 7, alphaChannel, 255 } };
+			break;
+		default:
+			throw std::runtime_error("no ktx2 data format descriptor for this format");
+		}
+
+		bool blockCompressed = VaKtxTexture::isBlockCompressed(format);
+		uint16_t blockSize = static_cast<uint16_t>(24 + 16 * samples.size());
+
+		std::vector<uint8_t> dfd;
+		appendValue<uint32_t>(dfd, 4u + blockSize);
+		appendValue<uint32_t>(dfd, 0); // vendor id khronos, descriptor type basic
+		appendValue<uint16_t>(dfd, 2); // version
+		appendValue<uint16_t>(dfd, blockSize);
+		appendValue<uint8_t>(dfd, colorModel);
+		appendValue<uint8_t>(dfd, KHR_DF_PRIMARIES_BT709);
+		appendValue<uint8_t>(dfd, srgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR);
+		appendValue<uint8_t>(dfd, 0); // straight alpha
+		for (int i = 0; i < 4; i++) {
+			// texel block dimensions are stored minus one
+			appendValue<uint8_t>(dfd, (blockCompressed && i < 2) ? 3 : 0);
+		}
+		for (int i = 0; i < 8; i++) {
+			appendValue<uint8_t>(dfd, i == 0 ? static_cast<uint8_t>(VaKtxTexture::formatBlockBytes(format)) : 0);
+		}
+		for (const auto& sample : samples) {
+			appendValue<uint16_t>(dfd, sample.bitOffset);
+			appendValue<uint8_t>(dfd, sample.bitLength);
+			appendValue<uint8_t>(dfd, sample.channelType);
+			appendValue<uint32_t>(dfd, 0); // sample position
+			appendValue<uint32_t>(dfd, 0);
+			appendValue<uint32_t>(dfd, sample.upper);
+		}
+		return dfd;
+	}
+
+	static void appendKeyValue(std::vector<uint8_t>& kvd, const std::string& key, const std::string& value) {
+		uint32_t length = static_cast<uint32_t>(key.size() + 1 + value.size() + 1);
+		appendValue<uint32_t>(kvd, length);
+		kvd.insert(kvd.end(), key.begin(), key.end());
+		kvd.push_back(0);
+		kvd.insert(kvd.end(), value.begin(), value.end());
+		kvd.push_back(0);
+		padTo(kvd, 4);
+	}
+
+	VaKtxTexture VaKtxTexture::loadFromFile(const std::string& filepath) {
+		std::ifstream file{ filepath, std::ios::ate | std::ios::binary };
+		if (!file.is_open()) {
+			throw std::runtime_error("failed to open ktx2 file: " + filepath);
+		}
+
+		VaKtxTexture texture{};
+		size_t fileSize = static_cast<size_t>(file.tellg());
+		texture.data.resize(fileSize);
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(texture.data.data()), fileSize);
+		file.close();
+
+		if (fileSize < KTX2_HEADER_SIZE || memcmp(texture.data.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+			throw std::runtime_error("not a ktx2 file: " + filepath);
+		}
+
+		texture.format = static_cast<VkFormat>(readValue<uint32_t>(texture.data, 12));
+		texture.width = readValue<uint32_t>(texture.data, 20);
+		texture.height = std::max(readValue<uint32_t>(texture.data, 24), 1u);
+		uint32_t depth = readValue<uint32_t>(texture.data, 28);
+		texture.layerCount = std::max(readValue<uint32_t>(texture.data, 32), 1u);
+		texture.faceCount = readValue<uint32_t>(texture.data, 36);
+		texture.levelCount = std::max(readValue<uint32_t>(texture.data, 40), 1u);
+		uint32_t supercompression = readValue<uint32_t>(texture.data, 44);
+
+		if (texture.format == VK_FORMAT_UNDEFINED) {
+			throw std::runtime_error("basis/undefined format ktx2 files aren't supported: " + filepath);
+		}
+		if (supercompression != 0) {
+			throw std::runtime_error("supercompressed ktx2 files aren't supported: " + filepath);
+		}
+		if (depth > 1 || (texture.faceCount != 1 && texture.faceCount != 6)) {
+			throw std::runtime_error("only 2d and cubemap ktx2 files are supported: " + filepath);
+		}
+
+		uint32_t kvdOffset = readValue<uint32_t>(texture.data, 56);
+		uint32_t kvdLength = readValue<uint32_t>(texture.data, 60);
+		if (static_cast<size_t>(kvdOffset) + kvdLength > fileSize) {
+			throw std::runtime_error("ktx2 key/value data out of range: " + filepath);
+		}
+		for (size_t entry = kvdOffset; entry + 4 <= static_cast<size_t>(kvdOffset) + kvdLength;) {
+			uint32_t length = readValue<uint32_t>(texture.data, entry);
+			size_t start = entry + 4;
+			if (start + length > static_cast<size_t>(kvdOffset) + kvdLength) {
+				break;
+			}
+			const char* pair = reinterpret_cast<const char*>(texture.data.data() + start);
+			// the key is null terminated and the value runs to the end of the entry, minus its own null
+			size_t keyLength = strnlen(pair, length);
+			if (keyLength < length && std::string(pair, keyLength) == "KTXorientation") {
+				std::string value(pair + keyLength + 1, length - keyLength - 1);
+				texture.orientation = value.substr(0, value.find('\0'));
+			}
+			entry = (start + length + 3) / 4 * 4;
+		}
+
+		texture.levels.resize(texture.levelCount);
+		for (uint32_t i = 0; i < texture.levelCount; i++) {
+			size_t entry = KTX2_HEADER_SIZE + i * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+			texture.levels[i].offset = static_cast<size_t>(readValue<uint64_t>(texture.data, entry));
+			texture.levels[i].size = static_cast<size_t>(readValue<uint64_t>(texture.data, entry + 8));
+			if (texture.levels[i].offset + texture.levels[i].size > fileSize) {
+				throw std::runtime_error("ktx2 level data out of range: " + filepath);
+			}
+		}
+
+		return texture;
+	}
+
+	void VaKtxTexture::flipVertically() {
+		if (isBlockCompressed(format)) {
+			throw std::runtime_error("can't flip a block compressed ktx2 texture, it needs to be written bottom to top (KTXorientation ru)");
+		}
+
+		std::vector<uint8_t> row;
+		for (uint32_t level = 0; level < levelCount; level++) {
+			uint32_t rows = std::max(height >> level, 1u);
+			size_t size = faceSize(level);
+			size_t rowBytes = size / rows;
+			row.resize(rowBytes);
+			for (uint32_t image = 0; image < layerCount * faceCount; image++) {
+				uint8_t* face = data.data() + levels[level].offset + image * size;
+				for (uint32_t y = 0; y < rows / 2; y++) {
+					uint8_t* top = face + y * rowBytes;
+					uint8_t* bottom = face + (rows - 1 - y) * rowBytes;
+					memcpy(row.data(), top, rowBytes);
+					memcpy(top, bottom, rowBytes);
+					memcpy(bottom, row.data(), rowBytes);
+				}
+			}
+		}
+		orientation = "ru";
+	}
+
+	void VaKtxTexture::writeToFile(const std::string& filepath) const {
+		std::vector<uint8_t> dfd = buildDataFormatDescriptor(format);
+		std::vector<uint8_t> kvd;
+		// images come out of stb flipped, the same way VaImage loads pngs, so rows run bottom to top
+		appendKeyValue(kvd, "KTXorientation", "ru");
+		appendKeyValue(kvd, "KTXwriter", "vulkan_antics ktx_converter");
+
+		std::vector<uint8_t> bytes(KTX2_HEADER_SIZE + levelCount * KTX2_LEVEL_INDEX_ENTRY_SIZE, 0);
+		memcpy(bytes.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+		writeValue<uint32_t>(bytes, 12, static_cast<uint32_t>(format));
+		writeValue<uint32_t>(bytes, 16, 1); // type size, 1 for block compressed and 8 bit formats
+		writeValue<uint32_t>(bytes, 20, width);
+		writeValue<uint32_t>(bytes, 24, height);
+		writeValue<uint32_t>(bytes, 28, 0);
+		writeValue<uint32_t>(bytes, 32, layerCount > 1 ? layerCount : 0);
+		writeValue<uint32_t>(bytes, 36, faceCount);
+		writeValue<uint32_t>(bytes, 40, levelCount);
+		writeValue<uint32_t>(bytes, 44, 0);
+
+		size_t dfdOffset = bytes.size();
+		bytes.insert(bytes.end(), dfd.begin(), dfd.end());
+		size_t kvdOffset = bytes.size();
+		bytes.insert(bytes.end(), kvd.begin(), kvd.end());
+
+		writeValue<uint32_t>(bytes, 48, static_cast<uint32_t>(dfdOffset));
+		writeValue<uint32_t>(bytes, 52, static_cast<uint32_t>(dfd.size()));
+		writeValue<uint32_t>(bytes, 56, static_cast<uint32_t>(kvdOffset));
+		writeValue<uint32_t>(bytes, 60, static_cast<uint32_t>(kvd.size()));
+		writeValue<uint64_t>(bytes, 64, 0);
+		writeValue<uint64_t>(bytes, 72, 0);
+
+		// levels are aligned to lcm(block size, 4), and the spec wants the smallest mip first in the file
+		size_t alignment = formatBlockBytes(format) % 4 == 0 ? formatBlockBytes(format) : 4;
+		for (int i = static_cast<int>(levelCount) - 1; i >= 0; i--) {
+			padTo(bytes, alignment);
+			const VaKtxLevel& level = levels[i];
+			size_t entry = KTX2_HEADER_SIZE + i * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+			writeValue<uint64_t>(bytes, entry, bytes.size());
+			writeValue<uint64_t>(bytes, entry + 8, level.size);
+			writeValue<uint64_t>(bytes, entry + 16, level.size);
+			bytes.insert(bytes.end(), data.begin() + level.offset, data.begin() + level.offset + level.size);
+		}
+
+		std::ofstream file{ filepath, std::ios::binary | std::ios::trunc };
+		if (!file.is_open()) {
+			throw std::runtime_error("failed to open ktx2 file for writing: " + filepath);
+		}
+		file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	}
+
+	bool VaKtxTexture::isBlockCompressed(VkFormat format) {
+		return format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+	}
+
+	uint32_t VaKtxTexture::formatBlockBytes(VkFormat format) {
+		switch (format) {
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+		case VK_FORMAT_BC4_SNORM_BLOCK:
+			return 8;
+		case VK_FORMAT_BC2_UNORM_BLOCK:
+		case VK_FORMAT_BC2_SRGB_BLOCK:
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC5_SNORM_BLOCK:
+		case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+		case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			return 16;
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			return 4;
+		default:
+			return 0;
+		}
+	}
+
+	size_t VaKtxTexture::levelSize(VkFormat format, uint32_t width, uint32_t height) {
+		size_t blockBytes = formatBlockBytes(format);
+		if (isBlockCompressed(format)) {
+			return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+		}
+		return static_cast<size_t>(width) * height * blockBytes;
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace va {
+	struct VaKtxLevel {
+		// byte offset into VaKtxTexture::data
+		size_t offset = 0;
+		size_t size = 0;
+	};
+
+	// Bare bones KTX2 container, enough for the textures our converter writes: any vkFormat, all mips stored,
+	// no supercompression. Level 0 is the full size image, and each level holds its layers then faces back to back.
+	struct VaKtxTexture {
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t layerCount = 1;
+		uint32_t faceCount = 1;
+		uint32_t levelCount = 1;
+		std::vector<VaKtxLevel> levels;
+		std::vector<uint8_t> data;
+		// KTXorientation as stored in the file, empty when it doesn't have one
+		std::string orientation;
+
+		// when loaded this is the whole file, so the level offsets are file offsets and already suitably aligned
+		// for vkCmdCopyBufferToImage
+		static VaKtxTexture loadFromFile(const std::string& filepath);
+		void writeToFile(const std::string& filepath) const;
+
+		size_t faceSize(uint32_t level) const { return levels[level].size / (layerCount * faceCount); }
+
+		// rows run top to bottom ("rd", also what most tools assume when the key is missing). Our own decodes come
+		// out of stb flipped, bottom to top, so these need flipVertically() before they line up with a png
+		bool isTopDown() const { return orientation.size() < 2 || orientation[1] == 'd'; }
+		// reverses the rows of every level, layer and face in place. Throws for block compressed formats, flipping
+		// those means rewriting the indices inside every block
+		void flipVertically();
+
+		static bool isBlockCompressed(VkFormat format);
+		// bytes per 4x4 block for BCn, bytes per texel for everything else we know about, 0 if unknown
+		static uint32_t formatBlockBytes(VkFormat format);
+		static size_t levelSize(VkFormat format, uint32_t width, uint32_t height);
+	};
+}
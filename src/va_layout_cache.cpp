@@ -0,0 +1,118 @@
+#include "va_layout_cache.hpp"
+#include "va_descriptors.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <tuple>
+
+namespace va {
+	bool VaLayoutCache::PipelineLayoutKey::operator<(const PipelineLayoutKey& other) const {
+		if (setLayouts != other.setLayouts) {
+			return setLayouts < other.setLayouts;
+		}
+		return std::lexicographical_compare(
+			pushConstantRanges.begin(), pushConstantRanges.end(),
+			other.pushConstantRanges.begin(), other.pushConstantRanges.end(),
+			[](const VkPushConstantRange& a, const VkPushConstantRange& b) {
+				return std::tie(a.stageFlags, a.offset, a.size) < std::tie(b.stageFlags, b.offset, b.size);
+			});
+	}
+
+	VaLayoutCache::VaLayoutCache(VaDevice& device) : vaDevice{ device } {}
+
+	VaLayoutCache::~VaLayoutCache() {
+		clear();
+	}
+
+	std::shared_ptr<VaDescriptorSetLayout> VaLayoutCache::getSetLayout(
+		const std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding>& bindings,
+		VkDescriptorSetLayoutCreateFlags flags) {
+		std::vector<const VkDescriptorSetLayoutBinding*> sorted;
+		for (const auto& [index, binding] : bindings) {
+			sorted.push_back(&binding);
+		}
+		std::sort(sorted.begin(), sorted.end(), [](const VkDescriptorSetLayoutBinding* a, const VkDescriptorSetLayoutBinding* b) {
+			return a->binding < b->binding;
+		});
+
+		std::vector<uint64_t> key{ static_cast<uint64_t>(flags) };
+		for (const auto* binding : sorted) {
+			key.push_back((static_cast<uint64_t>(binding->binding) << 32) | static_cast<uint64_t>(binding->descriptorType));
+			key.push_back((static_cast<uint64_t>(binding->descriptorCount) << 32) | static_cast<uint64_t>(binding->stageFlags));
+		}
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		auto& layout = setLayouts[key];
+		if (layout == nullptr) {
+			layout = std::make_shared<VaDescriptorSetLayout>(vaDevice, bindings, std::unordered_map<uint32_t, VkDescriptorBindingFlags>{}, flags);
+		}
+		return layout;
+	}
+
+	VkPipelineLayout VaLayoutCache::getPipelineLayout(
+		const std::vector<VkDescriptorSetLayout>& setLayouts,
+		const std::vector<VkPushConstantRange>& pushConstantRanges) {
+		PipelineLayoutKey key{ setLayouts, pushConstantRanges };
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		auto cached = pipelineLayouts.find(key);
+		if (cached != pipelineLayouts.end()) {
+			return cached->second;
+		}
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+		pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+		pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+		pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+
+		VkPipelineLayout pipelineLayout;
+		if (vkCreatePipelineLayout(vaDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline layout");
+		}
+		vaDevice.pipelineStates().describePipelineLayout(pipelineLayout, pipelineLayoutInfo);
+
+		pipelineLayouts.emplace(key, pipelineLayout);
+		pipelineLayoutKeys.emplace(pipelineLayout, std::move(key));
+		return pipelineLayout;
+	}
+
+	bool VaLayoutCache::compatibleUpTo(VkPipelineLayout bound, VkPipelineLayout next, uint32_t set) {
+		if (bound == next) {
+			return bound != VK_NULL_HANDLE;
+		}
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		auto boundKey = pipelineLayoutKeys.find(bound);
+		auto nextKey = pipelineLayoutKeys.find(next);
+		if (boundKey == pipelineLayoutKeys.end() || nextKey == pipelineLayoutKeys.end()) {
+			return false;
+		}
+		const PipelineLayoutKey& a = boundKey->second;
+		const PipelineLayoutKey& b = nextKey->second;
+		if (a.setLayouts.size() <= set || b.setLayouts.size() <= set) {
+			return false;
+		}
+		if (!std::equal(a.setLayouts.begin(), a.setLayouts.begin() + set + 1, b.setLayouts.begin())) {
+			return false;
+		}
+		return std::equal(
+			a.pushConstantRanges.begin(), a.pushConstantRanges.end(),
+			b.pushConstantRanges.begin(), b.pushConstantRanges.end(),
+			[](const VkPushConstantRange& x, const VkPushConstantRange& y) {
+				return x.stageFlags == y.stageFlags && x.offset == y.offset && x.size == y.size;
+			});
+	}
+
+	void VaLayoutCache::clear() {
+		std::lock_guard<std::mutex> lock{ mutex };
+		for (auto& [key, pipelineLayout] : pipelineLayouts) {
+			vaDevice.pipelineStates().forget((uint64_t)(pipelineLayout));
+			vkDestroyPipelineLayout(vaDevice.device(), pipelineLayout, nullptr);
+		}
+		pipelineLayouts.clear();
+		pipelineLayoutKeys.clear();
+		setLayouts.clear();
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace va {
+	class VaDevice;
+	class VaDescriptorSetLayout;
+
+	// Shares descriptor set layouts and pipeline layouts between everything that asks for the same thing, so
+	// pipelines built from shaders that declare the same interface end up with the very same layouts. That's what
+	// lets a set stay bound across a pipeline switch, see compatibleUpTo().
+	//
+	// Everything handed out lives until the device goes away, nothing else should destroy the pipeline layouts.
+	class VaLayoutCache {
+	public:
+		explicit VaLayoutCache(VaDevice& device);
+		~VaLayoutCache();
+
+		VaLayoutCache(const VaLayoutCache&) = delete;
+		VaLayoutCache& operator=(const VaLayoutCache&) = delete;
+
+		// the same layout every time exactly these bindings and flags are asked for
+		std::shared_ptr<VaDescriptorSetLayout> getSetLayout(
+			const std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding>& bindings,
+			VkDescriptorSetLayoutCreateFlags flags = 0);
+		// the same layout every time the same set layouts and push constant ranges are asked for
+		VkPipelineLayout getPipelineLayout(
+			const std::vector<VkDescriptorSetLayout>& setLayouts,
+			const std::vector<VkPushConstantRange>& pushConstantRanges);
+
+		// whether sets 0 to `set` bound through `bound` are still usable with a pipeline made with `next`. Vulkan
+		// needs the same push constant ranges and the same set layouts up to that set for it. Layouts that didn't
+		// come from here are never compatible with anything
+		bool compatibleUpTo(VkPipelineLayout bound, VkPipelineLayout next, uint32_t set);
+
+		// only safe once nothing using the layouts can still be in flight
+		void clear();
+
+	private:
+		struct PipelineLayoutKey {
+			std::vector<VkDescriptorSetLayout> setLayouts;
+			std::vector<VkPushConstantRange> pushConstantRanges;
+
+			bool operator<(const PipelineLayoutKey& other) const;
+		};
+
+		VaDevice& vaDevice;
+		std::mutex mutex;
+		// (binding, type, count, stages) for every binding plus the flags, same idea as the update template keys
+		std::map<std::vector<uint64_t>, std::shared_ptr<VaDescriptorSetLayout>> setLayouts;
+		std::map<PipelineLayoutKey, VkPipelineLayout> pipelineLayouts;
+		std::unordered_map<VkPipelineLayout, PipelineLayoutKey> pipelineLayoutKeys;
+	};
+}
@@ -0,0 +1,153 @@
+#include "va_memory_stats.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace va {
+	static double toMiB(VkDeviceSize bytes) {
+		return static_cast<double>(bytes) / (1024.0 * 1024.0);
+	}
+
+	void VaMemoryTracker::init(VkPhysicalDevice device, bool budget) {
+		physicalDevice = device;
+		budgetSupported = budget;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		stats.memoryTypes.assign(memProperties.memoryTypeCount, {});
+		stats.heaps.assign(memProperties.memoryHeapCount, {});
+		for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++) {
+			stats.heaps[i].size = memProperties.memoryHeaps[i].size;
+			stats.heaps[i].flags = memProperties.memoryHeaps[i].flags;
+		}
+		stats.hasBudget = budgetSupported;
+	}
+
+	void VaMemoryTracker::recordAllocation(
+		VkDeviceMemory memory,
+		VkDeviceSize size,
+		uint32_t memoryTypeIndex,
+		VaMemoryCategory category
+	) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		allocations[memory] = { size, memoryTypeIndex, category };
+
+		uint32_t heapIndex = memProperties.memoryTypes[memoryTypeIndex].heapIndex;
+		for (auto* usage : {
+			&stats.categories[static_cast<size_t>(category)],
+			&stats.memoryTypes[memoryTypeIndex],
+			&stats.heaps[heapIndex].allocated,
+			&stats.total }) {
+			usage->bytes += size;
+			usage->allocations++;
+		}
+		stats.peakBytes = std::max(stats.peakBytes, stats.total.bytes);
+	}
+
+	void VaMemoryTracker::recordFree(VkDeviceMemory memory) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		auto it = allocations.find(memory);
+		if (it == allocations.end()) {
+			return;
+		}
+
+		const Allocation& allocation = it->second;
+		uint32_t heapIndex = memProperties.memoryTypes[allocation.memoryTypeIndex].heapIndex;
+		for (auto* usage : {
+			&stats.categories[static_cast<size_t>(allocation.category)],
+			&stats.memoryTypes[allocation.memoryTypeIndex],
+			&stats.heaps[heapIndex].allocated,
+			&stats.total }) {
+			usage->bytes -= allocation.size;
+			usage->allocations--;
+		}
+		allocations.erase(it);
+	}
+
+	VaMemoryStats VaMemoryTracker::getStats() {
+		VaMemoryStats result;
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			result = stats;
+		}
+
+		if (budgetSupported) {
+			VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+			budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+			VkPhysicalDeviceMemoryProperties2 memProperties2{};
+			memProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+			memProperties2.pNext = &budgetProperties;
+			vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memProperties2);
+
+			for (size_t i = 0; i < result.heaps.size(); i++) {
+				result.heaps[i].budget = budgetProperties.heapBudget[i];
+				result.heaps[i].usage = budgetProperties.heapUsage[i];
+			}
+		}
+
+		return result;
+	}
+
+	std::string VaMemoryTracker::summary() {
+		VaMemoryStats current = getStats();
+		char buffer[256];
+		std::string line;
+
+		snprintf(buffer, sizeof(buffer), "gpu memory: %.1f MiB in %u allocations (peak %.1f MiB)",
+			toMiB(current.total.bytes), current.total.allocations, toMiB(current.peakBytes));
+		line += buffer;
+
+		for (size_t i = 0; i < current.categories.size(); i++) {
+			snprintf(buffer, sizeof(buffer), " | %s %.1f",
+				categoryName(static_cast<VaMemoryCategory>(i)), toMiB(current.categories[i].bytes));
+			line += buffer;
+		}
+
+		for (size_t i = 0; i < current.heaps.size(); i++) {
+			const auto& heap = current.heaps[i];
+			if (current.hasBudget) {
+				snprintf(buffer, sizeof(buffer), " | heap%zu %.1f/%.1f MiB (process usage %.1f, budget %.1f)",
+					i, toMiB(heap.allocated.bytes), toMiB(heap.size), toMiB(heap.usage), toMiB(heap.budget));
+			}
+			else {
+				snprintf(buffer, sizeof(buffer), " | heap%zu %.1f/%.1f MiB",
+					i, toMiB(heap.allocated.bytes), toMiB(heap.size));
+			}
+			line += buffer;
+		}
+
+		return line;
+	}
+
+	const char* VaMemoryTracker::categoryName(VaMemoryCategory category) {
+		switch (category) {
+		case VaMemoryCategory::Geometry: return "geometry";
+		case VaMemoryCategory::Texture: return "textures";
+		case VaMemoryCategory::Staging: return "staging";
+		case VaMemoryCategory::Attachment: return "attachments";
+		case VaMemoryCategory::Uniform: return "uniform";
+		default: return "other";
+		}
+	}
+
+	VaMemoryCategory VaMemoryTracker::categorizeBuffer(VkBufferUsageFlags usage) {
+		if (usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT)) {
+			return VaMemoryCategory::Geometry;
+		}
+		if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) {
+			return VaMemoryCategory::Uniform;
+		}
+		if (usage == VK_BUFFER_USAGE_TRANSFER_SRC_BIT) {
+			return VaMemoryCategory::Staging;
+		}
+		return VaMemoryCategory::Other;
+	}
+
+	VaMemoryCategory VaMemoryTracker::categorizeImage(VkImageUsageFlags usage) {
+		if (usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) {
+			return VaMemoryCategory::Attachment;
+		}
+		return VaMemoryCategory::Texture;
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace va {
+	enum class VaMemoryCategory {
+		Geometry,
+		Texture,
+		Staging,
+		Attachment,
+		Uniform,
+		Other,
+		Count
+	};
+
+	struct VaMemoryStats {
+		struct Usage {
+			VkDeviceSize bytes = 0;
+			uint32_t allocations = 0;
+		};
+
+		struct Heap {
+			VkDeviceSize size = 0;
+			VkMemoryHeapFlags flags = 0;
+			Usage allocated{};
+			// straight from VK_EXT_memory_budget, these include everything else using the heap, left at 0 without it
+			VkDeviceSize budget = 0;
+			VkDeviceSize usage = 0;
+		};
+
+		std::array<Usage, static_cast<size_t>(VaMemoryCategory::Count)> categories{};
+		std::vector<Usage> memoryTypes;
+		std::vector<Heap> heaps;
+		Usage total{};
+		VkDeviceSize peakBytes = 0;
+		bool hasBudget = false;
+	};
+
+	// Keeps count of every VkDeviceMemory the device hands out, so we know what's resident and can spot leaks
+	class VaMemoryTracker {
+	public:
+		VaMemoryTracker() = default;
+
+		VaMemoryTracker(const VaMemoryTracker&) = delete;
+		VaMemoryTracker& operator=(const VaMemoryTracker&) = delete;
+
+		void init(VkPhysicalDevice physicalDevice, bool budgetSupported);
+
+		void recordAllocation(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, VaMemoryCategory category);
+		void recordFree(VkDeviceMemory memory);
+
+		VaMemoryStats getStats();
+		std::string summary();
+
+		static const char* categoryName(VaMemoryCategory category);
+		static VaMemoryCategory categorizeBuffer(VkBufferUsageFlags usage);
+		static VaMemoryCategory categorizeImage(VkImageUsageFlags usage);
+
+	private:
+		struct Allocation {
+			VkDeviceSize size;
+			uint32_t memoryTypeIndex;
+			VaMemoryCategory category;
+		};
+
+		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties memProperties{};
+		bool budgetSupported = false;
+
+		std::mutex mutex;
+		std::unordered_map<VkDeviceMemory, Allocation> allocations;
+		VaMemoryStats stats{};
+	};
+}
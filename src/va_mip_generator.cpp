@@ -0,0 +1,134 @@
+#include "va_mip_generator.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define VA_MIP_SSE2
+#endif
+
+namespace va {
+	// 12 bits of linear precision going back to srgb is plenty to round trip every 8 bit value
+	static constexpr int LINEAR_TO_SRGB_SIZE = 4096;
+
+	struct ConversionTables {
+		std::array<float, 256> srgbToLinear;
+		std::array<float, 256> unormToFloat;
+		std::array<uint8_t, LINEAR_TO_SRGB_SIZE> linearToSrgb;
+
+		ConversionTables() {
+			for (int i = 0; i < 256; i++) {
+				float c = i / 255.0f;
+				srgbToLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+				unormToFloat[i] = c;
+			}
+			for (int i = 0; i < LINEAR_TO_SRGB_SIZE; i++) {
+				float c = i / static_cast<float>(LINEAR_TO_SRGB_SIZE - 1);
+				float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+				linearToSrgb[i] = static_cast<uint8_t>(std::clamp(s, 0.0f, 1.0f) * 255.0f + 0.5f);
+			}
+		}
+	};
+
+	static const ConversionTables& conversionTables() {
+		static const ConversionTables tables{};
+		return tables;
+	}
+
+	uint32_t VaMipGenerator::mipLevelCount(uint32_t width, uint32_t height) {
+		return static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+	}
+
+	VaKtxTexture VaMipGenerator::generate(const uint8_t* pixels, uint32_t width, uint32_t height, bool srgb, VaThreadPool& threadPool) {
+		VaKtxTexture chain{};
+		chain.format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+		chain.width = width;
+		chain.height = height;
+		chain.levelCount = mipLevelCount(width, height);
+
+		size_t totalSize = 0;
+		chain.levels.resize(chain.levelCount);
+		for (uint32_t i = 0; i < chain.levelCount; i++) {
+			chain.levels[i].offset = totalSize;
+			chain.levels[i].size = VaKtxTexture::levelSize(chain.format, std::max(width >> i, 1u), std::max(height >> i, 1u));
+			totalSize += chain.levels[i].size;
+		}
+		chain.data.resize(totalSize);
+		memcpy(chain.data.data(), pixels, chain.levels[0].size);
+
+		// build the tables before the workers race to do it
+		conversionTables();
+
+		for (uint32_t i = 1; i < chain.levelCount; i++) {
+			const uint8_t* src = chain.data.data() + chain.levels[i - 1].offset;
+			uint8_t* dst = chain.data.data() + chain.levels[i].offset;
+			uint32_t srcWidth = std::max(width >> (i - 1), 1u);
+			uint32_t srcHeight = std::max(height >> (i - 1), 1u);
+			uint32_t dstWidth = std::max(width >> i, 1u);
+			uint32_t dstHeight = std::max(height >> i, 1u);
+
+			threadPool.parallelFor(0, dstHeight, [=](uint32_t rowBegin, uint32_t rowEnd) {
+				downsampleRows(src, srcWidth, srcHeight, dst, dstWidth, rowBegin, rowEnd, srgb);
+			});
+		}
+
+		return chain;
+	}
+
+	void VaMipGenerator::downsampleRows(
+		const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight,
+		uint8_t* dst, uint32_t dstWidth,
+		uint32_t rowBegin, uint32_t rowEnd,
+		bool srgb
+	) {
+		const ConversionTables& tables = conversionTables();
+		const float* colorTable = srgb ? tables.srgbToLinear.data() : tables.unormToFloat.data();
+		const float* alphaTable = tables.unormToFloat.data();
+
+		for (uint32_t y = rowBegin; y < rowEnd; y++) {
+			// odd sizes just clamp, the last row/column gets counted twice
+			const uint8_t* row0 = src + static_cast<size_t>(std::min(y * 2, srcHeight - 1)) * srcWidth * 4;
+			const uint8_t* row1 = src + static_cast<size_t>(std::min(y * 2 + 1, srcHeight - 1)) * srcWidth * 4;
+			uint8_t* out = dst + static_cast<size_t>(y) * dstWidth * 4;
+
+			for (uint32_t x = 0; x < dstWidth; x++) {
+				uint32_t x0 = std::min(x * 2, srcWidth - 1) * 4;
+				uint32_t x1 = std::min(x * 2 + 1, srcWidth - 1) * 4;
+				const uint8_t* texels[4] = { row0 + x0, row0 + x1, row1 + x0, row1 + x1 };
+
+#ifdef VA_MIP_SSE2
+				__m128 sum = _mm_setzero_ps();
+				for (const uint8_t* t : texels) {
+					sum = _mm_add_ps(sum, _mm_set_ps(alphaTable[t[3]], colorTable[t[2]], colorTable[t[1]], colorTable[t[0]]));
+				}
+				__m128 average = _mm_mul_ps(sum, _mm_set1_ps(0.25f));
+
+				const float colorScale = srgb ? static_cast<float>(LINEAR_TO_SRGB_SIZE - 1) : 255.0f;
+				__m128 scaled = _mm_add_ps(_mm_mul_ps(average, _mm_set_ps(255.0f, colorScale, colorScale, colorScale)), _mm_set1_ps(0.5f));
+				alignas(16) int32_t values[4];
+				_mm_store_si128(reinterpret_cast<__m128i*>(values), _mm_cvttps_epi32(scaled));
+#else
+				float average[4] = {};
+				for (const uint8_t* t : texels) {
+					for (int c = 0; c < 3; c++) average[c] += colorTable[t[c]];
+					average[3] += alphaTable[t[3]];
+				}
+				const float colorScale = srgb ? static_cast<float>(LINEAR_TO_SRGB_SIZE - 1) : 255.0f;
+				int32_t values[4];
+				for (int c = 0; c < 4; c++) {
+					values[c] = static_cast<int32_t>(average[c] * 0.25f * (c < 3 ? colorScale : 255.0f) + 0.5f);
+				}
+#endif
+				for (int c = 0; c < 3; c++) {
+					out[x * 4 + c] = srgb
+						? tables.linearToSrgb[std::clamp(values[c], 0, LINEAR_TO_SRGB_SIZE - 1)]
+						: static_cast<uint8_t>(std::clamp(values[c], 0, 255));
+				}
+				out[x * 4 + 3] = static_cast<uint8_t>(std::clamp(values[3], 0, 255));
+			}
+		}
+	}
+}
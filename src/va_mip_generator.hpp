@@ -0,0 +1,26 @@
+#pragma once
+
+#include "va_ktx.hpp"
+#include "va_thread_pool.hpp"
+
+#include <cstdint>
+
+namespace va {
+	// Builds a full RGBA8 mip chain on the cpu with a 2x2 box filter. Srgb data is filtered in linear space. Rows
+	// of each level are split across the thread pool, and the result is a VaKtxTexture so it can go straight to
+	// disk or into a single buffer to image copy.
+	class VaMipGenerator {
+	public:
+		static VaKtxTexture generate(const uint8_t* pixels, uint32_t width, uint32_t height, bool srgb, VaThreadPool& threadPool);
+
+		static uint32_t mipLevelCount(uint32_t width, uint32_t height);
+
+	private:
+		static void downsampleRows(
+			const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight,
+			uint8_t* dst, uint32_t dstWidth,
+			uint32_t rowBegin, uint32_t rowEnd,
+			bool srgb
+		);
+	};
+}
@@ -6,26 +6,109 @@
 #include <stdexcept>
 #include <iostream>
 #include <cassert>
+#include <chrono>
+#include <cstring>
 
 #ifndef FILE_DIR
 #define FILE_DIR "../../../"
 #endif
 
 namespace va {
+	VaSpecialization& VaSpecialization::set(uint32_t constantId, uint32_t value) {
+		return setBytes(constantId, &value, sizeof(value));
+	}
+
+	VaSpecialization& VaSpecialization::set(uint32_t constantId, int32_t value) {
+		return setBytes(constantId, &value, sizeof(value));
+	}
+
+	VaSpecialization& VaSpecialization::set(uint32_t constantId, float value) {
+		return setBytes(constantId, &value, sizeof(value));
+	}
+
+	VaSpecialization& VaSpecialization::setBytes(uint32_t constantId, const void* value, size_t size) {
+		for (auto& entry : entries) {
+			if (entry.constantID == constantId) {
+				assert(entry.size == size && "Specialization constant set again with a different size");
+				memcpy(data.data() + entry.offset, value, size);
+				return *this;
+			}
+		}
+
+		VkSpecializationMapEntry entry{};
+		entry.constantID = constantId;
+		entry.offset = static_cast<uint32_t>(data.size());
+		entry.size = size;
+		entries.push_back(entry);
+		data.resize(data.size() + size);
+		memcpy(data.data() + entry.offset, value, size);
+		return *this;
+	}
+
+	VkSpecializationInfo VaSpecialization::getInfo() const {
+		VkSpecializationInfo info{};
+		info.mapEntryCount = static_cast<uint32_t>(entries.size());
+		info.pMapEntries = entries.data();
+		info.dataSize = data.size();
+		info.pData = data.data();
+		return info;
+	}
+
+	OwnedPipelineConfig::OwnedPipelineConfig(const PipelineConfigInfo& other) {
+		configInfo.viewportInfo = other.viewportInfo;
+		configInfo.vertexInputInfo = other.vertexInputInfo;
+		configInfo.inputAssemblyInfo = other.inputAssemblyInfo;
+		configInfo.rasterizationInfo = other.rasterizationInfo;
+		configInfo.multisampleInfo = other.multisampleInfo;
+		configInfo.colorBlendAttachment = other.colorBlendAttachment;
+		configInfo.colorBlendInfo = other.colorBlendInfo;
+		configInfo.depthStencilInfo = other.depthStencilInfo;
+		configInfo.dynamicStateInfo = other.dynamicStateInfo;
+		configInfo.pipelineLayout = other.pipelineLayout;
+		configInfo.renderPass = other.renderPass;
+		configInfo.subpass = other.subpass;
+		configInfo.specialization = other.specialization;
+
+		const auto& vertexInput = other.vertexInputInfo;
+		bindings.assign(vertexInput.pVertexBindingDescriptions, vertexInput.pVertexBindingDescriptions + vertexInput.vertexBindingDescriptionCount);
+		attributes.assign(vertexInput.pVertexAttributeDescriptions, vertexInput.pVertexAttributeDescriptions + vertexInput.vertexAttributeDescriptionCount);
+		configInfo.vertexInputInfo.pVertexBindingDescriptions = bindings.data();
+		configInfo.vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
+
+		const auto& colorBlend = other.colorBlendInfo;
+		blendAttachments.assign(colorBlend.pAttachments, colorBlend.pAttachments + colorBlend.attachmentCount);
+		configInfo.colorBlendInfo.pAttachments = blendAttachments.data();
+
+		if (other.multisampleInfo.pSampleMask != nullptr) {
+			uint32_t words = (static_cast<uint32_t>(other.multisampleInfo.rasterizationSamples) + 31) / 32;
+			sampleMask.assign(other.multisampleInfo.pSampleMask, other.multisampleInfo.pSampleMask + words);
+			configInfo.multisampleInfo.pSampleMask = sampleMask.data();
+		}
+
+		const auto& dynamicState = other.dynamicStateInfo;
+		configInfo.dynamicStateEnables.assign(dynamicState.pDynamicStates, dynamicState.pDynamicStates + dynamicState.dynamicStateCount);
+		configInfo.dynamicStateInfo.pDynamicStates = configInfo.dynamicStateEnables.data();
+	}
+
 	VaPipeline::VaPipeline(
 		VaDevice& device,
 		const std::string& vertFilepath,
 		const std::string& fragFilepath,
-		const PipelineConfigInfo& configInfo
-	) : vaDevice{ device } {
-		createGraphicsPipeline(vertFilepath, fragFilepath, configInfo);
+		const PipelineConfigInfo& configInfo,
+		bool async
+	) : vaDevice{ device }, vertFilepath{ vertFilepath }, fragFilepath{ fragFilepath } {
+		createGraphicsPipeline(configInfo, async);
 	}
 
 	VaPipeline::~VaPipeline() {
-		vkDestroyShaderModule(vaDevice.device(), vertShaderModule, nullptr);
-		vkDestroyShaderModule(vaDevice.device(), fragShaderModule, nullptr);
-
-		vkDestroyPipeline(vaDevice.device(), graphicsPipeline, nullptr);
+		// the layout and render pass it's being built against usually go away right after this
+		if (pending.valid()) {
+			pending.wait();
+		}
+		// stays in the cache for whoever builds the same thing next
+		if (graphicsPipeline != VK_NULL_HANDLE) {
+			vaDevice.pipelineStates().release(graphicsPipeline);
+		}
 	}
 
 	std::vector<char> VaPipeline::readFile(const std::string& filepath) {
@@ -46,10 +129,7 @@ namespace va {
 		return buffer;
 	}
 
-	void VaPipeline::createGraphicsPipeline(
-		const std::string& vertFilepath, 
-		const std::string& fragFilepath, 
-		const PipelineConfigInfo& configInfo) {
+	void VaPipeline::createGraphicsPipeline(const PipelineConfigInfo& configInfo, bool async) {
 		assert(
 			configInfo.pipelineLayout != VK_NULL_HANDLE 
 			&& "Cannot create graphics pipeline:: no pipelineLayout provided in configInfo"
@@ -59,67 +139,82 @@ namespace va {
 			&& "Cannot create graphics pipeline:: no renderPass provided in configInfo"
 		);
 
-		auto vertCode = readFile(vertFilepath);
-		auto fragCode = readFile(fragFilepath);
-
-		createShaderModule(vertCode, &vertShaderModule);
-		createShaderModule(fragCode, &fragShaderModule);
+		config = std::make_shared<OwnedPipelineConfig>(configInfo);
+		shaderGeneration = vaDevice.shaderModules().generation();
+		auto vertModule = vaDevice.shaderModules().get(vertFilepath);
+		auto fragModule = vaDevice.shaderModules().get(fragFilepath);
+		vertHash = vertModule.hash;
+		fragHash = fragModule.hash;
+		if (async) {
+			pending = vaDevice.pipelineStates().getGraphicsPipelineAsync(configInfo, vertModule, fragModule);
+			isReady(configInfo.renderPass);
+			return;
+		}
+		graphicsPipeline = vaDevice.pipelineStates().getGraphicsPipeline(configInfo, vertModule, fragModule);
+		vaDevice.pipelineStates().acquire(graphicsPipeline);
+	}
 
-		VkPipelineShaderStageCreateInfo shaderStages[2];
-		
-		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-		shaderStages[0].module = vertShaderModule;
-		shaderStages[0].pName = "main";
-		shaderStages[0].flags = 0;
-		shaderStages[0].pNext = nullptr;
-		shaderStages[0].pSpecializationInfo = nullptr;
-
-		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		shaderStages[1].module = fragShaderModule;
-		shaderStages[1].pName = "main";
-		shaderStages[1].flags = 0;
-		shaderStages[1].pNext = nullptr;
-		shaderStages[1].pSpecializationInfo = nullptr;
-
-		VkGraphicsPipelineCreateInfo pipelineInfo{};
-		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipelineInfo.stageCount = 2;
-		pipelineInfo.pStages = shaderStages;
-		pipelineInfo.pVertexInputState = &configInfo.vertexInputInfo;
-		pipelineInfo.pInputAssemblyState = &configInfo.inputAssemblyInfo;
-		pipelineInfo.pViewportState = &configInfo.viewportInfo;
-		pipelineInfo.pRasterizationState = &configInfo.rasterizationInfo;
-		pipelineInfo.pMultisampleState = &configInfo.multisampleInfo;
-		pipelineInfo.pColorBlendState = &configInfo.colorBlendInfo;
-		pipelineInfo.pDepthStencilState = &configInfo.depthStencilInfo;
-		pipelineInfo.pDynamicState = &configInfo.dynamicStateInfo;
-
-		pipelineInfo.layout = configInfo.pipelineLayout;
-		pipelineInfo.renderPass = configInfo.renderPass;
-		pipelineInfo.subpass = configInfo.subpass;
-
-		pipelineInfo.basePipelineIndex = -1;
-		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-		if (vkCreateGraphicsPipelines(vaDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create graphics pipeline");
+	bool VaPipeline::isReady(VkRenderPass renderPass) {
+		if (pending.valid() && pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+			try {
+				VkPipeline built = pending.get();
+				if (built != graphicsPipeline) {
+					vaDevice.pipelineStates().acquire(built);
+					// nothing gets recorded with the old one after this, the deletion queue covers the frames in
+					// flight that still have it bound
+					if (graphicsPipeline != VK_NULL_HANDLE) {
+						vaDevice.pipelineStates().retire(graphicsPipeline);
+					}
+					graphicsPipeline = built;
+				}
+			}
+			catch (const std::exception& e) {
+				// the first build failing is still fatal, a reload failing just leaves the old pipeline in place
+				if (graphicsPipeline == VK_NULL_HANDLE) {
+					throw;
+				}
+				std::cerr << "shader reload failed, keeping the old pipeline: " << e.what() << '\n';
+			}
+			pending = {};
+		}
+		if (!pending.valid() && vaDevice.shaderModules().generation() != shaderGeneration) {
+			reloadShaders(renderPass);
 		}
+		return graphicsPipeline != VK_NULL_HANDLE;
 	}
 
-	void VaPipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule) {
-		VkShaderModuleCreateInfo createInfo{};
-		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		createInfo.codeSize = code.size();
-		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+	void VaPipeline::reloadShaders(VkRenderPass renderPass) {
+		shaderGeneration = vaDevice.shaderModules().generation();
+		VaShaderModuleCache::Module vertModule;
+		VaShaderModuleCache::Module fragModule;
+		try {
+			vertModule = vaDevice.shaderModules().get(vertFilepath);
+			fragModule = vaDevice.shaderModules().get(fragFilepath);
+		}
+		catch (const std::exception& e) {
+			std::cerr << "shader reload failed, keeping the old pipeline: " << e.what() << '\n';
+			return;
+		}
+		// something else got reloaded
+		if (vertModule.hash == vertHash && fragModule.hash == fragHash) {
+			return;
+		}
 
-		if (vkCreateShaderModule(vaDevice.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create shader module");
+		vertHash = vertModule.hash;
+		fragHash = fragModule.hash;
+		// compatible with the old render pass, so the cache still finds it by what it was made from
+		if (renderPass != config->configInfo.renderPass) {
+			auto current = std::make_shared<OwnedPipelineConfig>(config->configInfo);
+			current->configInfo.renderPass = renderPass;
+			config = std::move(current);
 		}
+		// the old pipeline keeps getting bound until this is ready, isReady() retires it then. The layout stays the
+		// same, a shader whose interface changed needs a restart
+		pending = vaDevice.pipelineStates().getGraphicsPipelineAsync(config->configInfo, vertModule, fragModule);
 	}
 
 	void VaPipeline::bind(VkCommandBuffer commandBuffer) {
+		assert(graphicsPipeline != VK_NULL_HANDLE && "Cannot bind a pipeline that's still compiling");
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
 	}
 
@@ -2,10 +2,30 @@
 
 #include "va_device.hpp"
 
+#include <future>
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace va {
+	// values for a shader's constant_id constants. Both stages get the same ones, and ids a stage doesn't declare are
+	// ignored, so one set covers the vertex and fragment shader. Setting an id again replaces its value
+	struct VaSpecialization {
+		VaSpecialization& set(uint32_t constantId, uint32_t value);
+		VaSpecialization& set(uint32_t constantId, int32_t value);
+		VaSpecialization& set(uint32_t constantId, float value);
+
+		bool empty() const { return entries.empty(); }
+		// points into this, so it has to outlive whatever the info gets passed to
+		VkSpecializationInfo getInfo() const;
+
+		std::vector<VkSpecializationMapEntry> entries;
+		std::vector<uint8_t> data;
+
+	private:
+		VaSpecialization& setBytes(uint32_t constantId, const void* value, size_t size);
+	};
+
 	struct PipelineConfigInfo {
 		PipelineConfigInfo() = default;
 		PipelineConfigInfo(const PipelineConfigInfo&) = delete;
@@ -24,6 +44,22 @@ namespace va {
 		VkPipelineLayout pipelineLayout = nullptr;
 		VkRenderPass renderPass = nullptr;
 		uint32_t subpass = 0;
+		VaSpecialization specialization;
+	};
+
+	// a PipelineConfigInfo that owns everything its create infos point at, for keeping one around past the call that
+	// filled it in. The pNext chains aren't followed, nothing in the config uses them
+	struct OwnedPipelineConfig {
+		explicit OwnedPipelineConfig(const PipelineConfigInfo& other);
+
+		OwnedPipelineConfig(const OwnedPipelineConfig&) = delete;
+		OwnedPipelineConfig& operator=(const OwnedPipelineConfig&) = delete;
+
+		PipelineConfigInfo configInfo;
+		std::vector<VkVertexInputBindingDescription> bindings;
+		std::vector<VkVertexInputAttributeDescription> attributes;
+		std::vector<VkPipelineColorBlendAttachmentState> blendAttachments;
+		std::vector<VkSampleMask> sampleMask;
 	};
 
 	class VaPipeline {
@@ -32,7 +68,8 @@ namespace va {
 			VaDevice& device, 
 			const std::string& vertFilepath, 
 			const std::string& fragFilepath, 
-			const PipelineConfigInfo& configInfo
+			const PipelineConfigInfo& configInfo,
+			bool async = false
 		);
 		~VaPipeline();
 
@@ -40,24 +77,32 @@ namespace va {
 		VaPipeline(const VaPipeline&) = delete;
 		VaPipeline& operator=(const VaPipeline&) = delete;
 
+		// an async pipeline isn't there until this says so, draws using it should be skipped until then. Also where a
+		// pipeline notices its shaders changed on disk: it starts building again from the new ones and keeps handing
+		// out the old pipeline until that's done. renderPass is the one it's about to be used in, a rebuild targets
+		// that instead of the one it was made with, which may have gone with an older swap chain
+		bool isReady(VkRenderPass renderPass);
 		void bind(VkCommandBuffer commandBuffer);
 
 		static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
+		static std::vector<char> readFile(const std::string& filepath);
 
 	private:
 		VaDevice& vaDevice;
-		VkPipeline graphicsPipeline;
-		VkShaderModule vertShaderModule;
-		VkShaderModule fragShaderModule;
-
-		static std::vector<char> readFile(const std::string& filepath);
+		// owned by the device's pipeline state cache, this only acquires it
+		VkPipeline graphicsPipeline = VK_NULL_HANDLE;
+		std::shared_future<VkPipeline> pending;
 
-		void createGraphicsPipeline(
-			const std::string& vertFilepath, 
-			const std::string& fragFilepath, 
-			const PipelineConfigInfo& configInfo
-		);
+		// everything needed to build it again when a shader gets reloaded
+		std::string vertFilepath;
+		std::string fragFilepath;
+		std::shared_ptr<const OwnedPipelineConfig> config;
+		uint64_t vertHash = 0;
+		uint64_t fragHash = 0;
+		// of the shader module cache, when it was last checked for changed shaders
+		uint64_t shaderGeneration = 0;
 
-		void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+		void createGraphicsPipeline(const PipelineConfigInfo& configInfo, bool async);
+		void reloadShaders(VkRenderPass renderPass);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include "va_pipeline_cache.hpp"
+#include "va_device.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#ifndef FILE_DIR
+#define FILE_DIR "../../../"
+#endif
+
+#define PIPELINE_CACHE_FILE "cache/pipelines.bin"
+
+namespace va {
+	VaPipelineCache::VaPipelineCache(VaDevice& device)
+		: vaDevice{ device }, filepath{ FILE_DIR PIPELINE_CACHE_FILE } {}
+
+	VaPipelineCache::~VaPipelineCache() {
+		destroy();
+	}
+
+	void VaPipelineCache::init() {
+		std::vector<char> data;
+		std::ifstream file{ filepath, std::ios::ate | std::ios::binary };
+		if (file.is_open()) {
+			data.resize(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			file.read(data.data(), data.size());
+			if (!file || !isHeaderValid(data)) {
+				std::cout << "pipeline cache at " << filepath << " is from another device or driver, starting cold\n";
+				data.clear();
+			}
+		}
+
+		VkPipelineCacheCreateInfo cacheInfo{};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheInfo.initialDataSize = data.size();
+		cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+		if (vkCreatePipelineCache(vaDevice.device(), &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline cache!");
+		}
+
+		stats.warm = !data.empty();
+		stats.loadedBytes = data.size();
+	}
+
+	void VaPipelineCache::destroy() {
+		if (pipelineCache == VK_NULL_HANDLE) {
+			return;
+		}
+
+		try {
+			save();
+		}
+		catch (const std::exception& e) {
+			std::cerr << "failed to save the pipeline cache: " << e.what() << '\n';
+		}
+		vkDestroyPipelineCache(vaDevice.device(), pipelineCache, nullptr);
+		pipelineCache = VK_NULL_HANDLE;
+	}
+
+	bool VaPipelineCache::isHeaderValid(const std::vector<char>& data) const {
+		// VkPipelineCacheHeaderVersionOne: header size, version, vendor id, device id, then the uuid
+		const size_t uuidOffset = 4 * sizeof(uint32_t);
+		if (data.size() < uuidOffset + VK_UUID_SIZE) {
+			return false;
+		}
+
+		uint32_t header[4];
+		memcpy(header, data.data(), sizeof(header));
+		return header[0] >= uuidOffset + VK_UUID_SIZE &&
+			header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+			header[2] == vaDevice.properties.vendorID &&
+			header[3] == vaDevice.properties.deviceID &&
+			memcmp(data.data() + uuidOffset, vaDevice.properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+
+	void VaPipelineCache::save() {
+		size_t size = 0;
+		if (vkGetPipelineCacheData(vaDevice.device(), pipelineCache, &size, nullptr) != VK_SUCCESS || size == 0) {
+			return;
+		}
+		std::vector<char> data(size);
+		if (vkGetPipelineCacheData(vaDevice.device(), pipelineCache, &size, data.data()) != VK_SUCCESS) {
+			return;
+		}
+
+		// written next to it and moved over, so a crash halfway through can't leave a broken file behind
+		std::filesystem::path path{ filepath };
+		std::filesystem::create_directories(path.parent_path());
+		std::filesystem::path temporary = path;
+		temporary += ".tmp";
+		{
+			std::ofstream file{ temporary, std::ios::binary | std::ios::trunc };
+			file.write(data.data(), static_cast<std::streamsize>(size));
+			if (!file) {
+				throw std::runtime_error("failed to write " + temporary.string());
+			}
+		}
+		std::filesystem::rename(temporary, path);
+	}
+
+	void VaPipelineCache::recordCreation(double milliseconds) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		stats.pipelines++;
+		stats.creationMs += milliseconds;
+	}
+
+	VaPipelineCache::Stats VaPipelineCache::getStats() {
+		std::lock_guard<std::mutex> lock{ mutex };
+		return stats;
+	}
+
+	std::string VaPipelineCache::summary() {
+		Stats current = getStats();
+		char buffer[192];
+		snprintf(buffer, sizeof(buffer), "pipeline cache: %s (%.1f KiB loaded) | %u pipelines in %.2f ms, %.2f ms each",
+			current.warm ? "warm" : "cold",
+			static_cast<double>(current.loadedBytes) / 1024.0,
+			current.pipelines,
+			current.creationMs,
+			current.pipelines > 0 ? current.creationMs / current.pipelines : 0.0);
+		return buffer;
+	}
+}
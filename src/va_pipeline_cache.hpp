@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace va {
+	class VaDevice;
+
+	// The device's VkPipelineCache, kept on disk between runs so pipelines after the first launch come out of the
+	// driver's cache instead of being compiled from SPIR-V again. The file's header has to match this exact device
+	// and driver (vendor, device id and pipeline cache UUID), anything else gets thrown away and the cache starts
+	// cold. Also times every pipeline that gets created through it, to see what the warm cache actually saves.
+	class VaPipelineCache {
+	public:
+		struct Stats {
+			// false when it started out empty, either no file or a stale one
+			bool warm = false;
+			size_t loadedBytes = 0;
+			uint32_t pipelines = 0;
+			double creationMs = 0.0;
+		};
+
+		explicit VaPipelineCache(VaDevice& device);
+		~VaPipelineCache();
+
+		VaPipelineCache(const VaPipelineCache&) = delete;
+		VaPipelineCache& operator=(const VaPipelineCache&) = delete;
+
+		// once the logical device exists
+		void init();
+		// writes the cache back out and destroys it, before the logical device goes
+		void destroy();
+
+		VkPipelineCache getPipelineCache() const { return pipelineCache; }
+
+		// whatever makes pipelines reports how long vkCreate*Pipelines took
+		void recordCreation(double milliseconds);
+
+		Stats getStats();
+		std::string summary();
+
+	private:
+		bool isHeaderValid(const std::vector<char>& data) const;
+		void save();
+
+		VaDevice& vaDevice;
+		VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+		std::string filepath;
+
+		std::mutex mutex;
+		Stats stats{};
+	};
+}
@@ -0,0 +1,435 @@
+#include "va_pipeline_state_cache.hpp"
+#include "va_device.hpp"
+#include "va_hash.hpp"
+#include "va_pipeline.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace va {
+	namespace {
+		struct Hasher {
+			uint64_t seed = 0;
+
+			void add(uint64_t value) {
+				hashCombine(seed, value);
+			}
+
+			void add(float value) {
+				uint32_t bits;
+				memcpy(&bits, &value, sizeof(bits));
+				add(static_cast<uint64_t>(bits));
+			}
+
+			void add(const VkStencilOpState& state) {
+				add(static_cast<uint64_t>(state.failOp));
+				add(static_cast<uint64_t>(state.passOp));
+				add(static_cast<uint64_t>(state.depthFailOp));
+				add(static_cast<uint64_t>(state.compareOp));
+				add(static_cast<uint64_t>(state.compareMask));
+				add(static_cast<uint64_t>(state.writeMask));
+				add(static_cast<uint64_t>(state.reference));
+			}
+		};
+	}
+
+	VaPipelineStateCache::VaPipelineStateCache(VaDevice& device) : vaDevice{ device } {}
+
+	VaPipelineStateCache::~VaPipelineStateCache() {
+		clear();
+	}
+
+	void VaPipelineStateCache::describe(uint64_t handle, uint64_t compatibilityHash) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		compatibility[handle] = compatibilityHash;
+	}
+
+	uint64_t VaPipelineStateCache::compatibilityOf(uint64_t handle) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		auto described = compatibility.find(handle);
+		return described != compatibility.end() ? described->second : handle;
+	}
+
+	void VaPipelineStateCache::forget(uint64_t handle) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		compatibility.erase(handle);
+	}
+
+	void VaPipelineStateCache::describePipelineLayout(VkPipelineLayout layout, const VkPipelineLayoutCreateInfo& createInfo) {
+		Hasher hasher{};
+		for (uint32_t i = 0; i < createInfo.setLayoutCount; i++) {
+			hasher.add(compatibilityOf(handleBits(createInfo.pSetLayouts[i])));
+		}
+		for (uint32_t i = 0; i < createInfo.pushConstantRangeCount; i++) {
+			const VkPushConstantRange& range = createInfo.pPushConstantRanges[i];
+			hasher.add(static_cast<uint64_t>(range.stageFlags));
+			hasher.add(static_cast<uint64_t>(range.offset));
+			hasher.add(static_cast<uint64_t>(range.size));
+		}
+		describe(handleBits(layout), hasher.seed);
+	}
+
+	void VaPipelineStateCache::describeRenderPass(VkRenderPass renderPass, const VkRenderPassCreateInfo& createInfo) {
+		// load/store ops and layouts don't affect compatibility, formats, sample counts and the references do
+		Hasher hasher{};
+		for (uint32_t i = 0; i < createInfo.attachmentCount; i++) {
+			hasher.add(static_cast<uint64_t>(createInfo.pAttachments[i].format));
+			hasher.add(static_cast<uint64_t>(createInfo.pAttachments[i].samples));
+		}
+		for (uint32_t i = 0; i < createInfo.subpassCount; i++) {
+			const VkSubpassDescription& subpass = createInfo.pSubpasses[i];
+			hasher.add(static_cast<uint64_t>(subpass.inputAttachmentCount));
+			for (uint32_t j = 0; j < subpass.inputAttachmentCount; j++) {
+				hasher.add(static_cast<uint64_t>(subpass.pInputAttachments[j].attachment));
+			}
+			hasher.add(static_cast<uint64_t>(subpass.colorAttachmentCount));
+			for (uint32_t j = 0; j < subpass.colorAttachmentCount; j++) {
+				hasher.add(static_cast<uint64_t>(subpass.pColorAttachments[j].attachment));
+			}
+			hasher.add(subpass.pDepthStencilAttachment != nullptr
+				? static_cast<uint64_t>(subpass.pDepthStencilAttachment->attachment)
+				: static_cast<uint64_t>(VK_ATTACHMENT_UNUSED));
+		}
+		describe(handleBits(renderPass), hasher.seed);
+	}
+
+	uint64_t VaPipelineStateCache::hashConfig(const PipelineConfigInfo& configInfo) {
+		Hasher hasher{};
+
+		const auto& vertexInput = configInfo.vertexInputInfo;
+		for (uint32_t i = 0; i < vertexInput.vertexBindingDescriptionCount; i++) {
+			const auto& binding = vertexInput.pVertexBindingDescriptions[i];
+			hasher.add(static_cast<uint64_t>(binding.binding));
+			hasher.add(static_cast<uint64_t>(binding.stride));
+			hasher.add(static_cast<uint64_t>(binding.inputRate));
+		}
+		for (uint32_t i = 0; i < vertexInput.vertexAttributeDescriptionCount; i++) {
+			const auto& attribute = vertexInput.pVertexAttributeDescriptions[i];
+			hasher.add(static_cast<uint64_t>(attribute.location));
+			hasher.add(static_cast<uint64_t>(attribute.binding));
+			hasher.add(static_cast<uint64_t>(attribute.format));
+			hasher.add(static_cast<uint64_t>(attribute.offset));
+		}
+
+		hasher.add(static_cast<uint64_t>(configInfo.inputAssemblyInfo.topology));
+		hasher.add(static_cast<uint64_t>(configInfo.inputAssemblyInfo.primitiveRestartEnable));
+		hasher.add(static_cast<uint64_t>(configInfo.viewportInfo.viewportCount));
+		hasher.add(static_cast<uint64_t>(configInfo.viewportInfo.scissorCount));
+
+		const auto& rasterization = configInfo.rasterizationInfo;
+		hasher.add(static_cast<uint64_t>(rasterization.depthClampEnable));
+		hasher.add(static_cast<uint64_t>(rasterization.rasterizerDiscardEnable));
+		hasher.add(static_cast<uint64_t>(rasterization.polygonMode));
+		hasher.add(static_cast<uint64_t>(rasterization.cullMode));
+		hasher.add(static_cast<uint64_t>(rasterization.frontFace));
+		hasher.add(static_cast<uint64_t>(rasterization.depthBiasEnable));
+		hasher.add(rasterization.depthBiasConstantFactor);
+		hasher.add(rasterization.depthBiasClamp);
+		hasher.add(rasterization.depthBiasSlopeFactor);
+		hasher.add(rasterization.lineWidth);
+
+		const auto& multisample = configInfo.multisampleInfo;
+		hasher.add(static_cast<uint64_t>(multisample.rasterizationSamples));
+		hasher.add(static_cast<uint64_t>(multisample.sampleShadingEnable));
+		hasher.add(multisample.minSampleShading);
+		hasher.add(static_cast<uint64_t>(multisample.alphaToCoverageEnable));
+		hasher.add(static_cast<uint64_t>(multisample.alphaToOneEnable));
+
+		const auto& colorBlend = configInfo.colorBlendInfo;
+		hasher.add(static_cast<uint64_t>(colorBlend.logicOpEnable));
+		hasher.add(static_cast<uint64_t>(colorBlend.logicOp));
+		for (uint32_t i = 0; i < colorBlend.attachmentCount; i++) {
+			const auto& attachment = colorBlend.pAttachments[i];
+			hasher.add(static_cast<uint64_t>(attachment.blendEnable));
+			hasher.add(static_cast<uint64_t>(attachment.srcColorBlendFactor));
+			hasher.add(static_cast<uint64_t>(attachment.dstColorBlendFactor));
+			hasher.add(static_cast<uint64_t>(attachment.colorBlendOp));
+			hasher.add(static_cast<uint64_t>(attachment.srcAlphaBlendFactor));
+			hasher.add(static_cast<uint64_t>(attachment.dstAlphaBlendFactor));
+			hasher.add(static_cast<uint64_t>(attachment.alphaBlendOp));
+			hasher.add(static_cast<uint64_t>(attachment.colorWriteMask));
+		}
+		for (float constant : colorBlend.blendConstants) {
+			hasher.add(constant);
+		}
+
+		const auto& depthStencil = configInfo.depthStencilInfo;
+		hasher.add(static_cast<uint64_t>(depthStencil.depthTestEnable));
+		hasher.add(static_cast<uint64_t>(depthStencil.depthWriteEnable));
+		hasher.add(static_cast<uint64_t>(depthStencil.depthCompareOp));
+		hasher.add(static_cast<uint64_t>(depthStencil.depthBoundsTestEnable));
+		hasher.add(static_cast<uint64_t>(depthStencil.stencilTestEnable));
+		hasher.add(depthStencil.front);
+		hasher.add(depthStencil.back);
+		hasher.add(depthStencil.minDepthBounds);
+		hasher.add(depthStencil.maxDepthBounds);
+
+		for (uint32_t i = 0; i < configInfo.dynamicStateInfo.dynamicStateCount; i++) {
+			hasher.add(static_cast<uint64_t>(configInfo.dynamicStateInfo.pDynamicStates[i]));
+		}
+
+		hasher.add(compatibilityOf(handleBits(configInfo.pipelineLayout)));
+		hasher.add(compatibilityOf(handleBits(configInfo.renderPass)));
+		hasher.add(static_cast<uint64_t>(configInfo.subpass));
+
+		for (const auto& entry : configInfo.specialization.entries) {
+			hasher.add(static_cast<uint64_t>(entry.constantID));
+			hasher.add(static_cast<uint64_t>(entry.offset));
+			hasher.add(static_cast<uint64_t>(entry.size));
+		}
+		for (uint8_t byte : configInfo.specialization.data) {
+			hasher.add(static_cast<uint64_t>(byte));
+		}
+		return hasher.seed;
+	}
+
+	uint64_t VaPipelineStateCache::makeKey(
+		const PipelineConfigInfo& configInfo,
+		const VaShaderModuleCache::Module& vertModule,
+		const VaShaderModuleCache::Module& fragModule) {
+		Hasher hasher{};
+		hasher.add(hashConfig(configInfo));
+		hasher.add(vertModule.hash);
+		hasher.add(fragModule.hash);
+		return hasher.seed;
+	}
+
+	VkPipeline VaPipelineStateCache::getGraphicsPipeline(
+		const PipelineConfigInfo& configInfo,
+		const VaShaderModuleCache::Module& vertModule,
+		const VaShaderModuleCache::Module& fragModule) {
+		uint64_t key = makeKey(configInfo, vertModule, fragModule);
+
+		std::shared_future<VkPipeline> pending;
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			auto cached = pipelines.find(key);
+			if (cached != pipelines.end()) {
+				hits++;
+				return cached->second.pipeline;
+			}
+			auto inFlight = compiling.find(key);
+			if (inFlight != compiling.end()) {
+				hits++;
+				pending = inFlight->second;
+			}
+		}
+		// already on a worker, building it again here wouldn't be any faster
+		if (pending.valid()) {
+			return pending.get();
+		}
+
+		// the lock isn't held while the driver compiles, two threads building the same pipeline at once both
+		// build it and the second one just gets thrown away
+		vaDevice.shaderModules().acquire(vertModule.hash);
+		vaDevice.shaderModules().acquire(fragModule.hash);
+		VkPipeline pipeline;
+		try {
+			pipeline = create(configInfo, vertModule, fragModule);
+		}
+		catch (...) {
+			vaDevice.shaderModules().release(vertModule.hash);
+			vaDevice.shaderModules().release(fragModule.hash);
+			throw;
+		}
+		return insert(key, pipeline, vertModule.hash, fragModule.hash);
+	}
+
+	std::shared_future<VkPipeline> VaPipelineStateCache::getGraphicsPipelineAsync(
+		const PipelineConfigInfo& configInfo,
+		const VaShaderModuleCache::Module& vertModule,
+		const VaShaderModuleCache::Module& fragModule) {
+		uint64_t key = makeKey(configInfo, vertModule, fragModule);
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		auto cached = pipelines.find(key);
+		if (cached != pipelines.end()) {
+			hits++;
+			std::promise<VkPipeline> ready;
+			ready.set_value(cached->second.pipeline);
+			return ready.get_future().share();
+		}
+		auto inFlight = compiling.find(key);
+		if (inFlight != compiling.end()) {
+			hits++;
+			return inFlight->second;
+		}
+
+		// the copy has to be owned by the task, the caller's config usually points into its stack
+		auto owned = std::make_shared<OwnedPipelineConfig>(configInfo);
+		// the modules can't go away while the worker is still building from them
+		vaDevice.shaderModules().acquire(vertModule.hash);
+		vaDevice.shaderModules().acquire(fragModule.hash);
+		std::shared_future<VkPipeline> result = vaDevice.threadPool().submit([this, key, owned, vertModule, fragModule]() {
+			VkPipeline pipeline;
+			try {
+				pipeline = create(owned->configInfo, vertModule, fragModule);
+			}
+			catch (...) {
+				vaDevice.shaderModules().release(vertModule.hash);
+				vaDevice.shaderModules().release(fragModule.hash);
+				std::lock_guard<std::mutex> lock{ mutex };
+				compiling.erase(key);
+				throw;
+			}
+			return insert(key, pipeline, vertModule.hash, fragModule.hash);
+		}).share();
+		compiling.emplace(key, result);
+		return result;
+	}
+
+	VkPipeline VaPipelineStateCache::create(
+		const PipelineConfigInfo& configInfo,
+		const VaShaderModuleCache::Module& vertModule,
+		const VaShaderModuleCache::Module& fragModule) {
+		VkSpecializationInfo specializationInfo = configInfo.specialization.getInfo();
+		const VkSpecializationInfo* specialization = configInfo.specialization.empty() ? nullptr : &specializationInfo;
+
+		VkPipelineShaderStageCreateInfo shaderStages[2]{};
+		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		shaderStages[0].module = vertModule.module;
+		shaderStages[0].pName = "main";
+		shaderStages[0].pSpecializationInfo = specialization;
+
+		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		shaderStages[1].module = fragModule.module;
+		shaderStages[1].pName = "main";
+		shaderStages[1].pSpecializationInfo = specialization;
+
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.stageCount = 2;
+		pipelineInfo.pStages = shaderStages;
+		pipelineInfo.pVertexInputState = &configInfo.vertexInputInfo;
+		pipelineInfo.pInputAssemblyState = &configInfo.inputAssemblyInfo;
+		pipelineInfo.pViewportState = &configInfo.viewportInfo;
+		pipelineInfo.pRasterizationState = &configInfo.rasterizationInfo;
+		pipelineInfo.pMultisampleState = &configInfo.multisampleInfo;
+		pipelineInfo.pColorBlendState = &configInfo.colorBlendInfo;
+		pipelineInfo.pDepthStencilState = &configInfo.depthStencilInfo;
+		pipelineInfo.pDynamicState = &configInfo.dynamicStateInfo;
+
+		pipelineInfo.layout = configInfo.pipelineLayout;
+		pipelineInfo.renderPass = configInfo.renderPass;
+		pipelineInfo.subpass = configInfo.subpass;
+
+		pipelineInfo.basePipelineIndex = -1;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+		// the VkPipelineCache is internally synchronized, so workers can all build against it at once
+		auto start = std::chrono::high_resolution_clock::now();
+		VkPipeline pipeline;
+		if (vkCreateGraphicsPipelines(vaDevice.device(), vaDevice.pipelineCache().getPipelineCache(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create graphics pipeline");
+		}
+		vaDevice.pipelineCache().recordCreation(
+			std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+		return pipeline;
+	}
+
+	VkPipeline VaPipelineStateCache::insert(uint64_t key, VkPipeline pipeline, uint64_t vertHash, uint64_t fragHash) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		compiling.erase(key);
+		auto [existing, inserted] = pipelines.emplace(key, Cached{ pipeline, vertHash, fragHash });
+		if (!inserted) {
+			vkDestroyPipeline(vaDevice.device(), pipeline, nullptr);
+			vaDevice.shaderModules().release(vertHash);
+			vaDevice.shaderModules().release(fragHash);
+		}
+		misses++;
+		return existing->second.pipeline;
+	}
+
+	void VaPipelineStateCache::acquire(VkPipeline pipeline) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		for (auto& [key, cached] : pipelines) {
+			if (cached.pipeline == pipeline) {
+				cached.users++;
+				// asked for again after a reload went back to the shaders it was built from
+				cached.retired = false;
+				return;
+			}
+		}
+	}
+
+	void VaPipelineStateCache::release(VkPipeline pipeline) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		releaseLocked(pipeline, false);
+	}
+
+	void VaPipelineStateCache::retire(VkPipeline pipeline) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		releaseLocked(pipeline, true);
+	}
+
+	void VaPipelineStateCache::releaseLocked(VkPipeline pipeline, bool retire) {
+		for (auto it = pipelines.begin(); it != pipelines.end(); ++it) {
+			Cached& cached = it->second;
+			if (cached.pipeline != pipeline) {
+				continue;
+			}
+			if (cached.users > 0) {
+				cached.users--;
+			}
+			cached.retired = cached.retired || retire;
+			if (cached.users == 0 && cached.retired) {
+				// frames still in flight can have it bound, the modules are only needed to build it
+				vaDevice.deletionQueue().push([device = vaDevice.device(), pipeline]() {
+					vkDestroyPipeline(device, pipeline, nullptr);
+				});
+				vaDevice.shaderModules().release(cached.vertHash);
+				vaDevice.shaderModules().release(cached.fragHash);
+				pipelines.erase(it);
+			}
+			return;
+		}
+	}
+
+	void VaPipelineStateCache::waitIdle() {
+		std::vector<std::shared_future<VkPipeline>> pending;
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			for (auto& [key, future] : compiling) {
+				pending.push_back(future);
+			}
+		}
+		for (auto& future : pending) {
+			future.wait();
+		}
+	}
+
+	VaPipelineStateCache::Stats VaPipelineStateCache::getStats() {
+		std::lock_guard<std::mutex> lock{ mutex };
+		Stats stats{};
+		stats.pipelines = static_cast<uint32_t>(pipelines.size());
+		stats.hits = hits;
+		stats.misses = misses;
+		stats.compiling = static_cast<uint32_t>(compiling.size());
+		return stats;
+	}
+
+	std::string VaPipelineStateCache::summary() {
+		Stats current = getStats();
+		char buffer[160];
+		snprintf(buffer, sizeof(buffer), "pipeline states: %u pipelines, %u compiling | %llu hits, %llu misses",
+			current.pipelines,
+			current.compiling,
+			static_cast<unsigned long long>(current.hits),
+			static_cast<unsigned long long>(current.misses));
+		return buffer;
+	}
+
+	void VaPipelineStateCache::clear() {
+		waitIdle();
+		std::lock_guard<std::mutex> lock{ mutex };
+		for (auto& [key, cached] : pipelines) {
+			vkDestroyPipeline(vaDevice.device(), cached.pipeline, nullptr);
+		}
+		pipelines.clear();
+	}
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "va_shader_module_cache.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace va {
+	class VaDevice;
+	struct PipelineConfigInfo;
+
+	// Hands out one VkPipeline per distinct pipeline description, so a render system that gets recreated, or two
+	// materials that end up with identical state, don't build the same pipeline twice. The key covers all of
+	// PipelineConfigInfo's state (what its pointers point at, not the pointers), the shader modules' contents, and
+	// the layout and render pass by compatibility rather than by handle.
+	//
+	// Compatibility comes from describe(): descriptor set layouts, pipeline layouts and render passes register what
+	// they were made from when they're created, so a new handle made the same way as an old one still hits.
+	// Anything nobody described falls back to its handle, and whatever destroys a described handle forget()s it, so a
+	// new object that gets the same handle value isn't mistaken for the old one. Keys are 64 bit hashes, a collision
+	// isn't handled.
+	//
+	// Nothing else should destroy the pipelines. VaPipeline acquire()s whatever it binds and release()s it when it's
+	// done, the pipeline stays cached for the next one asking. retire() is for a pipeline a shader reload replaced,
+	// it goes through the deletion queue once nobody is using it, together with the shader modules it was built from.
+	//
+	// getGraphicsPipelineAsync() builds on the device's thread pool instead of blocking the caller. The layout and
+	// render pass have to stay alive until the future is ready, waitIdle() is there for anything about to destroy one.
+	class VaPipelineStateCache {
+	public:
+		struct Stats {
+			uint32_t pipelines = 0;
+			uint64_t hits = 0;
+			uint64_t misses = 0;
+			uint32_t compiling = 0;
+		};
+
+		explicit VaPipelineStateCache(VaDevice& device);
+		~VaPipelineStateCache();
+
+		VaPipelineStateCache(const VaPipelineStateCache&) = delete;
+		VaPipelineStateCache& operator=(const VaPipelineStateCache&) = delete;
+
+		void describe(uint64_t handle, uint64_t compatibilityHash);
+		void describePipelineLayout(VkPipelineLayout layout, const VkPipelineLayoutCreateInfo& createInfo);
+		void describeRenderPass(VkRenderPass renderPass, const VkRenderPassCreateInfo& createInfo);
+		// whatever describe() registered for the handle, the handle itself otherwise
+		uint64_t compatibilityOf(uint64_t handle);
+		// the handle is about to be destroyed
+		void forget(uint64_t handle);
+
+		VkPipeline getGraphicsPipeline(
+			const PipelineConfigInfo& configInfo,
+			const VaShaderModuleCache::Module& vertModule,
+			const VaShaderModuleCache::Module& fragModule);
+		// the config is copied, so it doesn't have to outlive the call. Asking for something that's already
+		// compiling gets the same future back
+		std::shared_future<VkPipeline> getGraphicsPipelineAsync(
+			const PipelineConfigInfo& configInfo,
+			const VaShaderModuleCache::Module& vertModule,
+			const VaShaderModuleCache::Module& fragModule);
+		// blocks until nothing is compiling anymore
+		void waitIdle();
+
+		void acquire(VkPipeline pipeline);
+		void release(VkPipeline pipeline);
+		// same as release(), and the pipeline won't be needed again
+		void retire(VkPipeline pipeline);
+
+		Stats getStats();
+		std::string summary();
+		// only safe once nothing using the pipelines can still be in flight
+		void clear();
+
+	private:
+		struct Cached {
+			VkPipeline pipeline;
+			// of the shader modules it was built from
+			uint64_t vertHash;
+			uint64_t fragHash;
+			uint32_t users = 0;
+			bool retired = false;
+		};
+
+		uint64_t hashConfig(const PipelineConfigInfo& configInfo);
+		uint64_t makeKey(
+			const PipelineConfigInfo& configInfo,
+			const VaShaderModuleCache::Module& vertModule,
+			const VaShaderModuleCache::Module& fragModule);
+		VkPipeline create(
+			const PipelineConfigInfo& configInfo,
+			const VaShaderModuleCache::Module& vertModule,
+			const VaShaderModuleCache::Module& fragModule);
+		// adds a freshly built pipeline, unless someone else got there first, returns the one that's cached
+		VkPipeline insert(uint64_t key, VkPipeline pipeline, uint64_t vertHash, uint64_t fragHash);
+		// with the lock held, destroys it once it's retired and unused
+		void releaseLocked(VkPipeline pipeline, bool retire);
+
+		VaDevice& vaDevice;
+		std::mutex mutex;
+		std::unordered_map<uint64_t, uint64_t> compatibility;
+		std::unordered_map<uint64_t, Cached> pipelines;
+		std::unordered_map<uint64_t, std::shared_future<VkPipeline>> compiling;
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+	};
+}
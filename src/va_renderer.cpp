@@ -22,12 +22,12 @@ namespace va {
 			glfwWaitEvents();
 		}
 
-		vkDeviceWaitIdle(vaDevice.device());
-
 		if (vaSwapChain == nullptr) {
 			vaSwapChain = std::make_unique<VaSwapChain>(vaDevice, extent);
 		}
 		else {
+			// pipelines still compiling on a worker need the old render pass until they're done
+			vaDevice.pipelineStates().waitIdle();
 			std::shared_ptr<VaSwapChain> oldSwapChain = std::move(vaSwapChain);
 			vaSwapChain = std::make_unique<VaSwapChain>(vaDevice, extent, oldSwapChain);
 			if (!oldSwapChain->compareSwapFormats(*vaSwapChain.get())) {
@@ -70,6 +70,9 @@ namespace va {
 		}
 
 		isFrameStarted = true;
+		// the fence for this frame slot was waited on in acquireNextImage
+		vaDevice.deletionQueue().beginFrame(VaSwapChain::MAX_FRAMES_IN_FLIGHT);
+		vaDevice.bufferPool().trim();
 
 		auto commandBuffer = getCurrentCommandBuffer();
 		VkCommandBufferBeginInfo beginInfo{};
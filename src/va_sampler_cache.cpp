@@ -0,0 +1,136 @@
+#include "va_sampler_cache.hpp"
+#include "va_hash.hpp"
+#include "va_device.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace va {
+	VkSamplerCreateInfo VaSamplerDesc::createInfo() const {
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = magFilter;
+		samplerInfo.minFilter = minFilter;
+		samplerInfo.mipmapMode = mipmapMode;
+		samplerInfo.addressModeU = addressModeU;
+		samplerInfo.addressModeV = addressModeV;
+		samplerInfo.addressModeW = addressModeW;
+		samplerInfo.mipLodBias = mipLodBias;
+		samplerInfo.anisotropyEnable = anisotropyEnable;
+		samplerInfo.maxAnisotropy = maxAnisotropy;
+		samplerInfo.compareEnable = compareEnable;
+		samplerInfo.compareOp = compareOp;
+		samplerInfo.minLod = minLod;
+		samplerInfo.maxLod = maxLod;
+		samplerInfo.borderColor = borderColor;
+		samplerInfo.unnormalizedCoordinates = unnormalizedCoordinates;
+		return samplerInfo;
+	}
+
+	bool VaSamplerDesc::operator==(const VaSamplerDesc& other) const {
+		return magFilter == other.magFilter &&
+			minFilter == other.minFilter &&
+			mipmapMode == other.mipmapMode &&
+			addressModeU == other.addressModeU &&
+			addressModeV == other.addressModeV &&
+			addressModeW == other.addressModeW &&
+			mipLodBias == other.mipLodBias &&
+			anisotropyEnable == other.anisotropyEnable &&
+			maxAnisotropy == other.maxAnisotropy &&
+			compareEnable == other.compareEnable &&
+			compareOp == other.compareOp &&
+			minLod == other.minLod &&
+			maxLod == other.maxLod &&
+			borderColor == other.borderColor &&
+			unnormalizedCoordinates == other.unnormalizedCoordinates;
+	}
+
+	size_t VaSamplerCache::DescHash::operator()(const VaSamplerDesc& desc) const {
+		auto bits = [](float value) {
+			uint32_t result;
+			memcpy(&result, &value, sizeof(result));
+			return result;
+		};
+		uint32_t fields[] = {
+			static_cast<uint32_t>(desc.magFilter),
+			static_cast<uint32_t>(desc.minFilter),
+			static_cast<uint32_t>(desc.mipmapMode),
+			static_cast<uint32_t>(desc.addressModeU),
+			static_cast<uint32_t>(desc.addressModeV),
+			static_cast<uint32_t>(desc.addressModeW),
+			bits(desc.mipLodBias),
+			desc.anisotropyEnable,
+			bits(desc.maxAnisotropy),
+			desc.compareEnable,
+			static_cast<uint32_t>(desc.compareOp),
+			bits(desc.minLod),
+			bits(desc.maxLod),
+			static_cast<uint32_t>(desc.borderColor),
+			desc.unnormalizedCoordinates
+		};
+
+		size_t seed = 0;
+		for (uint32_t field : fields) {
+			hashCombine(seed, field);
+		}
+		return seed;
+	}
+
+	VaSamplerCache::VaSamplerCache(VaDevice& device) : vaDevice{ device } {}
+
+	VaSamplerCache::~VaSamplerCache() {
+		clear();
+	}
+
+	VaSamplerDesc VaSamplerCache::describe(VaSamplerPreset preset) const {
+		VaSamplerDesc desc{};
+		desc.anisotropyEnable = VK_TRUE;
+		desc.maxAnisotropy = vaDevice.properties.limits.maxSamplerAnisotropy;
+
+		switch (preset) {
+		case VaSamplerPreset::PixelArt:
+			desc.magFilter = VK_FILTER_NEAREST;
+			desc.minFilter = VK_FILTER_NEAREST;
+			desc.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+			desc.borderColor = VK_BORDER_COLOR_INT_TRANSPARENT_BLACK;
+			break;
+		case VaSamplerPreset::Linear:
+			break;
+		case VaSamplerPreset::Cubemap:
+			desc.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			desc.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			desc.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			break;
+		}
+		return desc;
+	}
+
+	VkSampler VaSamplerCache::getSampler(const VaSamplerDesc& desc) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		auto it = samplers.find(desc);
+		if (it != samplers.end()) {
+			return it->second;
+		}
+
+		VkSamplerCreateInfo samplerInfo = desc.createInfo();
+		VkSampler sampler;
+		if (vkCreateSampler(vaDevice.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create texture sampler");
+		}
+		samplers.emplace(desc, sampler);
+		return sampler;
+	}
+
+	uint32_t VaSamplerCache::size() {
+		std::lock_guard<std::mutex> lock{ mutex };
+		return static_cast<uint32_t>(samplers.size());
+	}
+
+	void VaSamplerCache::clear() {
+		std::lock_guard<std::mutex> lock{ mutex };
+		for (auto& [desc, sampler] : samplers) {
+			vkDestroySampler(vaDevice.device(), sampler, nullptr);
+		}
+		samplers.clear();
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+namespace va {
+	class VaDevice;
+
+	// the handful of sampler setups the renderer actually uses
+	enum class VaSamplerPreset {
+		// nearest everything with repeat, the look all the object and terrain textures go for
+		PixelArt,
+		// trilinear with repeat
+		Linear,
+		// linear, clamped to the edge, for cubemaps
+		Cubemap
+	};
+
+	// Everything that goes into a VkSamplerCreateInfo, minus sType/pNext, so it can be hashed and compared
+	struct VaSamplerDesc {
+		VkFilter magFilter = VK_FILTER_LINEAR;
+		VkFilter minFilter = VK_FILTER_LINEAR;
+		VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		VkSamplerAddressMode addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		VkSamplerAddressMode addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		VkSamplerAddressMode addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		float mipLodBias = 0.0f;
+		VkBool32 anisotropyEnable = VK_FALSE;
+		float maxAnisotropy = 1.0f;
+		VkBool32 compareEnable = VK_FALSE;
+		VkCompareOp compareOp = VK_COMPARE_OP_ALWAYS;
+		float minLod = 0.0f;
+		float maxLod = VK_LOD_CLAMP_NONE;
+		VkBorderColor borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+		VkBool32 unnormalizedCoordinates = VK_FALSE;
+
+		VkSamplerCreateInfo createInfo() const;
+		bool operator==(const VaSamplerDesc& other) const;
+	};
+
+	// Hands out one VkSampler per distinct VaSamplerDesc, so textures sharing settings share the sampler. Devices
+	// only allow so many samplers (maxSamplerAllocationCount), and it keeps the count small enough for a bindless
+	// table. Samplers live until the device goes away, nothing else should destroy them.
+	class VaSamplerCache {
+	public:
+		explicit VaSamplerCache(VaDevice& device);
+		~VaSamplerCache();
+
+		VaSamplerCache(const VaSamplerCache&) = delete;
+		VaSamplerCache& operator=(const VaSamplerCache&) = delete;
+
+		// the desc behind a preset, for callers that want to tweak something (like minLod) before asking for it
+		VaSamplerDesc describe(VaSamplerPreset preset) const;
+
+		VkSampler getSampler(const VaSamplerDesc& desc);
+		VkSampler getSampler(VaSamplerPreset preset) { return getSampler(describe(preset)); }
+
+		uint32_t size();
+		// only safe once nothing using the samplers can still be in flight
+		void clear();
+
+	private:
+		struct DescHash {
+			size_t operator()(const VaSamplerDesc& desc) const;
+		};
+
+		VaDevice& vaDevice;
+		std::mutex mutex;
+		std::unordered_map<VaSamplerDesc, VkSampler, DescHash> samplers;
+	};
+}
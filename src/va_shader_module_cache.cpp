@@ -0,0 +1,129 @@
+#include "va_shader_module_cache.hpp"
+#include "va_device.hpp"
+#include "va_hash.hpp"
+#include "va_pipeline.hpp"
+
+#include <stdexcept>
+
+#ifndef FILE_DIR
+#define FILE_DIR "../../../"
+#endif
+
+namespace va {
+	VaShaderModuleCache::VaShaderModuleCache(VaDevice& device) : vaDevice{ device } {}
+
+	VaShaderModuleCache::~VaShaderModuleCache() {
+		clear();
+	}
+
+	VaShaderModuleCache::Module VaShaderModuleCache::get(const std::string& filepath) {
+		std::filesystem::path path{ FILE_DIR + filepath };
+		std::error_code error;
+		auto writeTime = std::filesystem::last_write_time(path, error);
+		uintmax_t fileSize = error ? 0 : std::filesystem::file_size(path, error);
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		auto file = files.find(filepath);
+		if (!error && file != files.end() && !file->second.changed && file->second.writeTime == writeTime && file->second.size == fileSize) {
+			auto module = modules.find(file->second.hash);
+			if (module != modules.end()) {
+				return { module->second, file->second.hash };
+			}
+		}
+
+		std::vector<char> code = VaPipeline::readFile(filepath);
+		uint64_t hash = fnv1a(code.data(), code.size());
+		// whatever the file had before stays around while pipelines still have it
+		uint64_t previous = file != files.end() ? file->second.hash : 0;
+		if (!error) {
+			files[filepath] = { writeTime, fileSize, hash };
+		}
+		else if (file != files.end()) {
+			files.erase(file);
+		}
+		if (previous != 0 && previous != hash) {
+			destroyIfUnused(previous);
+		}
+
+		auto existing = modules.find(hash);
+		if (existing != modules.end()) {
+			return { existing->second, hash };
+		}
+
+		VkShaderModuleCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = code.size();
+		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+		VkShaderModule module;
+		if (vkCreateShaderModule(vaDevice.device(), &createInfo, nullptr, &module) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create shader module");
+		}
+		modules.emplace(hash, module);
+		return { module, hash };
+	}
+
+	void VaShaderModuleCache::invalidate(const std::string& filepath) {
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			// the write time alone could miss a rewrite within the filesystem's timestamp resolution. The entry stays
+			// so the next get() knows which module the file had before
+			auto file = files.find(filepath);
+			if (file != files.end()) {
+				file->second.changed = true;
+			}
+		}
+		generation_++;
+	}
+
+	void VaShaderModuleCache::acquire(uint64_t hash) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		users[hash]++;
+	}
+
+	void VaShaderModuleCache::release(uint64_t hash) {
+		std::lock_guard<std::mutex> lock{ mutex };
+		auto count = users.find(hash);
+		if (count == users.end()) {
+			return;
+		}
+		if (--count->second == 0) {
+			users.erase(count);
+			destroyIfUnused(hash);
+		}
+	}
+
+	void VaShaderModuleCache::destroyIfUnused(uint64_t hash) {
+		if (users.count(hash)) {
+			return;
+		}
+		for (const auto& [filepath, file] : files) {
+			if (file.hash == hash) {
+				return;
+			}
+		}
+		auto module = modules.find(hash);
+		if (module == modules.end()) {
+			return;
+		}
+		vaDevice.deletionQueue().push([device = vaDevice.device(), module = module->second]() {
+			vkDestroyShaderModule(device, module, nullptr);
+		});
+		modules.erase(module);
+	}
+
+	uint32_t VaShaderModuleCache::size() {
+		std::lock_guard<std::mutex> lock{ mutex };
+		return static_cast<uint32_t>(modules.size());
+	}
+
+	void VaShaderModuleCache::clear() {
+		std::lock_guard<std::mutex> lock{ mutex };
+		for (auto& [hash, module] : modules) {
+			vkDestroyShaderModule(vaDevice.device(), module, nullptr);
+		}
+		modules.clear();
+		files.clear();
+		users.clear();
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace va {
+	class VaDevice;
+
+	// One VkShaderModule per distinct SPIR-V blob, found by hashing the file's contents. A file only gets read again
+	// when its size or modification time changed, and two files with the same code share the module. Nothing else
+	// should destroy them.
+	//
+	// That's also what makes reloading safe: a file that changed gets a new module next to the old one, and anything
+	// still building with the old one keeps working. invalidate() is how whoever rewrote a file lets pipelines know.
+	// The pipeline state cache acquire()s the modules a pipeline is built from for as long as it keeps the pipeline,
+	// a module no file has anymore goes through the deletion queue once nothing has it acquired.
+	class VaShaderModuleCache {
+	public:
+		struct Module {
+			VkShaderModule module = VK_NULL_HANDLE;
+			// of the SPIR-V, what pipelines built from the module get keyed on
+			uint64_t hash = 0;
+		};
+
+		explicit VaShaderModuleCache(VaDevice& device);
+		~VaShaderModuleCache();
+
+		VaShaderModuleCache(const VaShaderModuleCache&) = delete;
+		VaShaderModuleCache& operator=(const VaShaderModuleCache&) = delete;
+
+		// filepath is relative to the project root like every other asset path
+		Module get(const std::string& filepath);
+		// the file changed on disk, the next get() reads it again. Safe from any thread
+		void invalidate(const std::string& filepath);
+		// goes up with every invalidate(), cheap enough to check every frame
+		uint64_t generation() const { return generation_.load(); }
+		// by Module::hash
+		void acquire(uint64_t hash);
+		void release(uint64_t hash);
+
+		uint32_t size();
+		// only safe once nothing using the modules can still be in flight
+		void clear();
+
+	private:
+		struct File {
+			std::filesystem::file_time_type writeTime;
+			uintmax_t size;
+			uint64_t hash;
+			// invalidate()d, read it again whatever the write time says
+			bool changed = false;
+		};
+
+		// with the lock held, destroys the module if no file has it and nobody has it acquired
+		void destroyIfUnused(uint64_t hash);
+
+		VaDevice& vaDevice;
+		std::mutex mutex;
+		std::unordered_map<std::string, File> files;
+		std::unordered_map<uint64_t, VkShaderModule> modules;
+		std::unordered_map<uint64_t, uint32_t> users;
+		std::atomic<uint64_t> generation_{ 0 };
+	};
+}
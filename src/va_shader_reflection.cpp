@@ -0,0 +1,517 @@
+#include "va_shader_reflection.hpp"
+#include "va_descriptors.hpp"
+#include "va_pipeline.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace va {
+	namespace {
+		// the parts of the SPIR-V spec this needs
+		constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+		enum Op : uint32_t {
+			OpEntryPoint = 15,
+			OpTypeBool = 20,
+			OpTypeInt = 21,
+			OpTypeFloat = 22,
+			OpTypeVector = 23,
+			OpTypeMatrix = 24,
+			OpTypeImage = 25,
+			OpTypeSampler = 26,
+			OpTypeSampledImage = 27,
+			OpTypeArray = 28,
+			OpTypeRuntimeArray = 29,
+			OpTypeStruct = 30,
+			OpTypePointer = 32,
+			OpConstant = 43,
+			OpSpecConstantTrue = 48,
+			OpSpecConstantFalse = 49,
+			OpSpecConstant = 50,
+			OpVariable = 59,
+			OpDecorate = 71,
+			OpMemberDecorate = 72,
+			OpTypeAccelerationStructureKHR = 5341
+		};
+
+		enum Decoration : uint32_t {
+			DecorationSpecId = 1,
+			DecorationBlock = 2,
+			DecorationBufferBlock = 3,
+			DecorationArrayStride = 6,
+			DecorationMatrixStride = 7,
+			DecorationBuiltIn = 11,
+			DecorationLocation = 30,
+			DecorationBinding = 33,
+			DecorationDescriptorSet = 34,
+			DecorationOffset = 35
+		};
+
+		enum StorageClass : uint32_t {
+			StorageClassUniformConstant = 0,
+			StorageClassInput = 1,
+			StorageClassUniform = 2,
+			StorageClassPushConstant = 9,
+			StorageClassStorageBuffer = 12
+		};
+
+		enum Dim : uint32_t {
+			DimBuffer = 5,
+			DimSubpassData = 6
+		};
+
+		// every id's instruction operands plus its decorations, enough to work out what a variable is
+		struct Id {
+			uint32_t opcode = 0;
+			std::vector<uint32_t> operands;
+			std::unordered_map<uint32_t, uint32_t> decorations;
+			// member index -> decoration -> value
+			std::unordered_map<uint32_t, std::unordered_map<uint32_t, uint32_t>> memberDecorations;
+
+			bool has(uint32_t decoration) const { return decorations.count(decoration) != 0; }
+			uint32_t get(uint32_t decoration) const {
+				auto found = decorations.find(decoration);
+				return found != decorations.end() ? found->second : 0;
+			}
+		};
+
+		class Module {
+		public:
+			explicit Module(const std::vector<char>& code) {
+				if (code.size() < 5 * sizeof(uint32_t) || code.size() % sizeof(uint32_t) != 0) {
+					throw std::runtime_error("not a SPIR-V module: wrong size");
+				}
+				words.resize(code.size() / sizeof(uint32_t));
+				memcpy(words.data(), code.data(), code.size());
+				if (words[0] != SPIRV_MAGIC) {
+					throw std::runtime_error("not a SPIR-V module: wrong magic number");
+				}
+				ids.resize(words[3]);
+
+				for (size_t i = 5; i < words.size();) {
+					uint32_t wordCount = words[i] >> 16;
+					uint32_t opcode = words[i] & 0xffff;
+					if (wordCount == 0 || i + wordCount > words.size()) {
+						throw std::runtime_error("not a SPIR-V module: truncated instruction");
+					}
+					read(opcode, &words[i + 1], wordCount - 1);
+					i += wordCount;
+				}
+			}
+
+			VkShaderStageFlagBits stage = VkShaderStageFlagBits(0);
+			std::vector<uint32_t> variables;
+			std::vector<uint32_t> specConstants;
+
+			const Id& operator[](uint32_t id) const {
+				if (id >= ids.size()) {
+					throw std::runtime_error("SPIR-V id out of range");
+				}
+				return ids[id];
+			}
+
+			uint32_t constantValue(uint32_t id) const {
+				const Id& constant = (*this)[id];
+				if (constant.opcode != OpConstant && constant.opcode != OpSpecConstant) {
+					throw std::runtime_error("SPIR-V array length isn't a constant");
+				}
+				return constant.operands[2];
+			}
+
+			// bytes a value of the type takes up in a block, with the strides it was decorated with
+			uint32_t sizeOf(uint32_t typeId, uint32_t matrixStride = 0) const {
+				const Id& type = (*this)[typeId];
+				switch (type.opcode) {
+				case OpTypeBool:
+					return 4;
+				case OpTypeInt:
+				case OpTypeFloat:
+					return type.operands[1] / 8;
+				case OpTypeVector:
+					return type.operands[2] * sizeOf(type.operands[1]);
+				case OpTypeMatrix:
+					return type.operands[2] * (matrixStride != 0 ? matrixStride : sizeOf(type.operands[1]));
+				case OpTypeArray: {
+					uint32_t length = constantValue(type.operands[2]);
+					uint32_t stride = type.has(DecorationArrayStride) ? type.get(DecorationArrayStride) : sizeOf(type.operands[1], matrixStride);
+					return length * stride;
+				}
+				case OpTypeRuntimeArray:
+					return 0;
+				case OpTypeStruct: {
+					uint32_t size = 0;
+					for (uint32_t member = 1; member < type.operands.size(); member++) {
+						auto decorations = type.memberDecorations.find(member - 1);
+						uint32_t offset = 0;
+						uint32_t memberMatrixStride = 0;
+						if (decorations != type.memberDecorations.end()) {
+							auto offsetDecoration = decorations->second.find(DecorationOffset);
+							offset = offsetDecoration != decorations->second.end() ? offsetDecoration->second : 0;
+							auto strideDecoration = decorations->second.find(DecorationMatrixStride);
+							memberMatrixStride = strideDecoration != decorations->second.end() ? strideDecoration->second : 0;
+						}
+						size = std::max(size, offset + sizeOf(type.operands[member], memberMatrixStride));
+					}
+					return size;
+				}
+				default:
+					return 0;
+				}
+			}
+
+			// lowest member offset of a block, where its push constant range starts
+			uint32_t firstOffset(uint32_t structId) const {
+				const Id& type = (*this)[structId];
+				uint32_t offset = UINT32_MAX;
+				for (uint32_t member = 0; member + 1 < type.operands.size(); member++) {
+					auto decorations = type.memberDecorations.find(member);
+					if (decorations != type.memberDecorations.end() && decorations->second.count(DecorationOffset)) {
+						offset = std::min(offset, decorations->second.at(DecorationOffset));
+					}
+				}
+				return offset == UINT32_MAX ? 0 : offset;
+			}
+
+		private:
+			std::vector<uint32_t> words;
+			std::vector<Id> ids;
+
+			void read(uint32_t opcode, const uint32_t* operands, uint32_t count) {
+				switch (opcode) {
+				case OpEntryPoint:
+					// the first entry point decides the stage, a module with several isn't something this app makes
+					if (stage == 0) {
+						stage = stageOf(operands[0]);
+					}
+					break;
+				case OpDecorate:
+					if (count >= 2) {
+						ids.at(operands[0]).decorations[operands[1]] = count >= 3 ? operands[2] : 0;
+					}
+					break;
+				case OpMemberDecorate:
+					if (count >= 3) {
+						ids.at(operands[0]).memberDecorations[operands[1]][operands[2]] = count >= 4 ? operands[3] : 0;
+					}
+					break;
+				case OpTypeBool:
+				case OpTypeInt:
+				case OpTypeFloat:
+				case OpTypeVector:
+				case OpTypeMatrix:
+				case OpTypeImage:
+				case OpTypeSampler:
+				case OpTypeSampledImage:
+				case OpTypeArray:
+				case OpTypeRuntimeArray:
+				case OpTypeStruct:
+				case OpTypePointer:
+				case OpTypeAccelerationStructureKHR:
+					store(operands[0], opcode, operands, count);
+					break;
+				case OpConstant:
+				case OpSpecConstantTrue:
+				case OpSpecConstantFalse:
+				case OpSpecConstant:
+				case OpVariable:
+					// result type comes first for these, the id is the second operand
+					store(operands[1], opcode, operands, count);
+					if (opcode == OpVariable) {
+						variables.push_back(operands[1]);
+					}
+					else if (opcode != OpConstant) {
+						specConstants.push_back(operands[1]);
+					}
+					break;
+				default:
+					break;
+				}
+			}
+
+			void store(uint32_t id, uint32_t opcode, const uint32_t* operands, uint32_t count) {
+				Id& entry = ids.at(id);
+				entry.opcode = opcode;
+				entry.operands.assign(operands, operands + count);
+			}
+
+			static VkShaderStageFlagBits stageOf(uint32_t executionModel) {
+				switch (executionModel) {
+				case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+				case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+				case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+				case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+				case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+				case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+				default:
+					throw std::runtime_error("unsupported shader stage in SPIR-V");
+				}
+			}
+		};
+
+		VkFormat formatOf(const Module& module, uint32_t typeId) {
+			const Id* type = &module[typeId];
+			uint32_t components = 1;
+			if (type->opcode == OpTypeVector) {
+				components = type->operands[2];
+				type = &module[type->operands[1]];
+			}
+			if (type->operands.size() < 2 || type->operands[1] != 32) {
+				return VK_FORMAT_UNDEFINED;
+			}
+
+			static const VkFormat floats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+			static const VkFormat sints[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+			static const VkFormat uints[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+			if (components < 1 || components > 4) {
+				return VK_FORMAT_UNDEFINED;
+			}
+			if (type->opcode == OpTypeFloat) {
+				return floats[components - 1];
+			}
+			if (type->opcode == OpTypeInt) {
+				return type->operands[2] != 0 ? sints[components - 1] : uints[components - 1];
+			}
+			return VK_FORMAT_UNDEFINED;
+		}
+
+		bool sameType(VkDescriptorType a, VkDescriptorType b) {
+			auto plain = [](VkDescriptorType type) {
+				if (type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC) return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+				if (type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC) return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				return type;
+			};
+			return plain(a) == plain(b);
+		}
+	}
+
+	VaShaderReflection::VaShaderReflection(const std::vector<char>& code) {
+		Module module{ code };
+		stages = module.stage;
+
+		for (uint32_t constantId : module.specConstants) {
+			const Id& constant = module[constantId];
+			if (constant.has(DecorationSpecId)) {
+				specConstants.insert(constant.get(DecorationSpecId));
+			}
+		}
+
+		for (uint32_t variableId : module.variables) {
+			const Id& variable = module[variableId];
+			uint32_t storageClass = variable.operands[2];
+			const Id& pointer = module[variable.operands[0]];
+			uint32_t typeId = pointer.operands[2];
+
+			if (storageClass == StorageClassInput) {
+				if (module.stage != VK_SHADER_STAGE_VERTEX_BIT || variable.has(DecorationBuiltIn) || !variable.has(DecorationLocation)) {
+					continue;
+				}
+				vertexInputs.push_back({ variable.get(DecorationLocation), formatOf(module, typeId) });
+				continue;
+			}
+
+			if (storageClass == StorageClassPushConstant) {
+				uint32_t offset = module.firstOffset(typeId);
+				pushConstants.stageFlags = module.stage;
+				pushConstants.offset = offset;
+				pushConstants.size = module.sizeOf(typeId) - offset;
+				continue;
+			}
+
+			if (storageClass != StorageClassUniformConstant && storageClass != StorageClassUniform && storageClass != StorageClassStorageBuffer) {
+				continue;
+			}
+			if (!variable.has(DecorationBinding)) {
+				continue;
+			}
+
+			Binding binding{};
+			binding.layoutBinding.binding = variable.get(DecorationBinding);
+			binding.layoutBinding.stageFlags = module.stage;
+			binding.layoutBinding.descriptorCount = 1;
+
+			// arrays of descriptors, a runtime sized one gets a count of 0
+			const Id* type = &module[typeId];
+			if (type->opcode == OpTypeArray) {
+				binding.layoutBinding.descriptorCount = module.constantValue(type->operands[2]);
+				typeId = type->operands[1];
+				type = &module[typeId];
+			}
+			else if (type->opcode == OpTypeRuntimeArray) {
+				binding.layoutBinding.descriptorCount = 0;
+				typeId = type->operands[1];
+				type = &module[typeId];
+			}
+
+			switch (type->opcode) {
+			case OpTypeSampledImage:
+				binding.layoutBinding.descriptorType = module[type->operands[1]].operands[2] == DimBuffer
+					? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER
+					: VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				break;
+			case OpTypeImage: {
+				uint32_t dim = type->operands[2];
+				bool storage = type->operands[6] == 2;
+				if (dim == DimSubpassData) {
+					binding.layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+				}
+				else if (dim == DimBuffer) {
+					binding.layoutBinding.descriptorType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+				}
+				else {
+					binding.layoutBinding.descriptorType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+				}
+				break;
+			}
+			case OpTypeSampler:
+				binding.layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+				break;
+			case OpTypeAccelerationStructureKHR:
+				binding.layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+				break;
+			case OpTypeStruct:
+				// older glslang marks storage buffers as DecorationBufferBlock in the StorageClassUniform storage class
+				binding.layoutBinding.descriptorType = storageClass == StorageClassStorageBuffer || type->has(DecorationBufferBlock)
+					? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+					: VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+				binding.blockSize = module.sizeOf(typeId);
+				break;
+			default:
+				throw std::runtime_error("unsupported descriptor type in SPIR-V");
+			}
+
+			sets[variable.get(DecorationDescriptorSet)][binding.layoutBinding.binding] = binding;
+		}
+
+		std::sort(vertexInputs.begin(), vertexInputs.end(), [](const VertexInput& a, const VertexInput& b) {
+			return a.location < b.location;
+		});
+	}
+
+	VaShaderReflection VaShaderReflection::fromFiles(const std::vector<std::string>& filepaths) {
+		VaShaderReflection reflection{};
+		for (const auto& filepath : filepaths) {
+			reflection.merge(VaShaderReflection{ VaPipeline::readFile(filepath) });
+		}
+		return reflection;
+	}
+
+	void VaShaderReflection::merge(const VaShaderReflection& other) {
+		stages |= other.stages;
+
+		for (const auto& [set, bindings] : other.sets) {
+			for (const auto& [index, binding] : bindings) {
+				auto [existing, inserted] = sets[set].emplace(index, binding);
+				if (inserted) {
+					continue;
+				}
+				if (existing->second.layoutBinding.descriptorType != binding.layoutBinding.descriptorType) {
+					throw std::runtime_error("shader stages disagree on the type of set " + std::to_string(set) +
+						" binding " + std::to_string(index));
+				}
+				existing->second.layoutBinding.stageFlags |= binding.layoutBinding.stageFlags;
+				existing->second.layoutBinding.descriptorCount = std::max(existing->second.layoutBinding.descriptorCount, binding.layoutBinding.descriptorCount);
+				existing->second.blockSize = std::max(existing->second.blockSize, binding.blockSize);
+			}
+		}
+
+		if (other.pushConstants.size > 0) {
+			if (pushConstants.size == 0) {
+				pushConstants = other.pushConstants;
+			}
+			else {
+				// one range for everything keeps vkCmdPushConstants simple, every push names all the stages
+				uint32_t begin = std::min(pushConstants.offset, other.pushConstants.offset);
+				uint32_t end = std::max(pushConstants.offset + pushConstants.size, other.pushConstants.offset + other.pushConstants.size);
+				pushConstants.stageFlags |= other.pushConstants.stageFlags;
+				pushConstants.offset = begin;
+				pushConstants.size = end - begin;
+			}
+		}
+
+		if (!other.vertexInputs.empty()) {
+			vertexInputs = other.vertexInputs;
+		}
+		specConstants.insert(other.specConstants.begin(), other.specConstants.end());
+	}
+
+	std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> VaShaderReflection::getSetBindings(uint32_t set) const {
+		std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings;
+		auto found = sets.find(set);
+		if (found != sets.end()) {
+			for (const auto& [index, binding] : found->second) {
+				bindings[index] = binding.layoutBinding;
+			}
+		}
+		return bindings;
+	}
+
+	std::vector<VkPushConstantRange> VaShaderReflection::getPushConstantRanges() const {
+		if (pushConstants.size == 0) {
+			return {};
+		}
+		return { pushConstants };
+	}
+
+	std::vector<VkVertexInputAttributeDescription> VaShaderReflection::selectAttributes(
+		const std::vector<VkVertexInputAttributeDescription>& available) const {
+		std::vector<VkVertexInputAttributeDescription> selected;
+		for (const auto& input : vertexInputs) {
+			auto attribute = std::find_if(available.begin(), available.end(), [&](const VkVertexInputAttributeDescription& candidate) {
+				return candidate.location == input.location;
+			});
+			if (attribute == available.end()) {
+				throw std::runtime_error("vertex shader reads location " + std::to_string(input.location) + ", which the vertex doesn't have");
+			}
+			if (input.format != VK_FORMAT_UNDEFINED && attribute->format != input.format) {
+				throw std::runtime_error("vertex shader reads location " + std::to_string(input.location) + " with a different format than the vertex has");
+			}
+			selected.push_back(*attribute);
+		}
+		return selected;
+	}
+
+	void VaShaderReflection::checkSet(uint32_t set, const VaDescriptorSetLayout& layout) const {
+		auto found = sets.find(set);
+		if (found == sets.end()) {
+			return;
+		}
+		const auto& layoutBindings = layout.getBindings();
+		for (const auto& [index, binding] : found->second) {
+			std::string where = "set " + std::to_string(set) + " binding " + std::to_string(index);
+			auto layoutBinding = layoutBindings.find(index);
+			if (layoutBinding == layoutBindings.end()) {
+				throw std::runtime_error("shader uses " + where + ", which its layout doesn't have");
+			}
+			if (!sameType(layoutBinding->second.descriptorType, binding.layoutBinding.descriptorType)) {
+				throw std::runtime_error("shader uses " + where + " as a different descriptor type than its layout");
+			}
+			if ((layoutBinding->second.stageFlags & binding.layoutBinding.stageFlags) != binding.layoutBinding.stageFlags) {
+				throw std::runtime_error("shader uses " + where + " in a stage its layout doesn't give it to");
+			}
+			if (binding.layoutBinding.descriptorCount > layoutBinding->second.descriptorCount) {
+				throw std::runtime_error("shader uses more descriptors at " + where + " than its layout has");
+			}
+		}
+	}
+
+	void VaShaderReflection::checkBlockSize(uint32_t set, uint32_t binding, size_t size) const {
+		auto found = sets.find(set);
+		if (found == sets.end() || found->second.count(binding) == 0) {
+			return;
+		}
+		// a trailing vec3 leaves the block 4 bytes short of the alignas(16) struct on the c++ side, that's fine
+		uint32_t blockSize = found->second.at(binding).blockSize;
+		if (blockSize != 0 && (blockSize > size || size - blockSize >= 16)) {
+			throw std::runtime_error("shader's block at set " + std::to_string(set) + " binding " + std::to_string(binding) +
+				" is " + std::to_string(blockSize) + " bytes, the c++ side is " + std::to_string(size));
+		}
+	}
+
+	void VaShaderReflection::checkSpecConstant(uint32_t constantId) const {
+		if (specConstants.count(constantId) == 0) {
+			throw std::runtime_error("shaders don't declare constant_id " + std::to_string(constantId) +
+				", the .spv is probably older than its source");
+		}
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace va {
+	class VaDescriptorSetLayout;
+
+	// What a pipeline's shaders actually declare, read straight out of their SPIR-V: descriptor bindings per set,
+	// the push constant block and the vertex shader's inputs. Only the handful of instructions that describe the
+	// interface get looked at, there's no validation of the module beyond that.
+	//
+	// Reflection can't tell a dynamic buffer from a regular one, or how big a runtime sized array should be, so sets
+	// like those keep coming from a layout built by hand and get checked against the shaders with checkSet() instead.
+	class VaShaderReflection {
+	public:
+		struct Binding {
+			VkDescriptorSetLayoutBinding layoutBinding{};
+			// of a uniform or storage block, 0 for anything else. A runtime sized array at the end doesn't count
+			uint32_t blockSize = 0;
+		};
+
+		struct VertexInput {
+			uint32_t location;
+			VkFormat format;
+		};
+
+		VaShaderReflection() = default;
+		// one stage's SPIR-V, throws if it isn't any
+		explicit VaShaderReflection(const std::vector<char>& code);
+		// every stage of a pipeline merged together, filepaths relative to the project root like VaPipeline takes them
+		static VaShaderReflection fromFiles(const std::vector<std::string>& filepaths);
+
+		// bindings both declare get both stages, the push constant blocks become one range covering both
+		void merge(const VaShaderReflection& other);
+
+		VkShaderStageFlags getStages() const { return stages; }
+		const std::map<uint32_t, std::map<uint32_t, Binding>>& getSets() const { return sets; }
+		// in the form VaDescriptorSetLayout takes them, empty for a set nothing uses
+		std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> getSetBindings(uint32_t set) const;
+		// zero or one range, with every stage that declares a push constant block
+		std::vector<VkPushConstantRange> getPushConstantRanges() const;
+		const std::vector<VertexInput>& getVertexInputs() const { return vertexInputs; }
+
+		// the attributes out of `available` the vertex shader reads. Throws if it reads a location that isn't there,
+		// or is there with a different format
+		std::vector<VkVertexInputAttributeDescription> selectAttributes(
+			const std::vector<VkVertexInputAttributeDescription>& available) const;
+		// throws if the shaders use something in the set the layout doesn't have, or have it as a different type.
+		// A dynamic buffer in the layout counts as the same as a regular one
+		void checkSet(uint32_t set, const VaDescriptorSetLayout& layout) const;
+		// throws if the uniform or storage block at set/binding doesn't match a `size` byte struct (give or take the
+		// padding at its end), for catching a shader's copy of a struct drifting away from the c++ one
+		void checkBlockSize(uint32_t set, uint32_t binding, size_t size) const;
+		// throws if no stage declares the constant_id, a specialization for it would just be ignored
+		void checkSpecConstant(uint32_t constantId) const;
+
+	private:
+		VkShaderStageFlags stages = 0;
+		std::map<uint32_t, std::map<uint32_t, Binding>> sets;
+		// size 0 when there's no push constant block
+		VkPushConstantRange pushConstants{};
+		std::vector<VertexInput> vertexInputs;
+		std::set<uint32_t> specConstants;
+	};
+}
@@ -0,0 +1,151 @@
+#include "va_shader_watcher.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <set>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifndef FILE_DIR
+#define FILE_DIR "../../../"
+#endif
+
+namespace va {
+	VaShaderWatcher::VaShaderWatcher(VaDevice& device) : vaDevice{ device } {
+		if (isSupported()) {
+			watcher = std::thread([this]() { watchLoop(); });
+		}
+	}
+
+	VaShaderWatcher::~VaShaderWatcher() {
+		stopping = true;
+		if (watcher.joinable()) {
+			watcher.join();
+		}
+	}
+
+	bool VaShaderWatcher::isSupported() {
+#ifdef GLSLC_PATH
+		return std::filesystem::is_directory(FILE_DIR "shaders");
+#else
+		return false;
+#endif
+	}
+
+	void VaShaderWatcher::watchLoop() {
+#ifdef __linux__
+		int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		// editors either write the file in place or write a new one and rename it over the old
+		if (fd < 0 || inotify_add_watch(fd, FILE_DIR "shaders", IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+			std::cerr << "failed to watch shaders/, shader reloading is off\n";
+			if (fd >= 0) {
+				close(fd);
+			}
+			return;
+		}
+
+		alignas(inotify_event) char buffer[4096];
+		auto drain = [&](std::set<std::string>& changed) {
+			ssize_t length;
+			while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+				for (char* next = buffer; next < buffer + length;) {
+					auto* event = reinterpret_cast<inotify_event*>(next);
+					if (event->len > 0) {
+						changed.insert(event->name);
+					}
+					next += sizeof(inotify_event) + event->len;
+				}
+			}
+		};
+
+		while (!stopping) {
+			pollfd watched{ fd, POLLIN, 0 };
+			if (::poll(&watched, 1, POLL_INTERVAL_MS) <= 0) {
+				continue;
+			}
+
+			std::set<std::string> changed;
+			drain(changed);
+			// one save can be several events, give the editor a moment to finish so it only compiles once
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			drain(changed);
+			for (const auto& name : changed) {
+				recompile(name);
+			}
+		}
+		close(fd);
+#else
+		std::unordered_map<std::string, std::filesystem::file_time_type> writeTimes;
+		bool first = true;
+		while (!stopping) {
+			std::error_code error;
+			for (const auto& entry : std::filesystem::directory_iterator(FILE_DIR "shaders", error)) {
+				std::string name = entry.path().filename().string();
+				auto writeTime = entry.last_write_time(error);
+				if (error) {
+					continue;
+				}
+				auto known = writeTimes.find(name);
+				bool changed = !first && (known == writeTimes.end() || known->second != writeTime);
+				writeTimes[name] = writeTime;
+				if (changed) {
+					recompile(name);
+				}
+			}
+			first = false;
+			std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL_MS));
+		}
+#endif
+	}
+
+	void VaShaderWatcher::recompile(const std::string& name) {
+#ifdef GLSLC_PATH
+		// the name ends up in a shell command line, so anything but a plain [A-Za-z0-9_.-] file name is ignored
+		bool plain = !name.empty() && std::all_of(name.begin(), name.end(), [](char c) {
+			return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.' || c == '-';
+		});
+		std::filesystem::path source{ name };
+		std::string stage = source.extension().string();
+		if (!plain || (stage != ".vert" && stage != ".frag")) {
+			return;
+		}
+		stage = stage.substr(1);
+		std::string stem = source.stem().string();
+		std::string binary = "shaders/" + (stem == "shader" ? stage : stem + "_" + stage) + ".spv";
+
+		// compiled next to it and renamed over it, so nobody reads a half written module
+		std::string temp = FILE_DIR + binary + ".tmp";
+		std::string command = "\"" GLSLC_PATH "\" \"" FILE_DIR "shaders/" + name + "\" -o \"" + temp + "\"";
+#ifdef _WIN32
+		// cmd strips the outer pair of quotes
+		command = "\"" + command + "\"";
+#endif
+		// glslc prints its own errors
+		if (std::system(command.c_str()) != 0) {
+			std::cerr << "failed to compile shaders/" << name << ", keeping the old " << binary << '\n';
+			std::error_code error;
+			std::filesystem::remove(temp, error);
+			return;
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temp, FILE_DIR + binary, error);
+		if (error) {
+			std::cerr << "failed to replace " << binary << ": " << error.message() << '\n';
+			return;
+		}
+		vaDevice.shaderModules().invalidate(binary);
+		std::cout << "reloaded shaders/" << name << '\n';
+#else
+		(void)name;
+#endif
+	}
+}
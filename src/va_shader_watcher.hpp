@@ -0,0 +1,38 @@
+#pragma once
+
+#include "va_device.hpp"
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+namespace va {
+	// Recompiles shaders/*.vert and *.frag as they get saved, on a thread of its own, and tells the device's shader
+	// module cache about the new SPIR-V. Pipelines built from it notice on their next isReady() and rebuild in the
+	// background, so nothing has to wait for the device to go idle.
+	//
+	// Uses inotify on linux and checks modification times every so often everywhere else. Does nothing unless the
+	// build found glslc (GLSLC_PATH), the output names follow the same rules as the build's.
+	class VaShaderWatcher {
+	public:
+		// how long the watching thread waits between checks, and how long stopping it can take
+		static constexpr int POLL_INTERVAL_MS = 250;
+
+		explicit VaShaderWatcher(VaDevice& device);
+		~VaShaderWatcher();
+
+		VaShaderWatcher(const VaShaderWatcher&) = delete;
+		VaShaderWatcher& operator=(const VaShaderWatcher&) = delete;
+
+		static bool isSupported();
+
+	private:
+		void watchLoop();
+		// name is a file in shaders/, anything that isn't a .vert or .frag is ignored
+		void recompile(const std::string& name);
+
+		VaDevice& vaDevice;
+		std::thread watcher;
+		std::atomic<bool> stopping{ false };
+	};
+}
@@ -32,33 +32,52 @@ void VaSwapChain::init() {
 }
 
 VaSwapChain::~VaSwapChain() {
-  for (auto imageView : swapChainImageViews) {
-    vkDestroyImageView(device.device(), imageView, nullptr);
-  }
-  swapChainImageViews.clear();
+  // after a resize the old swap chain goes away while frames rendered with it can still be in flight,
+  // so everything is handed to the deletion queue instead of waiting for the device to idle. The frame
+  // fences only cover rendering, not the present that follows it, so the swap chain waits out another
+  // round of frames on top of that before it's destroyed
+  device.deletionQueue().push([
+      vaDevice = &device,
+      vkDevice = device.device(),
+      swapChain = swapChain,
+      imageViews = std::move(swapChainImageViews),
+      depthImages = std::move(depthImages),
+      depthImageMemorys = std::move(depthImageMemorys),
+      depthImageViews = std::move(depthImageViews),
+      framebuffers = std::move(swapChainFramebuffers),
+      renderPass = renderPass,
+      renderFinishedSemaphores = std::move(renderFinishedSemaphores),
+      imageAvailableSemaphores = std::move(imageAvailableSemaphores),
+      inFlightFences = std::move(inFlightFences)]() {
+    for (auto imageView : imageViews) {
+      vkDestroyImageView(vkDevice, imageView, nullptr);
+    }
 
-  if (swapChain != nullptr) {
-    vkDestroySwapchainKHR(device.device(), swapChain, nullptr);
-    swapChain = nullptr;
-  }
+    if (swapChain != nullptr) {
+      vkDestroySwapchainKHR(vkDevice, swapChain, nullptr);
+    }
 
-  for (int i = 0; i < depthImages.size(); i++) {
-    vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
-    vkDestroyImage(device.device(), depthImages[i], nullptr);
-    vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
-  }
+    for (int i = 0; i < depthImages.size(); i++) {
+      vkDestroyImageView(vkDevice, depthImageViews[i], nullptr);
+      vkDestroyImage(vkDevice, depthImages[i], nullptr);
+      vaDevice->freeMemory(depthImageMemorys[i]);
+    }
 
-  for (auto framebuffer : swapChainFramebuffers) {
-    vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
-  }
+    for (auto framebuffer : framebuffers) {
+      vkDestroyFramebuffer(vkDevice, framebuffer, nullptr);
+    }
 
-  vkDestroyRenderPass(device.device(), renderPass, nullptr);
+    vaDevice->pipelineStates().forget((uint64_t)(renderPass));
+    vkDestroyRenderPass(vkDevice, renderPass, nullptr);
 
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-    vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
-    vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
-    vkDestroyFence(device.device(), inFlightFences[i], nullptr);
-  }
+    // empty when they've been passed on to the swap chain that replaced this one
+    for (size_t i = 0; i < inFlightFences.size(); i++) {
+      vkDestroySemaphore(vkDevice, renderFinishedSemaphores[i], nullptr);
+      vkDestroySemaphore(vkDevice, imageAvailableSemaphores[i], nullptr);
+      vkDestroyFence(vkDevice, inFlightFences[i], nullptr);
+    }
+  }, MAX_FRAMES_IN_FLIGHT);
+  swapChain = nullptr;
 }
 
 VkResult VaSwapChain::acquireNextImage(uint32_t *imageIndex) {
@@ -265,6 +284,7 @@ void VaSwapChain::createRenderPass() {
   if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
     throw std::runtime_error("failed to create render pass!");
   }
+  device.pipelineStates().describeRenderPass(renderPass, renderPassInfo);
 }
 
 void VaSwapChain::createFramebuffers() {
@@ -342,10 +362,21 @@ void VaSwapChain::createDepthResources() {
 }
 
 void VaSwapChain::createSyncObjects() {
+  imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+
+  // frames still in flight on the old swap chain signal these fences, so keep using them. Otherwise
+  // waiting on a fresh, already signaled fence would say nothing about those frames having finished
+  if (oldSwapChain != nullptr) {
+    imageAvailableSemaphores.swap(oldSwapChain->imageAvailableSemaphores);
+    renderFinishedSemaphores.swap(oldSwapChain->renderFinishedSemaphores);
+    inFlightFences.swap(oldSwapChain->inFlightFences);
+    currentFrame = oldSwapChain->currentFrame;
+    return;
+  }
+
   imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-  imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
 
   VkSemaphoreCreateInfo semaphoreInfo = {};
   semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
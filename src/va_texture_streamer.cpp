@@ -0,0 +1,245 @@
+#include "va_texture_streamer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+namespace va {
+	VaTextureStreamer::VaTextureStreamer(VaDevice& device, VkDeviceSize budget)
+		: vaDevice{ device }, budget{ budget } {}
+
+	std::vector<std::shared_ptr<VaImage>> VaTextureStreamer::createImagesFromFiles(const std::vector<std::string>& filepaths) {
+		std::vector<std::future<VaKtxTexture>> loads;
+		loads.reserve(filepaths.size());
+		for (const auto& filepath : filepaths) {
+			loads.push_back(vaDevice.threadPool().submit([device = &vaDevice, filepath]() {
+				return VaImage::loadTextureData(*device, filepath);
+			}));
+		}
+
+		std::vector<std::shared_ptr<VaImage>> images;
+		images.reserve(filepaths.size());
+		for (size_t i = 0; i < loads.size(); i++) {
+			VaKtxTexture texture = loads[i].get();
+
+			uint32_t firstMip = std::min(VaImage::finestSampledMip(texture.levelCount) + STREAMED_MIPS, texture.levelCount - 1);
+
+			auto image = std::make_shared<VaImage>(vaDevice, texture, firstMip);
+			// anything bigger than a couple of texels has to have a level left for update() to bring in
+			assert((firstMip > image->getFinestSampledMip() || firstMip + 1 == texture.levelCount)
+				&& "streamed image starts with nothing left to stream in");
+			Entry entry{};
+			entry.image = image;
+			entry.filepath = filepaths[i];
+			entry.desiredMip = firstMip;
+			entries.push_back(std::move(entry));
+			images.push_back(std::move(image));
+		}
+		return images;
+	}
+
+	bool VaTextureStreamer::update(VkCommandBuffer commandBuffer, const VaCamera& camera, float viewportHeight, VaGameObject::Map& gameObjects) {
+		// nothing left holding these, a load that's still going just gets its result thrown away
+		entries.erase(std::remove_if(entries.begin(), entries.end(), [](const Entry& entry) {
+			return entry.image.expired();
+		}), entries.end());
+
+		glm::vec3 cameraPosition{ glm::inverse(camera.getView())[3] };
+		// world size of a pixel one unit in front of the camera, [1][1] of the projection is 1 / tan(fov / 2)
+		float pixelScale = 2.0f / (camera.getProjection()[1][1] * viewportHeight);
+
+		// every texture wants its coarsest mip unless something on screen says otherwise
+		std::vector<std::shared_ptr<VaImage>> images;
+		images.reserve(entries.size());
+		for (auto& entry : entries) {
+			images.push_back(entry.image.lock());
+			entry.desiredMip = images.back()->getFullMipLevels() - 1;
+		}
+
+		for (auto& [id, gameObject] : gameObjects) {
+			for (const VaImage* used : { gameObject.texture.get(), gameObject.terrainMaterials.get(), gameObject.terrainSplatMap.get() }) {
+				if (used == nullptr) {
+					continue;
+				}
+				for (size_t i = 0; i < entries.size(); i++) {
+					if (images[i].get() == used) {
+						entries[i].desiredMip = std::min(entries[i].desiredMip, estimateMip(*used, gameObject, cameraPosition, pixelScale));
+					}
+				}
+			}
+		}
+
+		for (size_t i = 0; i < entries.size(); i++) {
+			entries[i].desiredMip = std::max(entries[i].desiredMip, images[i]->getFinestSampledMip());
+		}
+
+		uint64_t evictedBefore = evicted;
+		bool changed = false;
+
+		// finished loads go up first, a few per frame so a burst of them doesn't hitch
+		uint32_t uploads = 0;
+		for (size_t i = 0; i < entries.size() && uploads < MAX_UPLOADS_PER_FRAME; i++) {
+			Entry& entry = entries[i];
+			if (!entry.pending.valid() || entry.pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				continue;
+			}
+
+			VaKtxTexture texture;
+			try {
+				texture = entry.pending.get();
+			}
+			catch (const std::exception& e) {
+				std::cerr << "failed to stream " << entry.filepath << ": " << e.what() << '\n';
+				entry.failed = true;
+				continue;
+			}
+
+			// the camera might have moved off while it was loading
+			VaImage& image = *images[i];
+			if (entry.desiredMip >= image.getResidentMip() || texture.levelCount != image.getFullMipLevels()) {
+				continue;
+			}
+
+			VkDeviceSize extra = image.residentBytesFrom(entry.desiredMip) - image.getResidentBytes();
+			if (!evict(extra, commandBuffer)) {
+				continue;
+			}
+
+			image.setResidentMip(entry.desiredMip, &texture, commandBuffer);
+			streamedIn++;
+			uploads++;
+			changed = true;
+		}
+
+		// wants can drop as the camera moves, so something could be over budget without any new load coming in
+		evict(0, commandBuffer);
+
+		uint32_t pendingLoads = 0;
+		for (const auto& entry : entries) {
+			pendingLoads += entry.pending.valid() ? 1 : 0;
+		}
+
+		for (size_t i = 0; i < entries.size() && pendingLoads < MAX_PENDING_LOADS; i++) {
+			Entry& entry = entries[i];
+			if (entry.failed || entry.pending.valid() || entry.desiredMip >= images[i]->getResidentMip()) {
+				continue;
+			}
+
+			// the cpu side is cheap to get again, it comes straight out of the .ktx2 or the mip cache
+			entry.pending = vaDevice.threadPool().submit([device = &vaDevice, filepath = entry.filepath]() {
+				return VaImage::loadTextureData(*device, filepath);
+			});
+			pendingLoads++;
+		}
+
+		return changed || evicted != evictedBefore;
+	}
+
+	uint32_t VaTextureStreamer::estimateMip(const VaImage& image, VaGameObject& gameObject, const glm::vec3& cameraPosition,
+		float pixelScale) const {
+		uint32_t coarsest = image.getFullMipLevels() - 1;
+		if (gameObject.model == nullptr || gameObject.model->getUvDensity() <= 0.0f) {
+			return coarsest;
+		}
+
+		// distance to the closest point of the world space bounds, 0 from inside
+		glm::mat4 transform = gameObject.transform.mat4();
+		glm::vec3 boundsMin = gameObject.model->getBoundsMin();
+		glm::vec3 boundsMax = gameObject.model->getBoundsMax();
+		glm::vec3 worldMin{ FLT_MAX };
+		glm::vec3 worldMax{ -FLT_MAX };
+		for (int i = 0; i < 8; i++) {
+			glm::vec3 corner{
+				(i & 1) ? boundsMax.x : boundsMin.x,
+				(i & 2) ? boundsMax.y : boundsMin.y,
+				(i & 4) ? boundsMax.z : boundsMin.z
+			};
+			glm::vec3 world{ transform * glm::vec4{ corner, 1.0f } };
+			worldMin = glm::min(worldMin, world);
+			worldMax = glm::max(worldMax, world);
+		}
+		float distance = glm::length(cameraPosition - glm::min(glm::max(cameraPosition, worldMin), worldMax));
+
+		// a texel of mip 0 against a pixel at that distance, every mip down doubles the texel size
+		float worldPerRepeat = gameObject.model->getUvDensity() * gameObject.transform.scale / gameObject.uvScale;
+		float texelSize = worldPerRepeat / static_cast<float>(std::max(image.getWidth(), image.getHeight()));
+		float pixelSize = distance * pixelScale;
+		if (pixelSize <= texelSize) {
+			return 0;
+		}
+
+		float mip = std::floor(std::log2(pixelSize / texelSize));
+		return std::min(static_cast<uint32_t>(mip), coarsest);
+	}
+
+	VkDeviceSize VaTextureStreamer::residentBytes() const {
+		VkDeviceSize bytes = 0;
+		for (const auto& entry : entries) {
+			if (auto image = entry.image.lock()) {
+				bytes += image->getResidentBytes();
+			}
+		}
+		return bytes;
+	}
+
+	bool VaTextureStreamer::evict(VkDeviceSize bytesNeeded, VkCommandBuffer commandBuffer) {
+		VkDeviceSize resident = residentBytes();
+		while (resident + bytesNeeded > budget) {
+			// whichever texture frees the most by dropping to what it actually wants
+			std::shared_ptr<VaImage> victim;
+			uint32_t victimMip = 0;
+			VkDeviceSize victimSaving = 0;
+			for (const auto& entry : entries) {
+				auto image = entry.image.lock();
+				if (!image || entry.desiredMip <= image->getResidentMip()) {
+					continue;
+				}
+				VkDeviceSize saving = image->getResidentBytes() - image->residentBytesFrom(entry.desiredMip);
+				if (saving > victimSaving) {
+					victim = image;
+					victimMip = entry.desiredMip;
+					victimSaving = saving;
+				}
+			}
+
+			if (!victim) {
+				return false;
+			}
+
+			victim->setResidentMip(victimMip, nullptr, commandBuffer);
+			resident -= victimSaving;
+			evicted++;
+		}
+		return true;
+	}
+
+	VaTextureStreamer::Stats VaTextureStreamer::getStats() const {
+		Stats stats{};
+		stats.residentBytes = residentBytes();
+		stats.budget = budget;
+		stats.streamedIn = streamedIn;
+		stats.evicted = evicted;
+		for (const auto& entry : entries) {
+			stats.textures += entry.image.expired() ? 0 : 1;
+			stats.pendingLoads += entry.pending.valid() ? 1 : 0;
+		}
+		return stats;
+	}
+
+	std::string VaTextureStreamer::summary() const {
+		Stats current = getStats();
+		char buffer[256];
+		snprintf(buffer, sizeof(buffer), "texture streaming: %u textures, %.1f / %.1f MiB resident | %llu streamed in, %llu evicted, %u loading",
+			current.textures,
+			static_cast<double>(current.residentBytes) / (1024.0 * 1024.0),
+			static_cast<double>(current.budget) / (1024.0 * 1024.0),
+			static_cast<unsigned long long>(current.streamedIn),
+			static_cast<unsigned long long>(current.evicted),
+			current.pendingLoads);
+		return buffer;
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "va_device.hpp"
+#include "va_camera.hpp"
+#include "va_game_object.hpp"
+#include "va_image.hpp"
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace va {
+	// Keeps textures at only the mips the camera actually needs. Images start out with just their small mips on the
+	// gpu, then every frame the wanted mip for each texture is worked out from how far away the objects using it are
+	// and how densely their uvs cover the surface. Finer mips load in the background and go up a few per frame, and
+	// when the budget runs out the textures holding more detail than they need get cut back down.
+	class VaTextureStreamer {
+	public:
+		// total gpu memory streamed textures are allowed to take up
+		static constexpr VkDeviceSize DEFAULT_BUDGET = 256ull * 1024 * 1024;
+		// images start this many mips coarser than the finest one their sampler reads, so there's always something
+		// left to stream in and nothing goes up that never gets sampled. A 1024x1024 texture starts at 8x8 and
+		// streams up to 32x32
+		static constexpr uint32_t STREAMED_MIPS = 2;
+		static constexpr uint32_t MAX_UPLOADS_PER_FRAME = 1;
+		static constexpr uint32_t MAX_PENDING_LOADS = 2;
+
+		struct Stats {
+			uint32_t textures = 0;
+			uint32_t pendingLoads = 0;
+			VkDeviceSize residentBytes = 0;
+			VkDeviceSize budget = 0;
+			uint64_t streamedIn = 0;
+			uint64_t evicted = 0;
+		};
+
+		explicit VaTextureStreamer(VaDevice& device, VkDeviceSize budget = DEFAULT_BUDGET);
+
+		VaTextureStreamer(const VaTextureStreamer&) = delete;
+		VaTextureStreamer& operator=(const VaTextureStreamer&) = delete;
+
+		// same as VaImage::createImagesFromFiles, except the images only get their small mips to begin with and are
+		// streamed from then on
+		std::vector<std::shared_ptr<VaImage>> createImagesFromFiles(const std::vector<std::string>& filepaths);
+
+		// call once the frame's command buffer has begun, before the render pass. The mip changes get recorded into
+		// it instead of stalling on a submit of their own. Returns true if any image got swapped out, which means
+		// descriptor sets pointing at streamed images need to be rewritten before they're used again
+		bool update(VkCommandBuffer commandBuffer, const VaCamera& camera, float viewportHeight, VaGameObject::Map& gameObjects);
+
+		Stats getStats() const;
+		std::string summary() const;
+
+	private:
+		struct Entry {
+			std::weak_ptr<VaImage> image;
+			std::string filepath;
+			uint32_t desiredMip = 0;
+			// always the full chain, whatever mip it ends up going up at is decided once it's ready
+			std::future<VaKtxTexture> pending;
+			// a load that threw doesn't get retried every frame
+			bool failed = false;
+		};
+
+		uint32_t estimateMip(const VaImage& image, VaGameObject& gameObject, const glm::vec3& cameraPosition,
+			float pixelScale) const;
+		VkDeviceSize residentBytes() const;
+		// cuts textures holding finer mips than they want until at least bytesNeeded fits under the budget
+		bool evict(VkDeviceSize bytesNeeded, VkCommandBuffer commandBuffer);
+
+		VaDevice& vaDevice;
+		VkDeviceSize budget;
+		std::vector<Entry> entries;
+		uint64_t streamedIn = 0;
+		uint64_t evicted = 0;
+	};
+}
@@ -0,0 +1,96 @@
+#include "va_thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+namespace va {
+	VaThreadPool::VaThreadPool(uint32_t threadCount) {
+		if (threadCount == 0) {
+			uint32_t hardwareThreads = std::thread::hardware_concurrency();
+			threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+
+		workers.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++) {
+			workers.emplace_back([this]() { workerLoop(); });
+		}
+	}
+
+	VaThreadPool::~VaThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			stopping = true;
+		}
+		condition.notify_all();
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+
+	void VaThreadPool::enqueue(std::function<void()>&& task) {
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			tasks.push(std::move(task));
+		}
+		condition.notify_one();
+	}
+
+	void VaThreadPool::workerLoop() {
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock{ mutex };
+				condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+				if (stopping && tasks.empty()) {
+					return;
+				}
+				task = std::move(tasks.front());
+				tasks.pop();
+			}
+			task();
+		}
+	}
+
+	void VaThreadPool::parallelFor(uint32_t begin, uint32_t end, const std::function<void(uint32_t, uint32_t)>& body) {
+		if (begin >= end) {
+			return;
+		}
+
+		// a few chunks per thread so uneven rows still balance out
+		uint32_t count = end - begin;
+		uint32_t chunkCount = std::min(count, (size() + 1) * 4);
+		uint32_t chunkSize = (count + chunkCount - 1) / chunkCount;
+		chunkCount = (count + chunkSize - 1) / chunkSize;
+
+		struct Shared {
+			std::atomic<uint32_t> nextChunk{ 0 };
+			std::atomic<uint32_t> finishedChunks{ 0 };
+			std::mutex mutex;
+			std::condition_variable done;
+		};
+		auto shared = std::make_shared<Shared>();
+
+		auto work = [shared, &body, begin, end, chunkSize, chunkCount]() {
+			uint32_t chunk;
+			while ((chunk = shared->nextChunk.fetch_add(1)) < chunkCount) {
+				uint32_t chunkBegin = begin + chunk * chunkSize;
+				body(chunkBegin, std::min(chunkBegin + chunkSize, end));
+				if (shared->finishedChunks.fetch_add(1) + 1 == chunkCount) {
+					std::lock_guard<std::mutex> lock{ shared->mutex };
+					shared->done.notify_all();
+				}
+			}
+		};
+
+		// helpers that start after everything's been claimed just fall straight through, so capturing body by
+		// reference is fine, nothing touches it once the last chunk is done
+		uint32_t helpers = std::min(size(), chunkCount - 1);
+		for (uint32_t i = 0; i < helpers; i++) {
+			enqueue(work);
+		}
+		work();
+
+		std::unique_lock<std::mutex> lock{ shared->mutex };
+		shared->done.wait(lock, [&shared, chunkCount]() { return shared->finishedChunks.load() == chunkCount; });
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace va {
+	// Fixed set of worker threads for cpu side loading work (decoding, mip generation and the like)
+	class VaThreadPool {
+	public:
+		// 0 picks one less than the number of hardware threads, so the main thread still gets a core
+		explicit VaThreadPool(uint32_t threadCount = 0);
+		~VaThreadPool();
+
+		VaThreadPool(const VaThreadPool&) = delete;
+		VaThreadPool& operator=(const VaThreadPool&) = delete;
+
+		template<typename F>
+		auto submit(F&& task) -> std::future<decltype(task())> {
+			using Result = decltype(task());
+			auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+			std::future<Result> result = packaged->get_future();
+			enqueue([packaged]() { (*packaged)(); });
+			return result;
+		}
+
+		// splits [begin, end) into chunks and runs them across the workers. The calling thread works through chunks
+		// too, so this is fine to call from inside a task without deadlocking the pool
+		void parallelFor(uint32_t begin, uint32_t end, const std::function<void(uint32_t, uint32_t)>& body);
+
+		uint32_t size() const { return static_cast<uint32_t>(workers.size()); }
+
+	private:
+		void enqueue(std::function<void()>&& task);
+		void workerLoop();
+
+		std::vector<std::thread> workers;
+		std::queue<std::function<void()>> tasks;
+		std::mutex mutex;
+		std::condition_variable condition;
+		bool stopping = false;
+	};
+}
@@ -0,0 +1,490 @@
+#include "va_virtual_texture.hpp"
+#include "va_hash.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace va {
+	static void imageBarrier(
+		VkCommandBuffer commandBuffer,
+		VkImage image,
+		uint32_t levelCount,
+		VkImageLayout oldLayout,
+		VkImageLayout newLayout,
+		VkAccessFlags srcAccess,
+		VkAccessFlags dstAccess,
+		VkPipelineStageFlags srcStage,
+		VkPipelineStageFlags dstStage
+	) {
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = levelCount;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+
+		vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	static void bufferBarrier(
+		VkCommandBuffer commandBuffer,
+		VkBuffer buffer,
+		VkAccessFlags srcAccess,
+		VkAccessFlags dstAccess,
+		VkPipelineStageFlags srcStage,
+		VkPipelineStageFlags dstStage
+	) {
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+
+		vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+
+	uint32_t VaVirtualTexture::mipCount() {
+		uint32_t count = 1;
+		for (uint32_t pages = VIRTUAL_PAGES; pages > 1; pages >>= 1) {
+			count++;
+		}
+		return count;
+	}
+
+	VaVirtualTexture::VaVirtualTexture(VaDevice& device, uint32_t frameCount, PageGenerator generator)
+		: vaDevice{ device }, generator{ std::move(generator) } {
+		if (!isSupported(device)) {
+			throw std::runtime_error("virtual texturing needs fragment shader stores");
+		}
+
+		for (uint32_t mip = 0; mip < mipCount(); mip++) {
+			uint32_t pages = VIRTUAL_PAGES >> mip;
+			mipOffsets.push_back(totalPages);
+			totalPages += pages * pages;
+		}
+		residency.assign(totalPages, NO_PAGE);
+		physicalPages.resize(PHYSICAL_PAGES * PHYSICAL_PAGES);
+
+		createImages();
+		createFeedback(frameCount);
+		createDescriptors(frameCount);
+	}
+
+	VaVirtualTexture::~VaVirtualTexture() {
+		// anything still generating holds onto the generator, let it finish before that goes away
+		for (auto& [page, texels] : pending) {
+			texels.wait();
+		}
+
+		vaDevice.deletionQueue().push([
+			device = &vaDevice,
+			pageTableView = pageTableView,
+			pageTableImage = pageTableImage,
+			pageTableMemory = pageTableMemory,
+			physicalView = physicalView,
+			physicalImage = physicalImage,
+			physicalMemory = physicalMemory
+		]() {
+			device->forgetDescriptorHandle(handleBits(pageTableView));
+			device->forgetDescriptorHandle(handleBits(physicalView));
+			vkDestroyImageView(device->device(), pageTableView, nullptr);
+			vkDestroyImage(device->device(), pageTableImage, nullptr);
+			device->freeMemory(pageTableMemory);
+			vkDestroyImageView(device->device(), physicalView, nullptr);
+			vkDestroyImage(device->device(), physicalImage, nullptr);
+			device->freeMemory(physicalMemory);
+		});
+	}
+
+	VaVirtualTexture::PageRegion VaVirtualTexture::regionOf(uint32_t virtualPage) const {
+		uint32_t mip = static_cast<uint32_t>(std::upper_bound(mipOffsets.begin(), mipOffsets.end(), virtualPage) - mipOffsets.begin()) - 1;
+		uint32_t pages = VIRTUAL_PAGES >> mip;
+		uint32_t local = virtualPage - mipOffsets[mip];
+
+		PageRegion region{};
+		region.mip = mip;
+		region.x0 = static_cast<int32_t>((local % pages) * PAGE_SIZE) - static_cast<int32_t>(PAGE_BORDER);
+		region.y0 = static_cast<int32_t>((local / pages) * PAGE_SIZE) - static_cast<int32_t>(PAGE_BORDER);
+		region.virtualSize = pages * PAGE_SIZE;
+		return region;
+	}
+
+	void VaVirtualTexture::createImages() {
+		auto createImage = [this](uint32_t size, uint32_t mipLevels, VkFormat format, VkImage& image, VkDeviceMemory& memory, VkImageView& view) {
+			VkImageCreateInfo imageInfo{};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.extent.width = size;
+			imageInfo.extent.height = size;
+			imageInfo.extent.depth = 1;
+			imageInfo.mipLevels = mipLevels;
+			imageInfo.arrayLayers = 1;
+			imageInfo.format = format;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			vaDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
+
+			VkImageViewCreateInfo viewInfo{};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = image;
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = format;
+			viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			viewInfo.subresourceRange.baseMipLevel = 0;
+			viewInfo.subresourceRange.levelCount = mipLevels;
+			viewInfo.subresourceRange.baseArrayLayer = 0;
+			viewInfo.subresourceRange.layerCount = 1;
+			if (vkCreateImageView(vaDevice.device(), &viewInfo, nullptr, &view) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create virtual texture image view");
+			}
+		};
+
+		// page table entries are x, y of the physical page and a resident flag in alpha
+		createImage(VIRTUAL_PAGES, mipCount(), VK_FORMAT_R8G8B8A8_UINT, pageTableImage, pageTableMemory, pageTableView);
+		createImage(PHYSICAL_PAGES * PHYSICAL_PAGE_SIZE, 1, VK_FORMAT_R8G8B8A8_SRGB, physicalImage, physicalMemory, physicalView);
+
+		// the last mip is a single page covering everything, it's what every lookup falls back to so it goes in
+		// first and never leaves
+		uint32_t lastPage = totalPages - 1;
+		Upload fallback{ 0, lastPage, std::vector<uint8_t>(PHYSICAL_PAGE_SIZE * PHYSICAL_PAGE_SIZE * 4) };
+		generator(regionOf(lastPage), fallback.texels.data());
+		physicalPages[0].virtualPage = lastPage;
+		residency[lastPage] = 0;
+		generated++;
+
+		VkCommandBuffer commandBuffer = vaDevice.beginSingleTimeCommands();
+		for (VkImage image : { pageTableImage, physicalImage }) {
+			imageBarrier(commandBuffer, image, VK_REMAINING_MIP_LEVELS,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				0, VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		}
+
+		VkClearColorValue empty{};
+		VkImageSubresourceRange range{ VK_IMAGE_ASPECT_COLOR_BIT, 0, mipCount(), 0, 1 };
+		vkCmdClearColorImage(commandBuffer, pageTableImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &empty, 1, &range);
+
+		for (VkImage image : { pageTableImage, physicalImage }) {
+			imageBarrier(commandBuffer, image, VK_REMAINING_MIP_LEVELS,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		}
+		upload(commandBuffer, { fallback }, {});
+		vaDevice.endSingleTimeCommands(commandBuffer);
+	}
+
+	void VaVirtualTexture::createFeedback(uint32_t frameCount) {
+		for (uint32_t i = 0; i < frameCount; i++) {
+			feedbackBuffers.push_back(std::make_unique<VaBuffer>(
+				vaDevice,
+				sizeof(uint32_t),
+				1 + MAX_FEEDBACK + totalPages,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+			));
+
+			// a slot that hasn't been through a frame yet reads back as no requests
+			auto readback = std::make_unique<VaBuffer>(
+				vaDevice,
+				sizeof(uint32_t),
+				1 + MAX_FEEDBACK,
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+			);
+			readback->map();
+			memset(readback->getMappedMemory(), 0, readback->getBufferSize());
+			readbackBuffers.push_back(std::move(readback));
+		}
+	}
+
+	void VaVirtualTexture::createDescriptors(uint32_t frameCount) {
+		setLayout = VaDescriptorSetLayout::Builder(vaDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) // page table
+			.addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) // physical pages
+			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // feedback
+			.build();
+
+		pool = VaDescriptorPool::Builder(vaDevice)
+			.setMaxSets(frameCount)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frameCount * 2)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frameCount)
+			.build();
+
+		// the page table is only ever texelFetched, and the atlas has no mips and does its own clamping per page
+		VaSamplerDesc pageTableDesc = vaDevice.samplerCache().describe(VaSamplerPreset::PixelArt);
+		pageTableDesc.anisotropyEnable = VK_FALSE;
+		VaSamplerDesc physicalDesc = vaDevice.samplerCache().describe(VaSamplerPreset::Linear);
+		physicalDesc.anisotropyEnable = VK_FALSE;
+		physicalDesc.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		physicalDesc.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		physicalDesc.maxLod = 0.0f;
+
+		VkDescriptorImageInfo pageTableInfo{ vaDevice.samplerCache().getSampler(pageTableDesc), pageTableView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		VkDescriptorImageInfo physicalInfo{ vaDevice.samplerCache().getSampler(physicalDesc), physicalView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+		descriptorSets.resize(frameCount);
+		for (uint32_t i = 0; i < frameCount; i++) {
+			auto feedbackInfo = feedbackBuffers[i]->descriptorInfo();
+			VaDescriptorWriter(*setLayout, *pool)
+				.writeImage(0, &pageTableInfo)
+				.writeImage(1, &physicalInfo)
+				.writeBuffer(2, &feedbackInfo)
+				.build(descriptorSets[i]);
+		}
+	}
+
+	void VaVirtualTexture::update(VkCommandBuffer commandBuffer, int frameIndex) {
+		frame++;
+
+		const uint32_t* feedback = static_cast<const uint32_t*>(readbackBuffers[frameIndex]->getMappedMemory());
+		uint32_t requestCount = std::min(feedback[0], MAX_FEEDBACK);
+
+		std::vector<uint32_t> missing;
+		for (uint32_t i = 0; i < requestCount; i++) {
+			uint32_t page = feedback[1 + i];
+			if (page >= totalPages) {
+				continue;
+			}
+			if (residency[page] == NO_PAGE && pending.count(page) == 0) {
+				missing.push_back(page);
+			}
+
+			// whatever the shader fell back to while the page isn't in got used too, so walk up the mips
+			for (uint32_t mip = regionOf(page).mip; ; mip++) {
+				if (residency[page] != NO_PAGE) {
+					physicalPages[residency[page]].lastUsed = frame;
+				}
+				if (mip + 1 >= mipCount()) {
+					break;
+				}
+				uint32_t pages = VIRTUAL_PAGES >> mip;
+				uint32_t local = page - mipOffsets[mip];
+				page = mipOffsets[mip + 1] + (local / pages / 2) * (pages / 2) + (local % pages) / 2;
+			}
+		}
+
+		// coarse pages first, they cover the most screen and everything finer falls back to them
+		std::sort(missing.begin(), missing.end(), [this](uint32_t a, uint32_t b) {
+			return regionOf(a).mip > regionOf(b).mip;
+		});
+		for (uint32_t page : missing) {
+			if (pending.size() >= MAX_PENDING_PAGES) {
+				break;
+			}
+			pending.emplace(page, vaDevice.threadPool().submit([this, page]() {
+				std::vector<uint8_t> texels(PHYSICAL_PAGE_SIZE * PHYSICAL_PAGE_SIZE * 4);
+				generator(regionOf(page), texels.data());
+				return texels;
+			}));
+		}
+
+		std::vector<Upload> uploads;
+		std::vector<uint32_t> evictedPages;
+		for (auto it = pending.begin(); it != pending.end() && uploads.size() < MAX_UPLOADS_PER_FRAME;) {
+			if (it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+				++it;
+				continue;
+			}
+
+			// everything in is still being looked at. The finished pages stay in pending, ready to go in as soon as
+			// something frees up, instead of being generated all over again
+			Upload upload{};
+			upload.physicalPage = allocatePhysicalPage();
+			if (upload.physicalPage == NO_PAGE) {
+				break;
+			}
+
+			upload.virtualPage = it->first;
+			try {
+				upload.texels = it->second.get();
+			}
+			catch (const std::exception& e) {
+				std::cerr << "failed to generate virtual texture page " << it->first << ": " << e.what() << '\n';
+				it = pending.erase(it);
+				continue;
+			}
+			it = pending.erase(it);
+
+			PhysicalPage& physical = physicalPages[upload.physicalPage];
+			if (physical.virtualPage != NO_PAGE) {
+				residency[physical.virtualPage] = NO_PAGE;
+				evictedPages.push_back(physical.virtualPage);
+				evicted++;
+			}
+			physical.virtualPage = upload.virtualPage;
+			physical.lastUsed = frame;
+			residency[upload.virtualPage] = upload.physicalPage;
+			generated++;
+			uploads.push_back(std::move(upload));
+		}
+
+		if (!uploads.empty()) {
+			upload(commandBuffer, uploads, evictedPages);
+		}
+
+		// the count and the once per page flags all start at 0 again for this frame
+		VkBuffer feedbackBuffer = feedbackBuffers[frameIndex]->getBuffer();
+		vkCmdFillBuffer(commandBuffer, feedbackBuffer, 0, VK_WHOLE_SIZE, 0);
+		bufferBarrier(commandBuffer, feedbackBuffer,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	}
+
+	void VaVirtualTexture::recordFeedbackReadback(VkCommandBuffer commandBuffer, int frameIndex) {
+		VkBuffer feedbackBuffer = feedbackBuffers[frameIndex]->getBuffer();
+		bufferBarrier(commandBuffer, feedbackBuffer,
+			VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		VkBufferCopy copy{};
+		copy.size = (1 + MAX_FEEDBACK) * sizeof(uint32_t);
+		vkCmdCopyBuffer(commandBuffer, feedbackBuffer, readbackBuffers[frameIndex]->getBuffer(), 1, &copy);
+
+		bufferBarrier(commandBuffer, readbackBuffers[frameIndex]->getBuffer(),
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT);
+	}
+
+	uint32_t VaVirtualTexture::allocatePhysicalPage() {
+		uint32_t lastPage = totalPages - 1;
+		uint32_t oldest = NO_PAGE;
+		for (uint32_t i = 0; i < physicalPages.size(); i++) {
+			const PhysicalPage& physical = physicalPages[i];
+			if (physical.virtualPage == NO_PAGE) {
+				return i;
+			}
+			if (physical.virtualPage == lastPage || physical.lastUsed >= frame) {
+				continue;
+			}
+			if (oldest == NO_PAGE || physical.lastUsed < physicalPages[oldest].lastUsed) {
+				oldest = i;
+			}
+		}
+		return oldest;
+	}
+
+	void VaVirtualTexture::upload(VkCommandBuffer commandBuffer, const std::vector<Upload>& uploads, const std::vector<uint32_t>& evictedPages) {
+		const VkDeviceSize pageBytes = PHYSICAL_PAGE_SIZE * PHYSICAL_PAGE_SIZE * 4;
+		const VkDeviceSize entriesOffset = pageBytes * uploads.size();
+
+		auto stagingBuffer = std::make_unique<VaBuffer>(
+			vaDevice,
+			entriesOffset + (uploads.size() + evictedPages.size()) * 4,
+			1,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+		);
+		stagingBuffer->map();
+
+		std::vector<VkBufferImageCopy> pageCopies;
+		std::vector<VkBufferImageCopy> entryCopies;
+		auto writeEntry = [&](uint32_t virtualPage, const uint8_t entry[4]) {
+			PageRegion region = regionOf(virtualPage);
+			VkDeviceSize offset = entriesOffset + entryCopies.size() * 4;
+			stagingBuffer->writeToBuffer(const_cast<uint8_t*>(entry), 4, offset);
+
+			VkBufferImageCopy copy{};
+			copy.bufferOffset = offset;
+			copy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, region.mip, 0, 1 };
+			copy.imageOffset = {
+				static_cast<int32_t>((region.x0 + static_cast<int32_t>(PAGE_BORDER)) / static_cast<int32_t>(PAGE_SIZE)),
+				static_cast<int32_t>((region.y0 + static_cast<int32_t>(PAGE_BORDER)) / static_cast<int32_t>(PAGE_SIZE)),
+				0
+			};
+			copy.imageExtent = { 1, 1, 1 };
+			entryCopies.push_back(copy);
+		};
+
+		for (const uint32_t virtualPage : evictedPages) {
+			const uint8_t entry[4] = { 0, 0, 0, 0 };
+			writeEntry(virtualPage, entry);
+		}
+
+		for (size_t i = 0; i < uploads.size(); i++) {
+			const Upload& page = uploads[i];
+			stagingBuffer->writeToBuffer(const_cast<uint8_t*>(page.texels.data()), pageBytes, pageBytes * i);
+
+			uint32_t physicalX = page.physicalPage % PHYSICAL_PAGES;
+			uint32_t physicalY = page.physicalPage / PHYSICAL_PAGES;
+			VkBufferImageCopy copy{};
+			copy.bufferOffset = pageBytes * i;
+			copy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			copy.imageOffset = { static_cast<int32_t>(physicalX * PHYSICAL_PAGE_SIZE), static_cast<int32_t>(physicalY * PHYSICAL_PAGE_SIZE), 0 };
+			copy.imageExtent = { PHYSICAL_PAGE_SIZE, PHYSICAL_PAGE_SIZE, 1 };
+			pageCopies.push_back(copy);
+
+			const uint8_t entry[4] = { static_cast<uint8_t>(physicalX), static_cast<uint8_t>(physicalY), 0, 1 };
+			writeEntry(page.virtualPage, entry);
+		}
+
+		// the barrier waits on every earlier fragment read, including whatever frame is still in flight, so pages
+		// can be written over in place
+		for (VkImage image : { pageTableImage, physicalImage }) {
+			imageBarrier(commandBuffer, image, VK_REMAINING_MIP_LEVELS,
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		}
+
+		if (!pageCopies.empty()) {
+			vkCmdCopyBufferToImage(commandBuffer, stagingBuffer->getBuffer(), physicalImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				static_cast<uint32_t>(pageCopies.size()), pageCopies.data());
+		}
+		if (!entryCopies.empty()) {
+			vkCmdCopyBufferToImage(commandBuffer, stagingBuffer->getBuffer(), pageTableImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				static_cast<uint32_t>(entryCopies.size()), entryCopies.data());
+		}
+
+		for (VkImage image : { pageTableImage, physicalImage }) {
+			imageBarrier(commandBuffer, image, VK_REMAINING_MIP_LEVELS,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		}
+		// the staging buffer goes back to the pool through the deletion queue, after the frame is done with it
+	}
+
+	VaVirtualTexture::Stats VaVirtualTexture::getStats() const {
+		Stats stats{};
+		stats.physicalPages = static_cast<uint32_t>(physicalPages.size());
+		for (const auto& physical : physicalPages) {
+			stats.residentPages += physical.virtualPage != NO_PAGE ? 1 : 0;
+		}
+		stats.pendingPages = static_cast<uint32_t>(pending.size());
+		stats.generated = generated;
+		stats.evicted = evicted;
+		return stats;
+	}
+
+	std::string VaVirtualTexture::summary() const {
+		Stats current = getStats();
+		char buffer[256];
+		snprintf(buffer, sizeof(buffer), "virtual texture: %u / %u pages resident | %llu generated, %llu evicted, %u generating",
+			current.residentPages,
+			current.physicalPages,
+			static_cast<unsigned long long>(current.generated),
+			static_cast<unsigned long long>(current.evicted),
+			current.pendingPages);
+		return buffer;
+	}
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "va_device.hpp"
+#include "va_descriptors.hpp"
+#include "va_buffer.hpp"
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace va {
+	// One huge texture that only ever has the pages something is actually looking at on the gpu. The virtual
+	// texture is split into PAGE_SIZE pages at every mip, and resident pages live somewhere in a fixed size atlas
+	// of physical pages, so the vram cost never changes no matter how big the virtual texture is. The page table
+	// (one texel per virtual page, mipped like the virtual texture) says where in the atlas each page is.
+	//
+	// Whatever draws with it appends the pages it wanted to that frame's feedback buffer, which gets copied back
+	// to the cpu at the end of the frame. Once the frame is done, update() reads that, generates the missing pages
+	// on the thread pool and swaps the least recently used ones out for them. Shaders fall back to the closest
+	// coarser page that's in, and the single page at the last mip is always in. Needs fragment shader stores for
+	// the feedback, check isSupported first.
+	//
+	// terrain.frag has its own copy of the constants below, change both together
+	class VaVirtualTexture {
+	public:
+		// texels per page side, not counting the border
+		static constexpr uint32_t PAGE_SIZE = 128;
+		// copied in from the neighbouring pages so bilinear filtering at a page's edge doesn't pick up whatever
+		// page happens to be next to it in the atlas
+		static constexpr uint32_t PAGE_BORDER = 1;
+		static constexpr uint32_t PHYSICAL_PAGE_SIZE = PAGE_SIZE + 2 * PAGE_BORDER;
+		// physical pages per atlas side, 16 * 16 pages of 130 * 130 is about 17 MiB
+		static constexpr uint32_t PHYSICAL_PAGES = 16;
+		// pages per side at mip 0, so the virtual texture is 65536 * 65536. Over the terrain's 1000 repeats of its
+		// 1024 * 1024 materials that's about 65 texels per repeat, 16 times coarser than the materials themselves.
+		// Matching them would take a 1M * 1M virtual texture and a page table and feedback to go with it, so it holds
+		// the unique color instead, and terrain.frag puts the materials' own detail back on top up close
+		static constexpr uint32_t VIRTUAL_PAGES = 512;
+		static constexpr uint32_t MAX_UPLOADS_PER_FRAME = 16;
+		static constexpr uint32_t MAX_PENDING_PAGES = 32;
+		// distinct pages a frame can ask for, anything past it just gets asked for again next frame
+		static constexpr uint32_t MAX_FEEDBACK = 4096;
+
+		// the part of the virtual texture one physical page covers, border included. x0/y0 are the virtual texel
+		// the first texel of the page lands on at this mip, and go past the edges of the virtual texture for the
+		// border of the outer pages
+		struct PageRegion {
+			uint32_t mip;
+			int32_t x0;
+			int32_t y0;
+			// virtual texture size at this mip
+			uint32_t virtualSize;
+		};
+		// fills PHYSICAL_PAGE_SIZE * PHYSICAL_PAGE_SIZE srgb RGBA8 texels. Gets called from the thread pool
+		using PageGenerator = std::function<void(const PageRegion& region, uint8_t* texels)>;
+
+		struct Stats {
+			uint32_t residentPages = 0;
+			uint32_t physicalPages = 0;
+			uint32_t pendingPages = 0;
+			uint64_t generated = 0;
+			uint64_t evicted = 0;
+		};
+
+		static bool isSupported(VaDevice& device) { return device.hasFragmentStores(); }
+		static uint32_t mipCount();
+
+		// feedback needs its own buffer for every frame in flight
+		VaVirtualTexture(VaDevice& device, uint32_t frameCount, PageGenerator generator);
+		~VaVirtualTexture();
+
+		VaVirtualTexture(const VaVirtualTexture&) = delete;
+		VaVirtualTexture& operator=(const VaVirtualTexture&) = delete;
+
+		// call after beginFrame (the fence for frameIndex has been waited on) and before the render pass. Goes
+		// through what the last frame in this slot asked for, and records the uploads of whatever pages have
+		// finished generating plus clearing this frame's feedback
+		void update(VkCommandBuffer commandBuffer, int frameIndex);
+		// after the render pass, copies this frame's feedback somewhere the cpu can read it
+		void recordFeedbackReadback(VkCommandBuffer commandBuffer, int frameIndex);
+
+		// set 1 for anything drawing with the virtual texture: page table, physical pages, feedback
+		VkDescriptorSetLayout getDescriptorSetLayout() const { return setLayout->getDescriptorSetLayout(); }
+		const VaDescriptorSetLayout& getSetLayout() const { return *setLayout; }
+		VkDescriptorSet getDescriptorSet(int frameIndex) const { return descriptorSets[frameIndex]; }
+
+		Stats getStats() const;
+		std::string summary() const;
+
+	private:
+		static constexpr uint32_t NO_PAGE = ~0u;
+
+		struct PhysicalPage {
+			// index into the flattened virtual pages, NO_PAGE while free
+			uint32_t virtualPage = NO_PAGE;
+			uint64_t lastUsed = 0;
+		};
+
+		struct Upload {
+			uint32_t physicalPage;
+			uint32_t virtualPage;
+			std::vector<uint8_t> texels;
+		};
+
+		PageRegion regionOf(uint32_t virtualPage) const;
+		void createImages();
+		void createFeedback(uint32_t frameCount);
+		void createDescriptors(uint32_t frameCount);
+		// picks a free physical page, or the least recently used one nothing asked for this frame
+		uint32_t allocatePhysicalPage();
+		// records copying the pages into the atlas and the page table entries for them and everything evicted
+		void upload(VkCommandBuffer commandBuffer, const std::vector<Upload>& uploads, const std::vector<uint32_t>& evictedPages);
+
+		VaDevice& vaDevice;
+		PageGenerator generator;
+
+		// where each mip's pages start in the flattened page index, the same order the shader uses
+		std::vector<uint32_t> mipOffsets;
+		uint32_t totalPages = 0;
+
+		VkImage pageTableImage = VK_NULL_HANDLE;
+		VkDeviceMemory pageTableMemory = VK_NULL_HANDLE;
+		VkImageView pageTableView = VK_NULL_HANDLE;
+		VkImage physicalImage = VK_NULL_HANDLE;
+		VkDeviceMemory physicalMemory = VK_NULL_HANDLE;
+		VkImageView physicalView = VK_NULL_HANDLE;
+
+		// count, then MAX_FEEDBACK page indices, then a flag per virtual page so each page only goes in once
+		std::vector<std::unique_ptr<VaBuffer>> feedbackBuffers;
+		// just the count and indices
+		std::vector<std::unique_ptr<VaBuffer>> readbackBuffers;
+		std::unique_ptr<VaDescriptorSetLayout> setLayout;
+		std::unique_ptr<VaDescriptorPool> pool;
+		std::vector<VkDescriptorSet> descriptorSets;
+
+		// physical page per virtual page, NO_PAGE when it isn't resident
+		std::vector<uint32_t> residency;
+		std::vector<PhysicalPage> physicalPages;
+		std::unordered_map<uint32_t, std::future<std::vector<uint8_t>>> pending;
+
+		uint64_t frame = 0;
+		uint64_t generated = 0;
+		uint64_t evicted = 0;
+	};
+}
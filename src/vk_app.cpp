@@ -3,6 +3,7 @@
 #include "render_systems/va_render_system.hpp"
 #include "render_systems/va_billboard_system.hpp"
 #include "render_systems/va_skybox_system.hpp"
+#include "render_systems/va_terrain_system.hpp"
 
 #include "models_meshes/va_terrain.hpp"
 
@@ -22,67 +23,63 @@
 
 #include <iostream>
 
-namespace va {
-    struct GlobalUbo {
-        alignas(16) glm::mat4 view{ 1.0f };
-        alignas(16) glm::mat4 inverseView{ 1.0f };
-        alignas(16) glm::mat4 projection{ 1.0f };
-        // When testing terrain rendering, this ambient aint used at all, since for now I'm just defaulting the terrain normals all straight up
-        //  so they all get the directional light equally
-        alignas(16) glm::vec4 ambientLightColor{ 1.0f, 1.0f, 1.0f, 0.0f };
-        alignas(16) glm::vec4 lightColor{ 0.4f, 0.2f, 0.6f, 1.0f };
-        alignas(16) glm::vec3 directionalLight{ 1.0f, -1.0f, -2.0f };
-    };
+#ifndef FILE_DIR
+#define FILE_DIR "../../../"
+#endif
 
+namespace va {
 	VkApp::VkApp() {
         globalSetLayout = VaDescriptorSetLayout::Builder(vaDevice)
-            .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS)
             .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) //skybox
-            .addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) //obj textures
-            .addBinding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) //
-            .addBinding(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) // terrain textures
-            .build();
-
-        globalPool = VaDescriptorPool::Builder(vaDevice)
-            .setMaxSets(VaSwapChain::MAX_FRAMES_IN_FLIGHT + 100)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VaSwapChain::MAX_FRAMES_IN_FLIGHT)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VaSwapChain::MAX_FRAMES_IN_FLIGHT)
             .build();
 
-        globalUboBuffers.resize(VaSwapChain::MAX_FRAMES_IN_FLIGHT);
-        for (int i = 0; i < globalUboBuffers.size(); i++) {
-            globalUboBuffers[i] = std::make_unique<VaBuffer>(
-                vaDevice,
-                sizeof(GlobalUbo),
-                1,
-                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-            );
-            globalUboBuffers[i]->map();
-        }
-
         defaultTexture = std::make_shared<VaImage>(vaDevice, "textures/Debugempty.png");
+        defaultTextureArray = VaImage::createArrayFromFiles(vaDevice, { "textures/Debugempty.png" });
         cubemap = std::make_shared<VaCubemap>(vaDevice);
 
         globalDescriptorSets.resize(VaSwapChain::MAX_FRAMES_IN_FLIGHT);
         for (int i = 0; i < globalDescriptorSets.size(); i++) {
-            auto bufferInfo = globalUboBuffers[i]->descriptorInfo();
+            auto bufferInfo = frameArena.descriptorInfo(i, sizeof(GlobalUbo));
 			auto cubemapInfo = cubemap->getInfo();
-            VaDescriptorWriter(*globalSetLayout, *globalPool)
-                .writeBuffer(0, &bufferInfo)
-                .writeImage(1, &cubemapInfo)
-                .build(globalDescriptorSets[i]);
+            VaDescriptorWriter writer{ *globalSetLayout };
+            writer.writeBuffer(0, &bufferInfo)
+                .writeImage(1, &cubemapInfo);
+            globalSetCache.build(writer, globalDescriptorSets[i]);
         }
         initTerrain();
-	    //loadGameObjects();
+	    loadGameObjects();
+
+        if (VaBindlessTable::isSupported(vaDevice)) {
+            bindlessTable = std::make_unique<VaBindlessTable>(vaDevice);
+            bindlessTable->add(defaultTexture);
+            bindlessTable->add(defaultTextureArray);
+        }
+
+        if (bindlessTable) {
+            for (auto& [id, gameObject] : gameObjects) {
+                addObjectTextures(gameObject);
+            }
+        }
 	}
 
 	VkApp::~VkApp() {}
 
 	void VkApp::run() {
-		VaRenderSystem renderSystem{ vaDevice, vaRenderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout() };
-        //VaBillboardSystem billboardSystem{ vaDevice, vaRenderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout() };
-		VaSkyboxSystem skyboxSystem{ vaDevice, vaRenderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout() };
+		VaRenderSystem renderSystem{
+            vaDevice,
+            vaRenderer.getSwapChainRenderPass(),
+            *globalSetLayout,
+            bindlessTable.get(),
+            *defaultTexture,
+            *defaultTextureArray
+        };
+        //VaBillboardSystem billboardSystem{ vaDevice, vaRenderer.getSwapChainRenderPass(), *globalSetLayout };
+		VaSkyboxSystem skyboxSystem{ vaDevice, vaRenderer.getSwapChainRenderPass(), *globalSetLayout };
+        std::unique_ptr<VaTerrainSystem> terrainSystem;
+        if (virtualTexture) {
+            terrainSystem = std::make_unique<VaTerrainSystem>(vaDevice, vaRenderer.getSwapChainRenderPass(), *globalSetLayout, *virtualTexture);
+        }
 
         VaCamera camera{};
 
@@ -91,6 +88,11 @@ namespace va {
         VaController cameraController{};
 
         auto currentTime = std::chrono::high_resolution_clock::now();
+        float memoryLogTimer = 0.0f;
+        std::cout << vaDevice.memoryTracker().summary() << '\n';
+        std::cout << vaDevice.bufferPool().summary() << '\n';
+        // pipelines compile in the background, the summary goes out once the last one is done
+        bool pipelinesLogged = false;
 
 		while (!vaWindow.shouldClose()) {
 			glfwPollEvents();
@@ -103,6 +105,25 @@ namespace va {
             float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
             currentTime = newTime;
 
+            if (!pipelinesLogged && vaDevice.pipelineStates().getStats().compiling == 0) {
+                pipelinesLogged = true;
+                // the whole startup cost with a cold or warm cache
+                std::cout << vaDevice.pipelineCache().summary() << '\n';
+                std::cout << vaDevice.pipelineStates().summary() << '\n';
+            }
+
+            memoryLogTimer += frameTime;
+            if (memoryLogTimer >= MEMORY_LOG_INTERVAL) {
+                memoryLogTimer = 0.0f;
+                std::cout << vaDevice.memoryTracker().summary() << '\n';
+                std::cout << vaDevice.bufferPool().summary() << '\n';
+                std::cout << textureStreamer.summary() << '\n';
+                std::cout << assets.summary() << '\n';
+                if (virtualTexture) {
+                    std::cout << virtualTexture->summary() << '\n';
+                }
+            }
+
             cameraController.moveInPlaneXZ(vaWindow.getGLFWwindow(), frameTime, viewerObject);
             cameraController.mouseControl(vaWindow.getGLFWwindow(), frameTime, viewerObject);
             camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
@@ -110,22 +131,59 @@ namespace va {
             float aspect = vaRenderer.getAspectRatio();
             camera.setPerspectiveProjection(glm::radians(50.0f), aspect, 0.1f, 15000.0f);
 
+            // whatever the game objects stopped using this frame goes now, through the deletion queue, so a released
+            // texture or model doesn't stay cached until the next time anything gets logged. Evicted images leave
+            // bindless slots behind that can be handed out again
+            if (assets.evictUnused() > 0 && bindlessTable) {
+                bindlessTable->refresh();
+            }
+
 			if (auto commandBuffer = vaRenderer.beginFrame()) {
                 int frameIndex = vaRenderer.getFrameIndex();
-                FrameInfo frameInfo{ frameIndex, frameTime, commandBuffer, camera, globalDescriptorSets[frameIndex], gameObjects };
+                frameArena.beginFrame(frameIndex);
+                frameDescriptors.beginFrame(frameIndex);
+                // any streamed image that got swapped out leaves stale handles in the bindless table. Without it the
+                // object textures get written fresh every frame anyway
+                if (textureStreamer.update(commandBuffer, camera, static_cast<float>(vaWindow.getExtent().height), gameObjects)) {
+                    if (bindlessTable) {
+                        bindlessTable->refresh();
+                    }
+                }
+                // page uploads have to be recorded before the render pass starts
+                if (virtualTexture) {
+                    virtualTexture->update(commandBuffer, frameIndex);
+                }
 
                 GlobalUbo ubo{};
                 ubo.view = camera.getView();
                 ubo.inverseView = camera.getInverseView();
                 ubo.projection = camera.getProjection();
-                globalUboBuffers[frameIndex]->writeToBuffer(&ubo);
-                globalUboBuffers[frameIndex]->flush();
+                uint32_t globalUboOffset = frameArena.push(ubo);
+
+                FrameInfo frameInfo{
+                    frameIndex,
+                    frameTime,
+                    commandBuffer,
+                    camera,
+                    globalDescriptorSets[frameIndex],
+                    gameObjects,
+                    frameArena,
+                    globalUboOffset,
+                    frameDescriptors,
+                    vaRenderer.getSwapChainRenderPass()
+                };
 
                 vaRenderer.beginSwapChainRenderPass(commandBuffer);
                 skyboxSystem.renderSkybox(frameInfo);
 				renderSystem.renderGameObjects(frameInfo);
+                if (terrainSystem) {
+                    terrainSystem->renderGameObjects(frameInfo);
+                }
                 //billboardSystem.renderBillboard(frameInfo);
 				vaRenderer.endSwapChainRenderPass(commandBuffer);
+                if (virtualTexture) {
+                    virtualTexture->recordFeedbackReadback(commandBuffer, frameIndex);
+                }
 				vaRenderer.endFrame();
 			}
             // something to do with the command pool is causing best-practice complaints. Gotta look into that
@@ -135,8 +193,14 @@ namespace va {
 	}
 
 	void VkApp::loadGameObjects() {
-        std::shared_ptr<VaModel> roomModel = VaModel::createModelFromFile(vaDevice, "models/viking_room.obj", 1.0f);
-		std::shared_ptr<VaImage> roomTexture = VaImage::createImageFromFile(vaDevice, "textures/viking_room.png");
+        auto textures = assets.getImages({
+            "textures/viking_room.png",
+            "textures/terrain/terrain_5.png",
+            "textures/crate_diffuse.png"
+        });
+
+        std::shared_ptr<VaModel> roomModel = assets.getModel("models/viking_room.obj", 1.0f);
+		std::shared_ptr<VaImage> roomTexture = textures[0];
         auto room = VaGameObject::createGameObject();
         room.model = roomModel;
 		room.texture = roomTexture;
@@ -145,15 +209,15 @@ namespace va {
         room.transform.rotation = { glm::radians(90.0f), 0.0f, glm::radians(180.0f) };
         gameObjects.emplace(room.getId(), std::move(room));
 
-        std::shared_ptr<VaModel> vaseModel = VaModel::createModelFromFile(vaDevice, "models/flat_vase.obj", 1.0f);
+        std::shared_ptr<VaModel> vaseModel = assets.getModel("models/flat_vase.obj", 1.0f);
         auto vase = VaGameObject::createGameObject();
         vase.model = vaseModel;
         vase.transform.translation = { -2.0f, 0.5f, 0.0f };
         vase.transform.scale = 1.0f;
         gameObjects.emplace(vase.getId(), std::move(vase));
 
-        std::shared_ptr<VaModel> floorModel = VaModel::createModelFromFile(vaDevice, "models/quad.obj", 1.0f);
-        std::shared_ptr<VaImage> floorTexture = VaImage::createImageFromFile(vaDevice, "textures/terrain/terrain_3.png");
+        std::shared_ptr<VaModel> floorModel = assets.getModel("models/quad.obj", 1.0f);
+        std::shared_ptr<VaImage> floorTexture = textures[1];
         auto floor = VaGameObject::createGameObject();
         floor.model = floorModel;
         floor.texture = floorTexture;
@@ -161,8 +225,8 @@ namespace va {
         floor.transform.scale = 3.0f;
         gameObjects.emplace(floor.getId(), std::move(floor));
 
-        std::shared_ptr<VaModel> crateModel = VaModel::createModelFromFile(vaDevice, "models/cube.obj", 1.0f);
-        std::shared_ptr<VaImage> crateTexture = VaImage::createImageFromFile(vaDevice, "textures/crate_diffuse.png");
+        std::shared_ptr<VaModel> crateModel = assets.getModel("models/cube.obj", 1.0f);
+        std::shared_ptr<VaImage> crateTexture = textures[2];
         auto crate = VaGameObject::createGameObject();
         crate.model = crateModel;
         crate.texture = crateTexture;
@@ -170,27 +234,35 @@ namespace va {
         crate.transform.scale = 0.2f;
         crate.transform.rotation = { 0.0f, glm::radians(75.0f), 0.0f};
         gameObjects.emplace(crate.getId(), std::move(crate));
-        
-        for (auto& [id, gameObject] : gameObjects) {
-            VkDescriptorSet descriptorSet;
-
-            auto textureInfo = (gameObject.texture != nullptr) ? gameObject.texture->getInfo() : defaultTexture->getInfo();
-            VaDescriptorWriter(*globalSetLayout, *globalPool)
-                .writeImage(2, &textureInfo)
-                .build(descriptorSet);
-
-            gameObject.descriptorSet = descriptorSet;
-        }
 	}
 
     void VkApp::initTerrain() {
-		std::shared_ptr<VaModel> terrainModel = VaTerrain::createTerrainFromFile(vaDevice, "textures/terrain/iceland_heightmap.png");
-        std::shared_ptr<VaImage> terrain1 = VaImage::createImageFromFile(vaDevice, "textures/terrain/terrain_4.png");
-        std::shared_ptr<VaImage> terrain2 = VaImage::createImageFromFile(vaDevice, "textures/terrain/terrain_5.png");
+        const std::string heightmap = "textures/terrain/iceland_heightmap.png";
+        // materials go bottom to top, changing over at each of the transition heights
+        const std::vector<std::string> materials{
+            "textures/terrain/terrain_4.png",
+            "textures/terrain/terrain_5.png"
+        };
+        const std::vector<float> transitionHeights{ 20.0f };
+        const float blendWidth = 20.0f;
+
         auto terrain = VaGameObject::createGameObject();
-		terrain.model = terrainModel;
-		terrain.terrainTexture1 = terrain1;
-        terrain.terrainTexture2 = terrain2;
+        terrain.model = assets.getTerrain(heightmap);
+        // shader.frag repeats the terrain uvs this many times, its pipeline gets specialized for it
+        terrain.uvScale = 1000.0f;
+
+        // tiled by shader.frag, or the detail on top of the virtual texture
+        terrain.terrainMaterials = assets.getImageArray(materials);
+        terrain.terrainSplatMap = assets.getSplatMap(heightmap, transitionHeights, blendWidth);
+        // unique texels over the whole terrain when it can
+        if (VaVirtualTexture::isSupported(vaDevice)) {
+            virtualTexture = std::make_shared<VaVirtualTexture>(
+                vaDevice,
+                VaSwapChain::MAX_FRAMES_IN_FLIGHT,
+                VaTerrain::createPageGenerator(vaDevice, heightmap, materials, transitionHeights, blendWidth, terrain.uvScale)
+            );
+            terrain.virtualTexture = virtualTexture;
+        }
         // I need a solution for this whole scale thing. Right now, you can't scale by individual axis, because of normal
         // calculation shenanigans. But this means scaling the terrain is also gonna scale it vertically, messes with
         // the terrain textures, as they are based on y position. Really, I would wanna only scale it by x and z axis.
@@ -200,17 +272,13 @@ namespace va {
         // in the fragment shader. I could pass the values in with a descriptor, but I'm trying to minimize using those
         //terrain.transform.scale = 100.0f;
         gameObjects.emplace(terrain.getId(), std::move(terrain));
+    }
 
-        for (auto& [id, gameObject] : gameObjects) {
-            VkDescriptorSet descriptorSet;
-            VaDescriptorWriter writer(*globalSetLayout, *globalPool);
-
-            VaDescriptorWriter(*globalSetLayout, *globalPool)
-                .writeImage(3, &gameObject.terrainTexture1->getInfo())
-                .writeImage(4, &gameObject.terrainTexture2->getInfo())
-                .build(descriptorSet);
-
-            gameObject.descriptorSet = descriptorSet;
+    void VkApp::addObjectTextures(VaGameObject& gameObject) {
+        for (const auto& texture : { gameObject.texture, gameObject.terrainMaterials, gameObject.terrainSplatMap }) {
+            if (texture != nullptr) {
+                bindlessTable->add(texture);
+            }
         }
     }
 }
\ No newline at end of file
@@ -5,7 +5,15 @@
 #include "va_game_object.hpp"
 #include "va_renderer.hpp"
 #include "va_descriptors.hpp"
+#include "va_descriptor_set_cache.hpp"
+#include "va_frame_descriptors.hpp"
 #include "va_cubemap.hpp"
+#include "va_frame_arena.hpp"
+#include "va_texture_streamer.hpp"
+#include "va_bindless_table.hpp"
+#include "va_virtual_texture.hpp"
+#include "va_asset_manager.hpp"
+#include "va_shader_watcher.hpp"
 
 #include <memory>
 #include <vector>
@@ -15,6 +23,10 @@ namespace va {
 	public:
 		static constexpr int WIDTH = 640;
 		static constexpr int HEIGHT = 360;
+		// seconds between gpu memory summaries in the log
+		static constexpr float MEMORY_LOG_INTERVAL = 10.0f;
+		// per-frame space for the global ubo and anything render systems push per draw
+		static constexpr VkDeviceSize FRAME_ARENA_SIZE = 1024 * 1024;
 
 		VkApp();
 		~VkApp();
@@ -28,16 +40,30 @@ namespace va {
 		VaWindow vaWindow{ WIDTH, HEIGHT, "Vulkan Gaming" };
 		VaDevice vaDevice{ vaWindow };
 		VaRenderer vaRenderer{ vaWindow, vaDevice };
+		// rebuilds pipelines as their shaders get saved
+		VaShaderWatcher shaderWatcher{ vaDevice };
 
-		std::vector<std::unique_ptr<VaBuffer>> globalUboBuffers;
+		VaFrameArena frameArena{ vaDevice, FRAME_ARENA_SIZE, VaSwapChain::MAX_FRAMES_IN_FLIGHT };
+		VaFrameDescriptors frameDescriptors{ vaDevice, VaSwapChain::MAX_FRAMES_IN_FLIGHT };
+		VaTextureStreamer textureStreamer{ vaDevice };
+		// every scene image and model comes through here so shared files only load once
+		VaAssetManager assets{ vaDevice, &textureStreamer };
 		std::unique_ptr<VaDescriptorSetLayout> globalSetLayout{};
 		std::vector<VkDescriptorSet> globalDescriptorSets;
-		std::shared_ptr<VaDescriptorPool> globalPool{};
+		// where globalDescriptorSets come from, they last as long as the app does
+		VaDescriptorSetCache globalSetCache{ vaDevice };
 		VaGameObject::Map gameObjects;
 		std::shared_ptr<VaImage> defaultTexture{};
+		// same image as a one layer array, for array bindings with nothing else to point at
+		std::shared_ptr<VaImage> defaultTextureArray{};
 		std::shared_ptr<VaCubemap> cubemap{};
+		// null when the device can't do descriptor indexing, objects get their own sets then
+		std::unique_ptr<VaBindlessTable> bindlessTable{};
+		// the terrain's, null when it's using the splat map instead
+		std::shared_ptr<VaVirtualTexture> virtualTexture{};
 
 		void loadGameObjects();
 		void initTerrain();
+		void addObjectTextures(VaGameObject& gameObject);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,384 @@
+// Offline texture converter. Takes the pngs/jpgs under textures/ and writes a .ktx2 next to each one with the full
+// mip chain baked in and block compressed, which VaImage then picks up instead of decoding the original.
+//
+//   ktx_converter [--format bc1|bc3|bc5|bc7|rgba8] [--linear] [-o output.ktx2] <input>...
+//   ktx_converter --cubemap [--format ...] [-o output.ktx2] <right> <left> <down> <up> <front> <back>
+//
+// bc7 is the default. Color textures are treated as srgb unless --linear is passed, bc5 is always linear since
+// it's only really useful for normal maps. --cubemap packs six faces, in the same order VaCubemap uses, into one
+// .ktx2 with a mip chain per face, textures/skybox/skycube.ktx2 unless -o says otherwise.
+
+#include "va_ktx.hpp"
+#include "va_mip_generator.hpp"
+#include "va_thread_pool.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#define STB_DXT_IMPLEMENTATION
+#include <stb_dxt.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+	struct Image {
+		uint32_t width;
+		uint32_t height;
+		std::vector<uint8_t> rgba;
+	};
+
+	enum class Encoding { BC1, BC3, BC5, BC7, RGBA8 };
+
+	// grabs the 4x4 block at (bx, by), repeating the edge texels for images that aren't a multiple of 4
+	void extractBlock(const Image& image, uint32_t bx, uint32_t by, uint8_t block[64]) {
+		for (uint32_t y = 0; y < 4; y++) {
+			for (uint32_t x = 0; x < 4; x++) {
+				uint32_t sx = std::min(bx * 4 + x, image.width - 1);
+				uint32_t sy = std::min(by * 4 + y, image.height - 1);
+				memcpy(&block[(y * 4 + x) * 4], &image.rgba[(static_cast<size_t>(sy) * image.width + sx) * 4], 4);
+			}
+		}
+	}
+
+	struct BitWriter {
+		uint8_t* out;
+		uint32_t position = 0;
+
+		void write(uint32_t value, uint32_t bits) {
+			for (uint32_t i = 0; i < bits; i++, position++) {
+				if ((value >> i) & 1) {
+					out[position >> 3] |= static_cast<uint8_t>(1 << (position & 7));
+				}
+			}
+		}
+	};
+
+	// BC7 mode 6 only: one subset, 7 bit rgba endpoints plus a p-bit each, 4 bit indices. It's nowhere near what a
+	// proper multi-mode encoder gets out of bc7, but beats bc1/bc3 on color and alpha and costs almost nothing
+	void encodeBc7Block(const uint8_t block[64], uint8_t out[16]) {
+		static const int WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		float mean[4] = {};
+		for (int i = 0; i < 16; i++) {
+			for (int c = 0; c < 4; c++) mean[c] += block[i * 4 + c];
+		}
+		for (float& m : mean) m /= 16.0f;
+
+		float covariance[4][4] = {};
+		for (int i = 0; i < 16; i++) {
+			float d[4];
+			for (int c = 0; c < 4; c++) d[c] = block[i * 4 + c] - mean[c];
+			for (int a = 0; a < 4; a++) {
+				for (int b = 0; b < 4; b++) covariance[a][b] += d[a] * d[b];
+			}
+		}
+
+		// principal axis by power iteration
+		float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		for (int iteration = 0; iteration < 8; iteration++) {
+			float next[4] = {};
+			for (int a = 0; a < 4; a++) {
+				for (int b = 0; b < 4; b++) next[a] += covariance[a][b] * axis[b];
+			}
+			float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+			if (length < 1e-6f) break;
+			for (int c = 0; c < 4; c++) axis[c] = next[c] / length;
+		}
+
+		float minProjection = 0.0f;
+		float maxProjection = 0.0f;
+		for (int i = 0; i < 16; i++) {
+			float projection = 0.0f;
+			for (int c = 0; c < 4; c++) projection += (block[i * 4 + c] - mean[c]) * axis[c];
+			minProjection = std::min(minProjection, projection);
+			maxProjection = std::max(maxProjection, projection);
+		}
+
+		float endpoints[2][4];
+		for (int c = 0; c < 4; c++) {
+			endpoints[0][c] = std::clamp(mean[c] + axis[c] * minProjection, 0.0f, 255.0f);
+			endpoints[1][c] = std::clamp(mean[c] + axis[c] * maxProjection, 0.0f, 255.0f);
+		}
+
+		int bestError = -1;
+		int bestQuantized[2][4] = {};
+		int bestPBits[2] = {};
+		int bestIndices[16] = {};
+
+		for (int pBits = 0; pBits < 4; pBits++) {
+			int p[2] = { pBits & 1, pBits >> 1 };
+			int quantized[2][4];
+			int expanded[2][4];
+			for (int e = 0; e < 2; e++) {
+				for (int c = 0; c < 4; c++) {
+					quantized[e][c] = std::clamp(static_cast<int>(std::lround((endpoints[e][c] - p[e]) / 2.0f)), 0, 127);
+					expanded[e][c] = (quantized[e][c] << 1) | p[e];
+				}
+			}
+
+			int palette[16][4];
+			for (int i = 0; i < 16; i++) {
+				for (int c = 0; c < 4; c++) {
+					palette[i][c] = ((64 - WEIGHTS[i]) * expanded[0][c] + WEIGHTS[i] * expanded[1][c] + 32) >> 6;
+				}
+			}
+
+			int error = 0;
+			int indices[16];
+			for (int i = 0; i < 16; i++) {
+				int bestTexelError = -1;
+				for (int j = 0; j < 16; j++) {
+					int texelError = 0;
+					for (int c = 0; c < 4; c++) {
+						int d = palette[j][c] - block[i * 4 + c];
+						texelError += d * d;
+					}
+					if (bestTexelError < 0 || texelError < bestTexelError) {
+						bestTexelError = texelError;
+						indices[i] = j;
+					}
+				}
+				error += bestTexelError;
+			}
+
+			if (bestError < 0 || error < bestError) {
+				bestError = error;
+				memcpy(bestQuantized, quantized, sizeof(quantized));
+				memcpy(bestPBits, p, sizeof(p));
+				memcpy(bestIndices, indices, sizeof(indices));
+			}
+		}
+
+		// the first index only gets 3 bits, so its top bit has to be 0. Swapping the endpoints flips the indices
+		if (bestIndices[0] & 8) {
+			for (int c = 0; c < 4; c++) std::swap(bestQuantized[0][c], bestQuantized[1][c]);
+			std::swap(bestPBits[0], bestPBits[1]);
+			for (int& index : bestIndices) index = 15 - index;
+		}
+
+		memset(out, 0, 16);
+		BitWriter writer{ out };
+		writer.write(1 << 6, 7);
+		for (int c = 0; c < 4; c++) {
+			writer.write(bestQuantized[0][c], 7);
+			writer.write(bestQuantized[1][c], 7);
+		}
+		writer.write(bestPBits[0], 1);
+		writer.write(bestPBits[1], 1);
+		for (int i = 0; i < 16; i++) {
+			writer.write(bestIndices[i], i == 0 ? 3 : 4);
+		}
+	}
+
+	std::vector<uint8_t> encodeLevel(const Image& image, Encoding encoding) {
+		if (encoding == Encoding::RGBA8) {
+			return image.rgba;
+		}
+
+		uint32_t blocksX = (image.width + 3) / 4;
+		uint32_t blocksY = (image.height + 3) / 4;
+		size_t blockBytes = (encoding == Encoding::BC1) ? 8 : 16;
+		std::vector<uint8_t> encoded(static_cast<size_t>(blocksX) * blocksY * blockBytes);
+
+		uint8_t block[64];
+		for (uint32_t by = 0; by < blocksY; by++) {
+			for (uint32_t bx = 0; bx < blocksX; bx++) {
+				extractBlock(image, bx, by, block);
+				uint8_t* out = &encoded[(static_cast<size_t>(by) * blocksX + bx) * blockBytes];
+
+				switch (encoding) {
+				case Encoding::BC1:
+					stb_compress_dxt_block(out, block, 0, STB_DXT_HIGHQUAL);
+					break;
+				case Encoding::BC3:
+					stb_compress_dxt_block(out, block, 1, STB_DXT_HIGHQUAL);
+					break;
+				case Encoding::BC5: {
+					uint8_t rg[32];
+					for (int i = 0; i < 16; i++) {
+						rg[i * 2] = block[i * 4];
+						rg[i * 2 + 1] = block[i * 4 + 1];
+					}
+					stb_compress_bc5_block(out, rg);
+					break;
+				}
+				case Encoding::BC7:
+					encodeBc7Block(block, out);
+					break;
+				default:
+					break;
+				}
+			}
+		}
+		return encoded;
+	}
+
+	VkFormat vulkanFormat(Encoding encoding, bool srgb) {
+		switch (encoding) {
+		case Encoding::BC1: return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+		case Encoding::BC3: return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+		case Encoding::BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+		case Encoding::BC7: return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+		default: return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+		}
+	}
+
+	Encoding parseEncoding(const std::string& name) {
+		if (name == "bc1") return Encoding::BC1;
+		if (name == "bc3") return Encoding::BC3;
+		if (name == "bc5") return Encoding::BC5;
+		if (name == "bc7") return Encoding::BC7;
+		if (name == "rgba8") return Encoding::RGBA8;
+		throw std::runtime_error("unknown format: " + name);
+	}
+
+	double toMiB(size_t bytes) {
+		return static_cast<double>(bytes) / (1024.0 * 1024.0);
+	}
+
+	void convert(const std::string& input, const std::string& output, Encoding encoding, bool srgb, va::VaThreadPool& threadPool) {
+		int width, height, channels;
+		// same flip as VaImage so the ktx2 lines up with the png it replaces
+		stbi_set_flip_vertically_on_load(true);
+		stbi_uc* pixels = stbi_load(input.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+		if (!pixels) {
+			throw std::runtime_error("failed to load image: " + input);
+		}
+
+		va::VaKtxTexture chain = va::VaMipGenerator::generate(
+			pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), srgb, threadPool);
+		stbi_image_free(pixels);
+
+		va::VaKtxTexture ktx{};
+		ktx.format = vulkanFormat(encoding, srgb);
+		ktx.width = chain.width;
+		ktx.height = chain.height;
+		ktx.levelCount = chain.levelCount;
+
+		for (uint32_t i = 0; i < chain.levelCount; i++) {
+			const va::VaKtxLevel& source = chain.levels[i];
+			Image level{ std::max(chain.width >> i, 1u), std::max(chain.height >> i, 1u), {} };
+			level.rgba.assign(chain.data.begin() + source.offset, chain.data.begin() + source.offset + source.size);
+
+			std::vector<uint8_t> encoded = encodeLevel(level, encoding);
+			ktx.levels.push_back({ ktx.data.size(), encoded.size() });
+			ktx.data.insert(ktx.data.end(), encoded.begin(), encoded.end());
+		}
+
+		ktx.writeToFile(output);
+		std::cout << input << " -> " << output << " (" << ktx.width << "x" << ktx.height << ", " << ktx.levelCount
+			<< " mips, " << toMiB(chain.data.size()) << " MiB -> " << toMiB(ktx.data.size()) << " MiB)\n";
+	}
+
+	// every face gets its own chain, filtered the same way as any other texture. Faces don't bleed into each other
+	// at the smaller mips, but with seamless cube filtering on that's not something you can see on a skybox
+	void convertCubemap(const std::vector<std::string>& inputs, const std::string& output, Encoding encoding, bool srgb,
+		va::VaThreadPool& threadPool) {
+		std::vector<va::VaKtxTexture> chains;
+		for (const auto& input : inputs) {
+			int width, height, channels;
+			stbi_set_flip_vertically_on_load(true);
+			stbi_uc* pixels = stbi_load(input.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+			if (!pixels) {
+				throw std::runtime_error("failed to load image: " + input);
+			}
+			if (width != height || (!chains.empty() && static_cast<uint32_t>(width) != chains[0].width)) {
+				stbi_image_free(pixels);
+				throw std::runtime_error("cubemap faces need to be square and all the same size: " + input);
+			}
+
+			chains.push_back(va::VaMipGenerator::generate(
+				pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), srgb, threadPool));
+			stbi_image_free(pixels);
+		}
+
+		va::VaKtxTexture ktx{};
+		ktx.format = vulkanFormat(encoding, srgb);
+		ktx.width = chains[0].width;
+		ktx.height = chains[0].height;
+		ktx.levelCount = chains[0].levelCount;
+		ktx.faceCount = 6;
+
+		// a level is all six faces back to back
+		size_t sourceBytes = 0;
+		for (uint32_t i = 0; i < ktx.levelCount; i++) {
+			size_t levelOffset = ktx.data.size();
+			for (const auto& chain : chains) {
+				const va::VaKtxLevel& source = chain.levels[i];
+				Image face{ std::max(chain.width >> i, 1u), std::max(chain.height >> i, 1u), {} };
+				face.rgba.assign(chain.data.begin() + source.offset, chain.data.begin() + source.offset + source.size);
+				sourceBytes += source.size;
+
+				std::vector<uint8_t> encoded = encodeLevel(face, encoding);
+				ktx.data.insert(ktx.data.end(), encoded.begin(), encoded.end());
+			}
+			ktx.levels.push_back({ levelOffset, ktx.data.size() - levelOffset });
+		}
+
+		ktx.writeToFile(output);
+		std::cout << "cubemap -> " << output << " (6x " << ktx.width << "x" << ktx.height << ", " << ktx.levelCount
+			<< " mips, " << toMiB(sourceBytes) << " MiB -> " << toMiB(ktx.data.size()) << " MiB)\n";
+	}
+}
+
+int main(int argc, char** argv) {
+	Encoding encoding = Encoding::BC7;
+	bool linear = false;
+	bool cubemap = false;
+	std::string output;
+	std::vector<std::string> inputs;
+
+	try {
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			if (arg == "--format" && i + 1 < argc) {
+				encoding = parseEncoding(argv[++i]);
+			}
+			else if (arg == "--linear") {
+				linear = true;
+			}
+			else if (arg == "--cubemap") {
+				cubemap = true;
+			}
+			else if (arg == "-o" && i + 1 < argc) {
+				output = argv[++i];
+			}
+			else {
+				inputs.push_back(arg);
+			}
+		}
+
+		bool usable = cubemap ? inputs.size() == 6 : !inputs.empty() && (output.empty() || inputs.size() == 1);
+		if (!usable) {
+			std::cerr << "usage: ktx_converter [--format bc1|bc3|bc5|bc7|rgba8] [--linear] [-o output.ktx2] <input>...\n"
+				<< "       ktx_converter --cubemap [--format ...] [-o output.ktx2] <right> <left> <down> <up> <front> <back>\n";
+			return EXIT_FAILURE;
+		}
+
+		bool srgb = !linear && encoding != Encoding::BC5;
+		va::VaThreadPool threadPool{};
+		if (cubemap) {
+			convertCubemap(inputs, output.empty() ? "textures/skybox/skycube.ktx2" : output, encoding, srgb, threadPool);
+			return EXIT_SUCCESS;
+		}
+		for (const auto& input : inputs) {
+			std::string target = output.empty()
+				? std::filesystem::path{ input }.replace_extension(".ktx2").string()
+				: output;
+			convert(input, target, encoding, srgb, threadPool);
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << '\n';
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}